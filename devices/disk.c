@@ -7,6 +7,7 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -59,6 +60,7 @@ struct disk {
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
+	long long request_cnt;      /* Number of commands issued. */
 };
 
 /* An ATA channel (aka controller).
@@ -84,7 +86,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -133,7 +135,7 @@ disk_init (void) {
 			d->is_ata = false;
 			d->capacity = 0;
 
-			d->read_cnt = d->write_cnt = 0;
+			d->read_cnt = d->write_cnt = d->request_cnt = 0;
 		}
 
 		/* Register interrupt handler. */
@@ -167,8 +169,8 @@ disk_print_stats (void) {
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = disk_get (chan_no, dev_no);
 			if (d != NULL && d->is_ata)
-				printf ("%s: %lld reads, %lld writes\n",
-						d->name, d->read_cnt, d->write_cnt);
+				printf ("%s: %lld reads, %lld writes in %lld requests\n",
+						d->name, d->read_cnt, d->write_cnt, d->request_cnt);
 		}
 	}
 }
@@ -209,44 +211,83 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
+	disk_read_multiple (d, sec_no, buffer, 1);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+	disk_write_multiple (d, sec_no, buffer, 1);
+}
+
+/* Reads CNT consecutive sectors, starting at SEC_NO, from disk D
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.  CNT may be up to DISK_MAX_SECTORS.  Issues a single
+   command, however many sectors it takes. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, void *buffer,
+		size_t cnt) {
 	struct channel *c;
+	uint8_t *p = buffer;
+	size_t i;
 
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
+	ASSERT (cnt > 0 && cnt <= DISK_MAX_SECTORS);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
+	select_sector (d, sec_no, cnt);
 	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
+	for (i = 0; i < cnt; i++) {
+		/* The disk interrupts as each sector becomes ready. */
+		sema_down (&c->completion_wait);
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name,
+					sec_no + (disk_sector_t) i);
+		input_sector (c, p + i * DISK_SECTOR_SIZE);
+	}
+	d->read_cnt += cnt;
+	d->request_cnt++;
+	thread_current ()->usage.inblock += cnt;
 	lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   DISK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+/* Writes CNT consecutive sectors, starting at SEC_NO, to disk D
+   from BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   CNT may be up to DISK_MAX_SECTORS.  Issues a single command,
+   and returns after the disk has acknowledged all of the data. */
 void
-disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+disk_write_multiple (struct disk *d, disk_sector_t sec_no,
+		const void *buffer, size_t cnt) {
 	struct channel *c;
+	const uint8_t *p = buffer;
+	size_t i;
 
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
+	ASSERT (cnt > 0 && cnt <= DISK_MAX_SECTORS);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
+	select_sector (d, sec_no, cnt);
 	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	for (i = 0; i < cnt; i++) {
+		/* The disk asks for the first sector right away, and for each
+		   of the others by interrupting after the one before. */
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+					sec_no + (disk_sector_t) i);
+		output_sector (c, p + i * DISK_SECTOR_SIZE);
+		sema_down (&c->completion_wait);
+	}
+	d->write_cnt += cnt;
+	d->request_cnt++;
+	thread_current ()->usage.oublock += cnt;
 	lock_release (&c->lock);
 }
 
@@ -402,17 +443,19 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT to the disk's sector selection and count
+   registers.  (We use LBA mode.)  A count of 0 in the register
+   means 256 sectors. */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
+	ASSERT (cnt > 0 && cnt <= DISK_MAX_SECTORS);
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt == DISK_MAX_SECTORS ? 0 : cnt);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -38,6 +38,37 @@ input_getc (void) {
 	return key;
 }
 
+/* Retrieves up to N keys from the input buffer into BUF, all at
+   once, without waiting.  Returns the number of keys retrieved. */
+size_t
+input_getbuf (uint8_t *buf, size_t n) {
+	enum intr_level old_level;
+	size_t cnt;
+
+	old_level = intr_disable ();
+	cnt = intq_getn (&buffer, buf, n);
+	if (cnt > 0)
+		serial_notify ();
+	intr_set_level (old_level);
+
+	return cnt;
+}
+
+/* Waits for a key to be pressed, unless the input buffer has one
+   already, or for input_wake() to be called.
+   Interrupts must be off. */
+void
+input_wait (void) {
+	intq_wait (&buffer);
+}
+
+/* Wakes the thread in input_wait(), if any, with no key.
+   Interrupts must be off. */
+void
+input_wake (void) {
+	intq_wake (&buffer);
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
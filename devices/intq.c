@@ -1,5 +1,6 @@
 #include "devices/intq.h"
 #include <debug.h>
+#include <string.h>
 #include "threads/thread.h"
 
 static int next (int pos);
@@ -50,6 +51,54 @@ intq_getc (struct intq *q) {
 	return byte;
 }
 
+/* Sleeps until a byte is added to Q or intq_wake() is called,
+   unless Q is not empty. */
+void
+intq_wait (struct intq *q) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!intr_context ());
+	if (intq_empty (q)) {
+		lock_acquire (&q->lock);
+		wait (q, &q->not_empty);
+		lock_release (&q->lock);
+	}
+}
+
+/* Wakes the thread waiting for Q to become nonempty, if any, even
+   though it may still be empty.  A thread in intq_getc() goes
+   back to sleep. */
+void
+intq_wake (struct intq *q) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (q->not_empty != NULL) {
+		thread_unblock (q->not_empty);
+		q->not_empty = NULL;
+	}
+}
+
+/* Removes up to N bytes from Q into BUF without sleeping and
+   returns the number removed, which is 0 if Q is empty. */
+size_t
+intq_getn (struct intq *q, uint8_t *buf, size_t n) {
+	size_t cnt = 0;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	while (cnt < n && !intq_empty (q)) {
+		/* Copy the run up to the end of the buffer or the head. */
+		int end = q->head >= q->tail ? q->head : INTQ_BUFSIZE;
+		size_t run = end - q->tail;
+
+		if (run > n - cnt)
+			run = n - cnt;
+		memcpy (buf + cnt, q->buf + q->tail, run);
+		cnt += run;
+		q->tail = (q->tail + run) % INTQ_BUFSIZE;
+	}
+	if (cnt > 0)
+		signal (q, &q->not_full);
+	return cnt;
+}
+
 /* Adds BYTE to the end of Q.
    Q must not be full if called from an interrupt handler.
    Otherwise, if Q is full, first sleeps until a byte is
@@ -1,7 +1,7 @@
 #include "devices/serial.h"
 #include <debug.h>
+#include <string.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -33,6 +33,14 @@
 #define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable the 16-byte FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Clear the receive FIFO. */
+#define FCR_CLEAR_TX 0x04       /* Clear the transmit FIFO. */
+
+/* Bytes the transmit FIFO takes once THR is empty. */
+#define TX_FIFO_SIZE 16
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
@@ -51,14 +59,44 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted, in a ring buffer that is filled by
+   serial_putc() and serial_putbuf() and drained by the transmit
+   interrupt.  It is large enough that writers almost never wait
+   for the UART.  Only modified with interrupts off. */
+#define TXQ_SIZE 65536                  /* Must be a power of 2. */
+static uint8_t txq[TXQ_SIZE];
+static size_t txq_head;                 /* Next byte to put. */
+static size_t txq_tail;                 /* Next byte to transmit. */
+
+/* Threads waiting for room in txq. */
+static struct semaphore txq_room;
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
 static void write_ier (void);
+static void txq_put (uint8_t, bool may_sleep);
 static intr_handler_func serial_interrupt;
 
+/* Returns true if txq holds no bytes. */
+static inline bool
+txq_empty (void) {
+	return txq_head == txq_tail;
+}
+
+/* Returns true if txq has no room for another byte. */
+static inline bool
+txq_full (void) {
+	return txq_head - txq_tail == TXQ_SIZE;
+}
+
+/* Removes and returns the oldest byte in txq, which must not be
+   empty. */
+static inline uint8_t
+txq_get (void) {
+	ASSERT (!txq_empty ());
+	return txq[txq_tail++ % TXQ_SIZE];
+}
+
 /* Initializes the serial port device for polling mode.
    Polling mode busy-waits for the serial port to become free
    before writing to it.  It's slow, but until interrupts have
@@ -67,10 +105,9 @@ static void
 init_poll (void) {
 	ASSERT (mode == UNINIT);
 	outb (IER_REG, 0);                    /* Turn off all interrupts. */
-	outb (FCR_REG, 0);                    /* Disable FIFO. */
+	outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX);
 	set_serial (115200);                  /* 115.2 kbps, N-8-1. */
 	outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-	intq_init (&txq);
 	mode = POLL;
 }
 
@@ -85,6 +122,7 @@ serial_init_queue (void) {
 		init_poll ();
 	ASSERT (mode == POLL);
 
+	sema_init (&txq_room, 0);
 	intr_register_ext (0x20 + 4, serial_interrupt, "serial");
 	mode = QUEUE;
 	old_level = intr_disable ();
@@ -106,29 +144,74 @@ serial_putc (uint8_t byte) {
 	} else {
 		/* Otherwise, queue a byte and update the interrupt enable
 		   register. */
-		if (old_level == INTR_OFF && intq_full (&txq)) {
-			/* Interrupts are off and the transmit queue is full.
-			   If we wanted to wait for the queue to empty,
-			   we'd have to reenable interrupts.
-			   That's impolite, so we'll send a character via
-			   polling instead. */
-			putc_poll (intq_getc (&txq));
-		}
-
-		intq_putc (&txq, byte);
+		txq_put (byte, old_level == INTR_ON);
 		write_ier ();
 	}
 
 	intr_set_level (old_level);
 }
 
+/* Sends the N bytes in BUFFER to the serial port.  Returns as soon
+   as they are queued, which usually does not take waiting for the
+   port.  BUFFER may be user memory, which may fault, so it is
+   copied a chunk at a time into a kernel buffer before interrupts
+   go off to queue the chunk. */
+void
+serial_putbuf (const void *buffer, size_t n) {
+	const uint8_t *p = buffer;
+	enum intr_level old_level;
+
+	if (mode != QUEUE) {
+		while (n-- > 0)
+			serial_putc (*p++);
+		return;
+	}
+
+	while (n > 0) {
+		uint8_t chunk[256];
+		size_t cnt = n < sizeof chunk ? n : sizeof chunk;
+		size_t i;
+
+		memcpy (chunk, p, cnt);
+		old_level = intr_disable ();
+		for (i = 0; i < cnt; i++)
+			txq_put (chunk[i], old_level == INTR_ON);
+		write_ier ();
+		intr_set_level (old_level);
+		p += cnt;
+		n -= cnt;
+	}
+}
+
+/* Adds BYTE to txq, making room first if it is full.  Interrupts
+   must be off.  MAY_SLEEP tells whether the caller had them on, so
+   that we may wait for the transmit interrupt to make room. */
+static void
+txq_put (uint8_t byte, bool may_sleep) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (txq_full ()) {
+		if (!may_sleep || intr_context ()) {
+			/* Waiting for the queue to empty would take
+			   reenabling interrupts.  That's impolite, so
+			   we'll send a character via polling instead. */
+			putc_poll (txq_get ());
+		} else {
+			write_ier ();
+			sema_down (&txq_room);
+		}
+	}
+
+	txq[txq_head++ % TXQ_SIZE] = byte;
+}
+
 /* Flushes anything in the serial buffer out the port in polling
    mode. */
 void
 serial_flush (void) {
 	enum intr_level old_level = intr_disable ();
-	while (!intq_empty (&txq))
-		putc_poll (intq_getc (&txq));
+	while (!txq_empty ())
+		putc_poll (txq_get ());
 	intr_set_level (old_level);
 }
 
@@ -171,7 +254,7 @@ write_ier (void) {
 
 	/* Enable transmit interrupt if we have any characters to
 	   transmit. */
-	if (!intq_empty (&txq))
+	if (!txq_empty ())
 		ier |= IER_XMIT;
 
 	/* Enable receive interrupt if we have room to store any
@@ -205,10 +288,16 @@ serial_interrupt (struct intr_frame *f UNUSED) {
 	while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
 		input_putc (inb (RBR_REG));
 
-	/* As long as we have a byte to transmit, and the hardware is
-	   ready to accept a byte for transmission, transmit a byte. */
-	while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0)
-		outb (THR_REG, intq_getc (&txq));
+	/* Once the transmit FIFO is empty, refill it from the queue and
+	   wake up a thread waiting for room in the queue. */
+	if (!txq_empty () && (inb (LSR_REG) & LSR_THRE) != 0) {
+		int i;
+
+		for (i = 0; i < TX_FIFO_SIZE && !txq_empty (); i++)
+			outb (THR_REG, txq_get ());
+		if (!list_empty (&txq_room.waiters))
+			sema_up (&txq_room);
+	}
 
 	/* Update interrupt enable register based on queue status. */
 	write_ier ();
@@ -5,3 +5,4 @@ devices_SRC += devices/serial.c		# Serial port device.
 devices_SRC += devices/disk.c		# IDE disk device.
 devices_SRC += devices/input.c		# Serial and keyboard input.
 devices_SRC += devices/intq.c		# Interrupt queue.
+devices_SRC += devices/tty.c		# Console line discipline.
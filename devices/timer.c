@@ -129,10 +129,10 @@ void timer_print_stats(void)
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt(struct intr_frame *args UNUSED)
+timer_interrupt(struct intr_frame *args)
 {
 	ticks++;
-	thread_tick();
+	thread_tick((args->cs & 3) == 3);
 	if (thread_mlfqs)
 	{
 		mlfqs_increment();
@@ -0,0 +1,250 @@
+#include "devices/tty.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall-nr.h>
+#include "devices/input.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Line discipline for the console, on top of the keys that the
+   keyboard and the serial port put into the input buffer.
+
+   In canonical mode (TTY_CANON), keys are collected into a line,
+   which may be edited with backspace, and a read returns only once
+   a whole line is in, new-line included.  Ctrl+D ends a line
+   without a new-line; at the start of a line, it makes the read
+   return 0.  With TTY_ECHO, the keys are echoed to the console.
+
+   In raw mode, a read returns as soon as it has MIN bytes or,
+   if TIMEOUT is nonzero, once TIMEOUT milliseconds have passed
+   since it began, whichever is first.  With MIN and TIMEOUT both
+   0, a read takes only the keys already typed.
+
+   Either way, keys are taken out of the input buffer in bulk,
+   not one at a time.
+
+   A reader whose process is exiting stops waiting for keys and
+   returns what it has, which tty_interrupt() makes it notice. */
+
+/* Maximum length of a line in canonical mode. */
+#define LINE_MAX 256
+
+/* Control characters. */
+#define CTRL_D 0x04             /* End of file. */
+#define BS 0x08                 /* Backspace. */
+#define DEL 0x7f                /* Delete, sent by many terminals for
+                                   the backspace key. */
+
+/* Current mode, set by tty_set_mode(). */
+static int mode;
+static unsigned min_bytes;
+static int64_t timeout_ticks;
+
+/* Line being collected in canonical mode.  Once it is finished,
+   READY is the number of its bytes not read yet. */
+static char line[LINE_MAX];
+static size_t line_len;
+static size_t ready;
+
+/* Keys taken out of the input buffer but not processed yet. */
+static uint8_t pending[64];
+static size_t pending_ofs, pending_cnt;
+
+/* Serializes readers and mode changes. */
+static struct lock tty_lock;
+
+/* Initializes the TTY in canonical mode with echo. */
+void
+tty_init (void) {
+	lock_init (&tty_lock);
+	mode = TTY_CANON | TTY_ECHO;
+}
+
+/* Sets the TTY to MODE, a combination of TTY_CANON and TTY_ECHO,
+   with MIN and TIMEOUT, in milliseconds, for raw mode.  Input not
+   read yet is kept.  Returns false if MODE is invalid. */
+bool
+tty_set_mode (int new_mode, unsigned min, unsigned timeout) {
+	if ((new_mode & ~(TTY_CANON | TTY_ECHO)) != 0)
+		return false;
+
+	lock_acquire (&tty_lock);
+	mode = new_mode;
+	min_bytes = min;
+	timeout_ticks = (int64_t) timeout * TIMER_FREQ / 1000;
+	if (timeout > 0 && timeout_ticks == 0)
+		timeout_ticks = 1;
+	lock_release (&tty_lock);
+	return true;
+}
+
+/* Returns true if the current thread must stop waiting for keys,
+   because its process is exiting. */
+static bool
+interrupted (void) {
+#ifdef USERPROG
+	return thread_current ()->proc->exiting;
+#else
+	return false;
+#endif
+}
+
+/* Wakes the reader waiting for keys, if any, so that it gives up
+   if its process is exiting. */
+void
+tty_interrupt (void) {
+	enum intr_level old_level = intr_disable ();
+
+	input_wake ();
+	intr_set_level (old_level);
+}
+
+/* Gets at least one key into BUF, which has room for N, waiting
+   for it if there is none.  Returns the number of keys, which is
+   0 only if interrupted. */
+static size_t
+get_keys (uint8_t *buf, size_t n) {
+	size_t cnt = input_getbuf (buf, n);
+
+	while (cnt == 0 && !interrupted ()) {
+		enum intr_level old_level = intr_disable ();
+
+		/* Checked again with interrupts off, so that
+		   tty_interrupt() cannot come in between. */
+		if (!interrupted ())
+			input_wait ();
+		intr_set_level (old_level);
+		cnt = input_getbuf (buf, n);
+	}
+	return cnt;
+}
+
+/* Adds key C to the line being collected, echoing it if enabled.
+   Returns true if the line is finished. */
+static bool
+cook (uint8_t c) {
+	bool echo = (mode & TTY_ECHO) != 0;
+
+	if (c == BS || c == DEL) {
+		if (line_len > 0) {
+			line_len--;
+			if (echo)
+				putbuf ("\b \b", 3);
+		}
+		return false;
+	}
+	if (c == CTRL_D)
+		return true;
+	if (c == '\r')
+		c = '\n';
+	if (c == '\n' || line_len < LINE_MAX - 1) {
+		line[line_len++] = c;
+		if (echo)
+			putbuf ((char *) &c, 1);
+	}
+	return c == '\n';
+}
+
+/* Removes up to SIZE bytes from the front of the line into BUF and
+   returns the number removed. */
+static size_t
+take_line (void *buf, size_t size) {
+	if (size > line_len)
+		size = line_len;
+	memcpy (buf, line, size);
+	memmove (line, line + size, line_len - size);
+	line_len -= size;
+	ready = ready > size ? ready - size : 0;
+	return size;
+}
+
+/* Reads a line, or the rest of one, into BUF in canonical mode.
+   Returns 0 if the line was ended by Ctrl+D right at its start or
+   if interrupted, in which case the keys so far stay in the line. */
+static size_t
+read_canon (void *buf, size_t size) {
+	while (ready == 0) {
+		bool done = false;
+
+		if (pending_ofs == pending_cnt) {
+			pending_cnt = get_keys (pending, sizeof pending);
+			pending_ofs = 0;
+			if (pending_cnt == 0)
+				return 0;
+		}
+		/* Keys after the end of the line wait for the next read. */
+		while (!done && pending_ofs < pending_cnt)
+			done = cook (pending[pending_ofs++]);
+		if (done) {
+			if (line_len == 0)
+				return 0;
+			ready = line_len;
+		}
+	}
+
+	return take_line (buf, size < ready ? size : ready);
+}
+
+/* Reads up to N bytes into BUF in raw mode, waiting for NEED of
+   them unless the timeout, which runs from START, expires first
+   or the reader is interrupted. */
+static size_t
+read_raw (uint8_t *buf, size_t n, size_t need, int64_t start) {
+	size_t cnt;
+
+	/* Keys left over from canonical mode come first. */
+	cnt = take_line (buf, n);
+	while (cnt < n && pending_ofs < pending_cnt)
+		buf[cnt++] = pending[pending_ofs++];
+
+	cnt += input_getbuf (buf + cnt, n - cnt);
+	if (need > n)
+		need = n;
+	while (cnt < need && !interrupted ()) {
+		if (timeout_ticks == 0)
+			cnt += get_keys (buf + cnt, n - cnt);
+		else if (timer_elapsed (start) >= timeout_ticks)
+			break;
+		else {
+			timer_sleep (1);
+			cnt += input_getbuf (buf + cnt, n - cnt);
+		}
+	}
+	return cnt;
+}
+
+/* Reads up to SIZE bytes of console input into BUF, according to
+   the mode, and returns the number of bytes read, at most LINE_MAX,
+   which is a whole line in canonical mode.  BUF may be user memory,
+   so keys go into a kernel buffer under tty_lock and are copied to
+   BUF only once it is released, which keeps page faults out of the
+   code that holds the lock or runs with interrupts off. */
+size_t
+tty_read (void *buf, size_t size) {
+	uint8_t chunk[LINE_MAX];
+	size_t total;
+
+	if (size == 0)
+		return 0;
+	if (size > sizeof chunk)
+		size = sizeof chunk;
+
+	lock_acquire (&tty_lock);
+	if (mode & TTY_CANON)
+		total = read_canon (chunk, size);
+	else {
+		size_t need = min_bytes < size ? min_bytes : size;
+
+		/* With no minimum, a timeout waits for a single byte. */
+		if (need == 0 && timeout_ticks > 0)
+			need = 1;
+		total = read_raw (chunk, size, need, timer_ticks ());
+	}
+	lock_release (&tty_lock);
+
+	memcpy (buf, chunk, total);
+	return total;
+}
@@ -1,13 +1,22 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "userprog/pipe.h"
+#ifdef VM
+#include "vm/shm.h"
+#endif
 
 /* An open file. */
 struct file {
-	struct inode *inode;        /* File's inode. */
+	struct inode *inode;        /* File's inode, null for a pipe. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	struct pipe *pipe;          /* Pipe this is an end of, if any. */
+	bool pipe_writer;           /* Write end of PIPE? */
+	struct shm *shm;            /* Shared-memory segment, if any. */
+	int ref_cnt;                /* References, dropped by file_close(). */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -20,6 +29,7 @@ file_open (struct inode *inode) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ref_cnt = 1;
 		return file;
 	} else {
 		inode_close (inode);
@@ -28,10 +38,56 @@ file_open (struct inode *inode) {
 	}
 }
 
+/* Opens and returns a new file for one end of PIPE, the write end if
+ * WRITER is true.  The file takes over a reference to that end, which
+ * file_close() drops.  Returns a null pointer if an allocation fails. */
+struct file *
+file_open_pipe (struct pipe *pipe, bool writer) {
+	struct file *file = calloc (1, sizeof *file);
+	if (file != NULL) {
+		file->pipe = pipe;
+		file->pipe_writer = writer;
+		file->ref_cnt = 1;
+	}
+	return file;
+}
+
+/* Returns the pipe FILE is an end of, or a null pointer if it is not a
+ * pipe.  Stores in *WRITER whether it is the write end. */
+struct pipe *
+file_get_pipe (struct file *file, bool *writer) {
+	*writer = file->pipe_writer;
+	return file->pipe;
+}
+
+#ifdef VM
+/* Opens and returns a new file for SHM.  The file takes over a reference
+ * to SHM, which file_close() drops.  Returns a null pointer if an
+ * allocation fails. */
+struct file *
+file_open_shm (struct shm *shm) {
+	struct file *file = calloc (1, sizeof *file);
+	if (file != NULL) {
+		file->shm = shm;
+		file->ref_cnt = 1;
+	}
+	return file;
+}
+
+/* Returns the shared-memory segment FILE is open for, or a null pointer
+ * if it is not one. */
+struct shm *
+file_get_shm (struct file *file) {
+	return file->shm;
+}
+#endif
+
 /* Opens and returns a new file for the same inode as FILE.
  * Returns a null pointer if unsuccessful. */
 struct file *
 file_reopen (struct file *file) {
+	if (file->pipe != NULL || file->shm != NULL)
+		return file_duplicate (file);
 	return file_open (inode_reopen (file->inode));
 }
 
@@ -39,6 +95,21 @@ file_reopen (struct file *file) {
  * same inode as FILE. Returns a null pointer if unsuccessful. */
 struct file *
 file_duplicate (struct file *file) {
+	if (file->pipe != NULL) {
+		struct file *nfile = file_open_pipe (file->pipe, file->pipe_writer);
+		if (nfile != NULL)
+			pipe_dup (file->pipe, file->pipe_writer);
+		return nfile;
+	}
+#ifdef VM
+	if (file->shm != NULL) {
+		struct file *nfile = file_open_shm (file->shm);
+		if (nfile != NULL)
+			shm_get (file->shm);
+		return nfile;
+	}
+#endif
+
 	struct file *nfile = file_open (inode_reopen (file->inode));
 	if (nfile) {
 		nfile->pos = file->pos;
@@ -48,12 +119,41 @@ file_duplicate (struct file *file) {
 	return nfile;
 }
 
-/* Closes FILE. */
+/* Adds a reference to FILE, which file_close() drops, and returns FILE.
+ * A system call takes one while it uses a file, so that another thread
+ * of the process closing the file descriptor meanwhile does not free
+ * the file under it. */
+struct file *
+file_get (struct file *file) {
+	enum intr_level old_level = intr_disable ();
+	file->ref_cnt++;
+	intr_set_level (old_level);
+	return file;
+}
+
+/* Drops a reference to FILE, and closes it once none is left. */
 void
 file_close (struct file *file) {
-	if (file != NULL) {
-		file_allow_write (file);
-		inode_close (file->inode);
+	enum intr_level old_level;
+	bool last;
+
+	if (file == NULL)
+		return;
+	old_level = intr_disable ();
+	last = --file->ref_cnt == 0;
+	intr_set_level (old_level);
+
+	if (last) {
+		if (file->pipe != NULL)
+			pipe_close (file->pipe, file->pipe_writer);
+#ifdef VM
+		else if (file->shm != NULL)
+			shm_put (file->shm);
+#endif
+		else {
+			file_allow_write (file);
+			inode_close (file->inode);
+		}
 		free (file);
 	}
 }
@@ -71,6 +171,11 @@ file_get_inode (struct file *file) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
+	if (file->pipe != NULL)
+		return file->pipe_writer ? -1 : pipe_read (file->pipe, buffer, size);
+	if (file->shm != NULL)
+		return -1;
+
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
 	file->pos += bytes_read;
 	return bytes_read;
@@ -95,6 +200,11 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
+	if (file->pipe != NULL)
+		return file->pipe_writer ? pipe_write (file->pipe, buffer, size) : -1;
+	if (file->shm != NULL)
+		return -1;
+
 	off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
 	file->pos += bytes_written;
 	return bytes_written;
@@ -118,7 +228,7 @@ file_write_at (struct file *file, const void *buffer, off_t size,
 void
 file_deny_write (struct file *file) {
 	ASSERT (file != NULL);
-	if (!file->deny_write) {
+	if (!file->deny_write && file->pipe == NULL && file->shm == NULL) {
 		file->deny_write = true;
 		inode_deny_write (file->inode);
 	}
@@ -140,6 +250,12 @@ file_allow_write (struct file *file) {
 off_t
 file_length (struct file *file) {
 	ASSERT (file != NULL);
+	if (file->pipe != NULL)
+		return 0;
+#ifdef VM
+	if (file->shm != NULL)
+		return shm_size (file->shm);
+#endif
 	return inode_length (file->inode);
 }
 
@@ -201,8 +201,20 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 			break;
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
+			/* Read full sectors directly into caller's buffer, as many
+			 * consecutive ones as possible in one request. */
+			size_t cnt = 1;
+
+			while (cnt < DISK_MAX_SECTORS
+					&& size - chunk_size >= DISK_SECTOR_SIZE
+					&& inode_left - chunk_size >= DISK_SECTOR_SIZE
+					&& byte_to_sector (inode, offset + chunk_size)
+					== sector_idx + cnt) {
+				chunk_size += DISK_SECTOR_SIZE;
+				cnt++;
+			}
+			disk_read_multiple (filesys_disk, sector_idx, buffer + bytes_read,
+					cnt);
 		} else {
 			/* Read sector into bounce buffer, then partially copy
 			 * into caller's buffer. */
@@ -256,8 +268,20 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 			break;
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
+			/* Write full sectors directly to disk, as many consecutive
+			 * ones as possible in one request. */
+			size_t cnt = 1;
+
+			while (cnt < DISK_MAX_SECTORS
+					&& size - chunk_size >= DISK_SECTOR_SIZE
+					&& inode_left - chunk_size >= DISK_SECTOR_SIZE
+					&& byte_to_sector (inode, offset + chunk_size)
+					== sector_idx + cnt) {
+				chunk_size += DISK_SECTOR_SIZE;
+				cnt++;
+			}
+			disk_write_multiple (filesys_disk, sector_idx,
+					buffer + bytes_written, cnt);
 		} else {
 			/* We need a bounce buffer. */
 			if (bounce == NULL) {
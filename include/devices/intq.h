@@ -1,6 +1,7 @@
 #ifndef DEVICES_INTQ_H
 #define DEVICES_INTQ_H
 
+#include <stddef.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 
@@ -37,6 +38,9 @@ void intq_init (struct intq *);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
 uint8_t intq_getc (struct intq *);
+size_t intq_getn (struct intq *, uint8_t *, size_t);
+void intq_wait (struct intq *);
+void intq_wake (struct intq *);
 void intq_putc (struct intq *, uint8_t);
 
 #endif /* devices/intq.h */
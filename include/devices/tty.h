@@ -0,0 +1,12 @@
+#ifndef DEVICES_TTY_H
+#define DEVICES_TTY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void tty_init (void);
+bool tty_set_mode (int mode, unsigned min, unsigned timeout);
+size_t tty_read (void *, size_t);
+void tty_interrupt (void);
+
+#endif /* devices/tty.h */
@@ -1,17 +1,29 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
 #include "filesys/off_t.h"
 
 struct inode;
+struct pipe;
+struct shm;
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
 struct file *file_duplicate (struct file *file);
+struct file *file_get (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
 
+/* Pipes. */
+struct file *file_open_pipe (struct pipe *, bool writer);
+struct pipe *file_get_pipe (struct file *, bool *writer);
+
+/* Shared-memory segments. */
+struct file *file_open_shm (struct shm *);
+struct shm *file_get_shm (struct file *);
+
 /* Reading and writing. */
 off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
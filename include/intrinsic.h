@@ -128,4 +128,41 @@ static __inline void write_msr(uint32_t ecx, uint64_t val) {
 			:: "c" (ecx), "d" (edx), "a" (eax) );
 }
 
+__attribute__((always_inline))
+static __inline uint64_t rcr4(void) {
+	uint64_t val;
+	__asm __volatile("movq %%cr4,%0" : "=r" (val));
+	return val;
+}
+
+__attribute__((always_inline))
+static __inline void lcr4(uint64_t val) {
+	__asm __volatile("movq %0, %%cr4" : : "r" (val) : "memory");
+}
+
+/* Invalidates TLB entries of process-context identifier PCID as TYPE
+   says: for address ADDR alone (0) or all of them (1). */
+__attribute__((always_inline))
+static __inline void invpcid(uint64_t type, uint64_t pcid, uint64_t addr) {
+	struct { uint64_t pcid, addr; } desc = { pcid, addr };
+	__asm __volatile("invpcid %0, %1" : : "m" (desc), "r" (type) : "memory");
+}
+
+/* Runs CPUID for LEAF and stores the results in the given registers. */
+__attribute__((always_inline))
+static __inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx,
+		uint32_t *ecx, uint32_t *edx) {
+	__asm __volatile("cpuid"
+			: "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+			: "a" (leaf), "c" (0));
+}
+
+/* Returns the time-stamp counter. */
+__attribute__((always_inline))
+static __inline uint64_t rdtsc(void) {
+	uint32_t lo, hi;
+	__asm __volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
 #endif /* intrinsic.h */
@@ -0,0 +1,42 @@
+#ifndef __LIB_FAULTSTAT_H
+#define __LIB_FAULTSTAT_H
+
+#include <stdint.h>
+
+/* Kinds of page fault, by what it took to handle them. */
+enum fault_kind {
+	FAULT_FILE,                 /* First touch of a page of a file. */
+	FAULT_ANON,                 /* First touch of anonymous memory read
+	                               from the executable. */
+	FAULT_ZERO,                 /* First touch of memory that starts out
+	                               as zeros. */
+	FAULT_SWAP,                 /* Page brought back in after eviction. */
+	FAULT_STACK,                /* Stack growth. */
+	FAULT_WP,                   /* Write to a write-protected page, as
+	                               after fork. */
+	FAULT_RESIDENT,             /* Page already in memory, loaded by
+	                               another thread meanwhile or only
+	                               unmapped. */
+	FAULT_INVALID,              /* Bad access, not handled. */
+	FAULT_KINDS                 /* Number of kinds. */
+};
+
+/* Latency histogram buckets.  Bucket 0 counts faults handled in fewer
+ * than 2^FAULT_HIST_MIN time-stamp counter cycles, bucket B > 0 those
+ * that took from 2^(FAULT_HIST_MIN + B - 1) up to twice as many, and
+ * the last bucket also those that took longer. */
+#define FAULT_HIST_MIN 10
+#define FAULT_BUCKETS 24
+
+/* Page faults handled, as reported by faultstat(). */
+struct faultstat {
+	int64_t cnt[FAULT_KINDS];       /* Faults of each kind. */
+	int64_t cycles[FAULT_KINDS];    /* Cycles spent handling them. */
+	uint32_t hist[FAULT_KINDS][FAULT_BUCKETS];  /* Latency histograms. */
+};
+
+/* Whose faults faultstat() reports. */
+#define FAULTSTAT_SELF 0        /* The calling process's. */
+#define FAULTSTAT_ALL 1         /* Every process's since boot. */
+
+#endif /* lib/faultstat.h */
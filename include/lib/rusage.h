@@ -0,0 +1,23 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/* Resources used by a process, as reported by getrusage(). */
+struct rusage {
+	int64_t utime;              /* Timer ticks spent in user mode. */
+	int64_t stime;              /* Timer ticks spent in the kernel. */
+	int64_t nvcsw;              /* Context switches from blocking. */
+	int64_t nivcsw;             /* Context switches from preemption. */
+	int64_t majflt;             /* Page faults that read from disk. */
+	int64_t minflt;             /* Page faults served from memory. */
+	int64_t inblock;            /* Disk sectors read. */
+	int64_t oublock;            /* Disk sectors written. */
+	int64_t maxrss;             /* Peak number of resident pages. */
+};
+
+/* Whose resources getrusage() reports. */
+#define RUSAGE_SELF 0           /* The calling process. */
+#define RUSAGE_CHILDREN (-1)    /* Its reaped children, with theirs. */
+
+#endif /* lib/rusage.h */
@@ -36,6 +36,45 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extensions. */
+	SYS_WAITPID,                /* Wait for a child, any child, or poll. */
+	SYS_PIPE,                   /* Create a pipe. */
+	SYS_VMSPLICE,               /* Move user pages into a pipe. */
+	SYS_SHM_OPEN,               /* Open a shared-memory segment. */
+	SYS_SHM_UNLINK,             /* Remove a shared-memory segment's name. */
+	SYS_SENDFILE,               /* Copy between files inside the kernel. */
+	SYS_TTY_MODE,               /* Set how the console reads input. */
+	SYS_GETRUSAGE,              /* Get resources used by a process. */
+	SYS_THREAD_CREATE,          /* Start a thread in the current process. */
+	SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+	SYS_THREAD_EXIT,            /* End the current thread. */
+	SYS_SET_TLS,                /* Set the thread-local storage base. */
+	SYS_BRK,                    /* Move the end of the heap. */
+	SYS_MADVISE,                /* Advise how memory will be used. */
+	SYS_MSYNC,                  /* Write back a file mapping. */
+	SYS_FAULTSTAT,              /* Get page fault counts and latencies. */
 };
 
+/* Options for SYS_WAITPID. */
+#define WNOHANG 1               /* Return 0 if no child has exited yet. */
+
+/* Modes for SYS_TTY_MODE.  Without TTY_CANON, the console is raw. */
+#define TTY_CANON 1             /* Read whole, editable lines. */
+#define TTY_ECHO 2              /* Echo typed keys. */
+
+/* Flags for SYS_MMAP, or'd into its WRITABLE argument. */
+#define MAP_POPULATE 2          /* Load the whole mapping right away. */
+
+/* Advice for SYS_MADVISE. */
+#define MADV_NORMAL 0           /* Read ahead on sequential faults. */
+#define MADV_RANDOM 1           /* Never read ahead. */
+#define MADV_SEQUENTIAL 2       /* Read far ahead, evict behind. */
+#define MADV_WILLNEED 3         /* Load the pages now. */
+#define MADV_DONTNEED 4         /* Drop the pages. */
+
+/* Flags for SYS_MSYNC, one of which must be given. */
+#define MS_ASYNC 1              /* Leave the writes to the flusher. */
+#define MS_SYNC 4               /* Write back before returning. */
+
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,12 @@
+#ifndef __LIB_USER_MALLOC_H
+#define __LIB_USER_MALLOC_H
+
+#include <stddef.h>
+
+/* User-level heap allocator, on top of brk(). */
+void *malloc (size_t);
+void *calloc (size_t, size_t);
+void *realloc (void *, size_t);
+void free (void *);
+
+#endif /* lib/user/malloc.h */
@@ -4,11 +4,19 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <syscall-nr.h>
+#include <faultstat.h>
+#include <rusage.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
@@ -38,9 +46,28 @@ void close (int fd);
 
 int dup2(int oldfd, int newfd);
 
+/* Extensions. */
+pid_t waitpid (pid_t pid, int *status, int options);
+int pipe (int fds[2]);
+int vmsplice (int fd, const void *buffer, unsigned length);
+int shm_open (const char *name, size_t size);
+bool shm_unlink (const char *name);
+int sendfile (int out_fd, int in_fd, off_t offset, unsigned length);
+bool tty_mode (int mode, unsigned min, unsigned timeout);
+int getrusage (int who, struct rusage *usage);
+tid_t thread_create (int (*function) (void *), void *aux, void *tls);
+int thread_join (tid_t tid);
+void thread_exit (int status) NO_RETURN;
+void set_tls (void *tls);
+void *brk (void *addr);
+void *sbrk (intptr_t increment);
+
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+int msync (void *addr, size_t length, int flags);
+int faultstat (int who, struct faultstat *stats);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
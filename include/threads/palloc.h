@@ -17,7 +17,9 @@ extern size_t user_page_limit;
 uint64_t palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_huge_page (enum palloc_flags);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+size_t palloc_count_free (enum palloc_flags);
 
 #endif /* threads/palloc.h */
@@ -41,5 +41,6 @@
 #define PTE_U 0x4                        /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20                       /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40                       /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80                      /* 1=huge page (PDEs and PDPEs). */
 
 #endif /* threads/pte.h */
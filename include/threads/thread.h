@@ -3,6 +3,7 @@
 // #define USERPROG
 #include <debug.h>
 #include <list.h>
+#include <rusage.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
 #include "synch.h"
@@ -106,30 +107,50 @@ struct thread
 	int nice;				   /* 나이스값 */
 	int recent_cpu;			   /* recent_cpu */
 	struct list_elem all_elem; /* for advanced scheduler*/
+	struct rusage usage;	   /* Resources used so far. */
+	struct rusage child_usage; /* Resources used by reaped children. */
+	int64_t rss;			   /* Resident user pages. */
 	int exit_status;
-	struct file **fd_table;
+	struct file **fd_table;	   /* FDT_LIMIT open files, by fd. */
 	int max_fd;
+	struct lock fd_lock;	   /* Protects fd_table and max_fd. */
 	struct list child_list;
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem; /* List element. */
 	struct list_elem donation_elem;
-	struct list_elem child_elem;
 	
 	struct intr_frame fork_if;
-	// struct lock wait_lock;
-    // struct condition wait_cond; 
-	struct semaphore wait_sema;
 	struct thread *parent;
 	
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4; /* Page map level 4 */
+	uintptr_t user_rsp; /* User rsp saved on syscall entry. */
+	struct child_record *record;  /* Own exit record, kept by the parent. */
+	struct list zombie_list;      /* Exit records of exited children. */
+	struct condition child_exit;  /* Signaled when a child exits. */
+	struct semaphore fork_sema;   /* Up when a fork child is set up. */
+	bool fork_succ;               /* Did the last fork succeed? */
+	struct thread *proc;          /* Main thread of the process, which holds
+	                                 the state all its threads share. */
+	uintptr_t fs_base;            /* FS base, for thread-local storage. */
+	int stack_slot;               /* User stack slot, or -1 if none. */
+
+	/* Of the main thread only. */
+	struct list thread_list;      /* Exit records of the other threads. */
+	struct condition thread_done; /* Signaled when one of them exits. */
+	int thread_cnt;               /* Number of them still running. */
+	uint32_t stack_slots;         /* User stack slots in use. */
+	bool exiting;                 /* Must every thread exit? */
+	uintptr_t heap_start;         /* Start of the heap, after the program. */
+	uintptr_t heap_end;           /* Program break: end of the heap. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
+	struct faultstat *faults;     /* Page faults handled, or null. */
 #endif
 
 	/* Owned by thread.c. */
@@ -137,6 +158,9 @@ struct thread
 	unsigned magic;		  /* Detects stack overflow. */
 };
 
+/* Number of entries in a thread's fd_table. */
+#define FDT_LIMIT 1024
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -145,7 +169,7 @@ extern bool thread_mlfqs;
 void thread_init(void);
 void thread_start(void);
 
-void thread_tick(void);
+void thread_tick(bool user);
 void thread_print_stats(void);
 
 typedef void thread_func(void *aux);
@@ -183,6 +207,7 @@ void remove_with_lock(struct lock *lock);
 void refresh_priority(void);
 
 void thread_change(void);
+void thread_add_rss(struct thread *, int pages);
 
 // 소수 연산 매크로 생성
 #define F (1 << 14) // 고정 소수점 비율 정의
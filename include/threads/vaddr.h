@@ -31,6 +31,23 @@
 /* Round down to nearest page boundary. */
 #define pg_round_down(va) (void *) ((uint64_t) (va) & ~PGMASK)
 
+/* Huge pages (bits 0:21), each mapped by one page-directory entry. */
+#define HPGBITS  21                        /* Number of offset bits. */
+#define HPGSIZE  (1 << HPGBITS)            /* Bytes in a huge page. */
+#define HPGMASK  BITMASK(PGSHIFT, HPGBITS) /* Huge page offset bits. */
+#define HPGPAGES (HPGSIZE / PGSIZE)        /* Pages in a huge page. */
+
+/* Gigabyte pages, each mapped by one page-directory-pointer entry.
+ * Only the kernel's direct map uses them. */
+#define GPGBITS  30                        /* Number of offset bits. */
+#define GPGSIZE  (1ul << GPGBITS)          /* Bytes in a gigabyte page. */
+
+/* Offset within a huge page. */
+#define hpg_ofs(va) ((uint64_t) (va) & HPGMASK)
+
+/* Round down to nearest huge page boundary. */
+#define hpg_round_down(va) (void *) ((uint64_t) (va) & ~HPGMASK)
+
 /* Kernel virtual address start */
 #define KERN_BASE LOADER_KERN_BASE
 
@@ -0,0 +1,19 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+#include "filesys/file.h"
+
+struct pipe;
+
+void pipe_init (void);
+void pipe_interrupt (void);
+bool pipe_create (struct file **readp, struct file **writep);
+void pipe_dup (struct pipe *, bool writer);
+void pipe_close (struct pipe *, bool writer);
+
+off_t pipe_read (struct pipe *, void *, off_t);
+off_t pipe_write (struct pipe *, const void *, off_t);
+off_t pipe_vmsplice (struct pipe *, const void *, off_t);
+
+#endif /* userprog/pipe.h */
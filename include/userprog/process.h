@@ -7,6 +7,17 @@ tid_t process_create_initd(const char *file_name);
 tid_t process_fork(const char *name, struct intr_frame *if_);
 int process_exec(void *f_name);
 int process_wait(tid_t);
+tid_t process_waitpid(tid_t, int *status, int options);
+void process_table_init(void);
+bool process_getrusage(int who, struct rusage *);
+tid_t process_thread_create(uintptr_t entry, uint64_t arg0, uint64_t arg1,
+							uintptr_t fs_base);
+int process_thread_join(tid_t);
+int process_exit_group(int status);
+void process_wait_threads(void);
+bool process_end_threads(void);
+void process_check_exit(void);
+void *process_brk(void *addr);
 void process_exit(void);
 void process_activate(struct thread *next);
 // 추가
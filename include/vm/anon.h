@@ -1,13 +1,30 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <stddef.h>
 #include "vm/vm.h"
 struct page;
 enum vm_type;
+struct shm;
+struct zswap_entry;
 
 struct anon_page {
+	size_t swap_slot;           /* Slot holding the page while swapped
+	                               out, or BITMAP_ERROR. */
+	struct shm *shm;            /* Shared-memory segment the page maps, if
+	                               any; it keeps the contents instead. */
+	size_t shm_idx;             /* Page number within SHM. */
+	struct zswap_entry *zswap;  /* Compressed swap entry holding the page
+	                               while swapped out, if any. */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
 
+size_t swap_write (const void *kva);
+void swap_read (size_t slot, void *kva);
+void swap_copy (size_t slot, void *kva);
+void swap_free (size_t slot);
+void swap_print_stats (void);
+void anon_swap_copy (struct page *page, void *kva);
+
 #endif
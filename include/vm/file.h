@@ -4,14 +4,41 @@
 #include "vm/vm.h"
 
 struct page;
+struct supplemental_page_table;
 enum vm_type;
 
+/* -flush: Milliseconds the flusher sleeps between writing back dirty
+ * file pages, 0 for no flusher. */
+extern unsigned flush_interval_ms;
+
 struct file_page {
+	struct file *file;          /* Backing file, private to the page. */
+	off_t ofs;                  /* Offset of the page's data in FILE. */
+	size_t read_bytes;          /* Bytes read from FILE; the rest is zero. */
+	bool shared;                /* Executable text, shared between processes
+	                               through the text cache (VM_MARKER_1). */
+};
+
+/* Where the contents of a lazily loaded page come from.  This is the AUX
+ * of every uninit page that has one: READ_BYTES bytes are read from FILE
+ * at offset OFS and the remaining ZERO_BYTES bytes of the page are zeroed.
+ * FILE is private to the page and closed together with it. */
+struct lazy_load_arg {
+	struct file *file;
+	off_t ofs;
+	size_t read_bytes;
+	size_t zero_bytes;
 };
 
 void vm_file_init (void);
+void file_print_stats (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
+bool file_lazy_load (struct page *page, void *aux);
+bool file_is_cached (const struct lazy_load_arg *arg);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+size_t file_sync (struct supplemental_page_table *spt, void *start,
+		void *end);
+int do_msync (void *addr, size_t length, int flags);
 #endif
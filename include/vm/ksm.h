@@ -0,0 +1,17 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+#include <stddef.h>
+
+struct frame;
+
+/* -ksm: Pages the merge daemon scans per round, 0 for none. */
+extern size_t ksm_pages_to_scan;
+
+/* -ksm-sleep: Milliseconds the merge daemon sleeps between rounds. */
+extern unsigned ksm_sleep_ms;
+
+void ksm_init (void);
+void ksm_forget (struct frame *);
+void ksm_print_stats (void);
+
+#endif /* vm/ksm.h */
@@ -0,0 +1,17 @@
+#ifndef VM_KSWAPD_H
+#define VM_KSWAPD_H
+#include <stddef.h>
+
+/* -kswapd-low: Free user pages below which the page-out daemon wakes up,
+ * 0 for no daemon. */
+extern size_t kswapd_low;
+
+/* -kswapd-high: Free user pages at which the page-out daemon goes back to
+ * sleep. */
+extern size_t kswapd_high;
+
+void kswapd_init (void);
+void kswapd_check (void);
+void kswapd_print_stats (void);
+
+#endif /* vm/kswapd.h */
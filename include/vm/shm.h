@@ -0,0 +1,25 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+struct shm;
+
+/* Maximum length of a shared-memory segment's name. */
+#define SHM_NAME_MAX 14
+
+void shm_init (void);
+struct shm *shm_lookup (const char *name, size_t size);
+bool shm_remove (const char *name);
+void shm_get (struct shm *);
+void shm_put (struct shm *);
+size_t shm_size (struct shm *);
+
+bool shm_attach (struct page *, struct shm *, size_t idx);
+bool shm_copy_page (struct page *src);
+bool shm_swap_in (struct page *page, void *kva);
+bool shm_swap_out (struct page *page);
+void shm_unmap_page (struct page *page);
+
+#endif /* vm/shm.h */
@@ -1,7 +1,11 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <hash.h>
+#include <faultstat.h>
+#include <list.h>
 #include "threads/palloc.h"
+#include "threads/synch.h"
 
 enum vm_type {
 	/* page not initialized */
@@ -33,6 +37,7 @@ enum vm_type {
 
 struct page_operations;
 struct thread;
+struct vma;
 
 #define VM_TYPE(type) ((type) & 7)
 
@@ -46,6 +51,10 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	struct hash_elem spt_elem;      /* Element in supplemental_page_table. */
+	struct list_elem frame_elem;    /* Element in frame's `pages' list. */
+	bool writable;                  /* May the user process write to it? */
+	struct thread *owner;           /* Process whose address space it is in. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -59,12 +68,32 @@ struct page {
 	};
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".
+ * After fork, a frame may be shared copy-on-write by several pages, one per
+ * process.  All of them are on PAGES and REF_CNT counts them; PAGE points to
+ * the first one.  The frame is freed when the last page lets go of it.
+ * Every frame is on the frame table, which eviction sweeps; a pinned frame
+ * is being filled or written out and must not be evicted.  A merged frame
+ * holds identical pages merged by the merge daemon, read-only even if
+ * only one page is left. */
 struct frame {
 	void *kva;
 	struct page *page;
+	struct list pages;          /* Pages mapping this frame. */
+	int ref_cnt;                /* Number of entries in PAGES. */
+	struct list_elem elem;      /* Element in the frame table. */
+	bool pinned;                /* Not to be evicted. */
+	bool merged;                /* Merged by the merge daemon? */
+	struct ksm_node *ksm;       /* What the merge daemon knows of it. */
 };
 
+/* Page replacement policies, chosen with -evict. */
+enum evict_policy {
+	EVICT_CLOCK,                /* Second chance by accessed bit. */
+	EVICT_FIFO                  /* Oldest frame first. */
+};
+extern enum evict_policy evict_policy;
+
 /* The function table for page operations.
  * This is one way of implementing "interface" in C.
  * Put the table of "method" into the struct's member, and
@@ -81,12 +110,41 @@ struct page_operations {
 #define destroy(page) \
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
+/* Readahead state of a mapping.  A fault on NEXT, the page right after
+ * the ones the previous fault read, continues a sequential scan and
+ * doubles WINDOW, the number of pages read ahead of the fault; any other
+ * fault closes it.  madvise() may override this with MADV_RANDOM or
+ * MADV_SEQUENTIAL. */
+struct readahead {
+	void *next;                 /* Where a sequential scan faults next. */
+	size_t window;              /* Pages read ahead of the last fault. */
+	int advice;                 /* MADV_NORMAL, _RANDOM or _SEQUENTIAL. */
+};
+
 /* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+ * It is made up of VMAs, whose pages only get a struct page once touched,
+ * so that per-page state exists only for resident or swapped pages. */
 struct supplemental_page_table {
+	struct hash pages;          /* Pages hashed by their user address. */
+	struct vma **vmas;          /* VMAs, sorted by address. */
+	size_t vma_cnt;             /* Number of VMAs. */
+	size_t vma_cap;             /* Room in VMAS. */
+	struct readahead ra;        /* Readahead outside VMAs. */
+	struct lock lock;           /* Serializes page faults and changes to the
+	                               table among the process's threads. */
 };
 
+/* Fault-around: a fault on a page loaded from a file also maps the
+ * pages of the same FAULT_AROUND_PAGES-page block that can be had without
+ * reading the disk, and a sequential scan reads ahead from RA_MIN_PAGES
+ * up to RA_MAX_PAGES pages at a time. */
+#define FAULT_AROUND_PAGES 16
+#define RA_MIN_PAGES 4
+#define RA_MAX_PAGES 32
+
+/* Maximum size of the user stack. */
+#define STACK_LIMIT (1 << 20)
+
 #include "threads/thread.h"
 void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
@@ -98,8 +156,11 @@ bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
 void vm_init (void);
+void vm_print_stats (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
+bool vm_get_faultstat (int who, struct faultstat *stats);
+void vm_print_faultstat (void);
 
 #define vm_alloc_page(type, upage, writable) \
 	vm_alloc_page_with_initializer ((type), (upage), (writable), NULL, NULL)
@@ -107,6 +168,23 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+void vm_free_frame (struct frame *frame);
+bool vm_map_frame (struct page *page, struct frame *frame);
+bool vm_unlink_frame (struct page *page);
+void vm_release_frame (struct page *page);
+bool vm_remap_frame (struct page *page, struct frame *frame);
+void vm_unmap_frame (struct frame *frame);
+void vm_restore_frame (struct page *page, struct frame *frame, bool dirty);
+bool vm_evict_along (struct page *page, struct page *near);
+bool vm_install_page (struct page *page, void *kva);
+bool vm_reclaim_frame (void);
+struct page *vm_scan_dirty (bool *last);
+struct page *vm_scan_page (bool *wrapped);
+struct page *vm_lock_frame (struct frame *frame, bool *acquired);
+bool vm_merge_page (struct page *page, struct frame *frame);
+void vm_populate (void *addr, size_t page_cnt);
+int do_madvise (void *addr, size_t length, int advice);
+void *vm_steal_page (void *va);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
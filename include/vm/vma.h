@@ -0,0 +1,49 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vm/vm.h"
+
+/* A virtual memory area: a range of pages of a process that are all backed
+ * alike.  mmap(), the loader, the stacks and the heap set up VMAs rather
+ * than a page each.  A page of a VMA gets its struct page only when it is first
+ * touched, so that a large mapping costs nothing up front.
+ *
+ * Page N of a VMA with a FILE holds the bytes of FILE at OFS + N * PGSIZE,
+ * as far as they lie within the first READ_BYTES bytes of the range, and
+ * zeros after them.  It is loaded by INIT, given a struct lazy_load_arg,
+ * except that anonymous pages with nothing to read start out as zeros.
+ * A VMA of a shared-memory segment maps its pages from page OFS / PGSIZE
+ * on.  Without a FILE, the pages are zeros. */
+struct vma {
+	uint8_t *start;             /* First page. */
+	uint8_t *end;               /* End of the last page. */
+	enum vm_type type;          /* Type of the pages, markers included. */
+	bool writable;              /* May the pages be written? */
+	bool mmapped;               /* Made by mmap(), to go with munmap()? */
+	vm_initializer *init;       /* Loads a page from FILE. */
+	struct file *file;          /* Backing file or segment, or null. */
+	off_t ofs;                  /* Offset of START in FILE. */
+	size_t read_bytes;          /* Bytes of FILE in the range. */
+	struct readahead ra;        /* Readahead in the range. */
+};
+
+struct vma *vma_map (void *start, size_t page_cnt, enum vm_type type,
+		bool writable, vm_initializer *init, struct file *file, off_t ofs,
+		size_t read_bytes);
+void vma_unmap (struct supplemental_page_table *, struct vma *);
+struct vma *vma_find (struct supplemental_page_table *, const void *va);
+bool vma_overlaps (struct supplemental_page_table *, const void *start,
+		const void *end);
+bool vma_grow_down (struct supplemental_page_table *, struct vma *,
+		void *start);
+bool vma_set_end (struct supplemental_page_table *, struct vma *,
+		void *end);
+bool vma_page_arg (const struct vma *, const void *va,
+		struct lazy_load_arg *);
+bool vma_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
+void vma_kill (struct supplemental_page_table *);
+
+#endif /* vm/vma.h */
@@ -0,0 +1,17 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stddef.h>
+
+struct zswap_entry;
+
+/* Pages of kernel memory the compressed swap pool may take up. */
+extern size_t zswap_max_pages;
+
+void zswap_init (void);
+struct zswap_entry *zswap_store (const void *kva);
+void zswap_load (struct zswap_entry *, void *kva);
+void zswap_copy (struct zswap_entry *, void *kva);
+void zswap_free (struct zswap_entry *);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */
@@ -138,12 +138,18 @@ puts (const char *s) {
 	return 0;
 }
 
-/* Writes the N characters in BUFFER to the console. */
+/* Writes the N characters in BUFFER to the console.  The serial
+   port gets them all at once, so this returns as soon as they are
+   queued for it. */
 void
 putbuf (const char *buffer, size_t n) {
+	size_t i;
+
 	acquire_console ();
-	while (n-- > 0)
-		putchar_have_lock (*buffer++);
+	write_cnt += n;
+	serial_putbuf (buffer, n);
+	for (i = 0; i < n; i++)
+		vga_putc (buffer[i]);
 	release_console ();
 }
 
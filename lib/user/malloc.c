@@ -0,0 +1,424 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A heap allocator for user programs, on top of the heap that brk()
+   grows and shrinks.
+
+   Requests of up to 1 kB are rounded up to a power of two, their
+   size class, and served from slabs: pages cut into blocks of one
+   class.  Freed blocks go onto the free lists of a cache picked by
+   the caller's stack.  Each thread runs on a stack of its own, so
+   threads seldom share a cache and small requests seldom wait for
+   each other.
+
+   Larger requests get runs of whole pages.  Freed runs are merged
+   with their free neighbors, and a large enough free run at the
+   top of the heap goes back to the kernel. */
+
+#define PAGE_SIZE 4096
+
+/* Size classes: 16, 32, ..., 1024 bytes. */
+#define MIN_SHIFT 4
+#define CLASS_CNT 7
+#define MAX_SMALL (1 << (MIN_SHIFT + CLASS_CNT - 1))
+
+/* Number of caches.  Thread stacks are 64 kB apart. */
+#define CACHE_CNT 32
+#define CACHE_SHIFT 16
+
+/* Free pages at the top of the heap are returned once there are
+   this many. */
+#define TRIM_PAGES 16
+
+#define RUN_MAGIC 0x6e7572a5
+
+/* Header at the start of a run of pages: a slab or a large block. */
+struct run
+  {
+    unsigned magic;             /* Detects bad pointers. */
+    int class;                  /* Size class of a slab, or -1. */
+    size_t page_cnt;            /* Number of pages. */
+    struct run *next;           /* Next free run, by address. */
+  };
+
+/* Bytes of a run taken by its header, keeping blocks 16-byte
+   aligned. */
+#define HDR_SIZE ROUND_UP (sizeof (struct run), 16)
+
+/* Free small block. */
+struct block
+  {
+    struct block *next;
+  };
+
+/* Free small blocks, by size class. */
+struct cache
+  {
+    volatile int lock;
+    struct block *free[CLASS_CNT];
+  };
+
+static struct cache caches[CACHE_CNT];
+
+/* Guards the runs and the heap. */
+static volatile int heap_lock;
+static struct run *free_runs;   /* Free runs, by address. */
+static uint8_t *heap_top;       /* Current program break. */
+static bool resizing;           /* A thread is in brk(). */
+
+/* Spins until it holds LOCK.  Holders make no system calls, brk()
+   included, so a waiter spins for a few list operations, or a
+   page fault of the holder's at worst.  A thread that needs to move
+   the break sets RESIZING and calls brk() with the lock released;
+   only other threads that need to move it wait for it, by
+   retrying. */
+static void
+spin_lock (volatile int *lock)
+{
+  while (__sync_lock_test_and_set (lock, 1))
+    continue;
+}
+
+static void
+spin_unlock (volatile int *lock)
+{
+  __sync_lock_release (lock);
+}
+
+/* Returns the cache for the calling thread. */
+static struct cache *
+current_cache (void)
+{
+  uintptr_t sp = (uintptr_t) __builtin_frame_address (0);
+  return &caches[(sp >> CACHE_SHIFT) % CACHE_CNT];
+}
+
+/* Returns the size class for SIZE bytes, at most MAX_SMALL. */
+static int
+size_class (size_t size)
+{
+  int class = 0;
+
+  while (((size_t) 1 << (MIN_SHIFT + class)) < size)
+    class++;
+  return class;
+}
+
+/* Returns the run that block P belongs to. */
+static struct run *
+run_of (void *p)
+{
+  struct run *run = (struct run *) ((uintptr_t) p & ~(PAGE_SIZE - 1));
+
+  ASSERT (run->magic == RUN_MAGIC);
+  return run;
+}
+
+/* Takes a run of PAGE_CNT pages off the free list, first fit,
+   splitting off the rest, and returns it, or a null pointer if no
+   free run is large enough.  Called with heap_lock held. */
+static struct run *
+take_run (size_t page_cnt)
+{
+  struct run **rp, *run;
+
+  for (rp = &free_runs; *rp != NULL; rp = &(*rp)->next)
+    {
+      run = *rp;
+      if (run->page_cnt < page_cnt)
+        continue;
+      if (run->page_cnt > page_cnt)
+        {
+          struct run *rest = (struct run *) ((uint8_t *) run
+                                             + page_cnt * PAGE_SIZE);
+          rest->magic = RUN_MAGIC;
+          rest->page_cnt = run->page_cnt - page_cnt;
+          rest->next = run->next;
+          *rp = rest;
+        }
+      else
+        *rp = run->next;
+      run->page_cnt = page_cnt;
+      return run;
+    }
+  return NULL;
+}
+
+/* Returns a run of PAGE_CNT pages, or a null pointer.  Takes
+   heap_lock itself, and grows the heap with it released. */
+static struct run *
+alloc_run (size_t page_cnt)
+{
+  struct run *run;
+  uint8_t *top, *new_top;
+
+  for (;;)
+    {
+      spin_lock (&heap_lock);
+      run = take_run (page_cnt);
+      if (run != NULL || !resizing)
+        break;
+      /* Another thread is moving the break.  Retry until it is
+         done, in case a run frees up meanwhile. */
+      spin_unlock (&heap_lock);
+    }
+  if (run != NULL)
+    {
+      spin_unlock (&heap_lock);
+      return run;
+    }
+  resizing = true;
+  top = heap_top;
+  spin_unlock (&heap_lock);
+
+  /* Grow the heap, starting from a page boundary. */
+  if (top == NULL)
+    {
+      top = brk (NULL);
+      top = (uint8_t *) ROUND_UP ((uintptr_t) top, PAGE_SIZE);
+      if (brk (top) != top)
+        top = NULL;
+    }
+  if (top != NULL)
+    {
+      new_top = top + page_cnt * PAGE_SIZE;
+      if (brk (new_top) == new_top)
+        {
+          run = (struct run *) top;
+          run->magic = RUN_MAGIC;
+          run->page_cnt = page_cnt;
+          top = new_top;
+        }
+    }
+
+  spin_lock (&heap_lock);
+  if (top != NULL)
+    heap_top = top;
+  resizing = false;
+  spin_unlock (&heap_lock);
+  return run;
+}
+
+/* Puts RUN on the free list, merging it with free neighbors, and
+   returns the run it ends up part of.  Called with heap_lock
+   held. */
+static struct run *
+insert_run (struct run *run)
+{
+  struct run **rp, *prev = NULL;
+
+  for (rp = &free_runs; *rp != NULL && *rp < run; rp = &(*rp)->next)
+    prev = *rp;
+  run->next = *rp;
+  *rp = run;
+
+  if (run->next != NULL
+      && (uint8_t *) run + run->page_cnt * PAGE_SIZE == (uint8_t *) run->next)
+    {
+      run->page_cnt += run->next->page_cnt;
+      run->next = run->next->next;
+    }
+  if (prev != NULL
+      && (uint8_t *) prev + prev->page_cnt * PAGE_SIZE == (uint8_t *) run)
+    {
+      prev->page_cnt += run->page_cnt;
+      prev->next = run->next;
+      run = prev;
+    }
+  return run;
+}
+
+/* Frees RUN, merging it with free neighbors and giving a large
+   enough free run at the top back to the kernel.  Takes heap_lock
+   itself, and shrinks the heap with it released. */
+static void
+free_run (struct run *run)
+{
+  struct run **rp;
+  bool trimmed;
+
+  spin_lock (&heap_lock);
+  run = insert_run (run);
+  if (resizing || run->next != NULL || run->page_cnt < TRIM_PAGES
+      || (uint8_t *) run + run->page_cnt * PAGE_SIZE != heap_top)
+    {
+      spin_unlock (&heap_lock);
+      return;
+    }
+  for (rp = &free_runs; *rp != run; rp = &(*rp)->next)
+    continue;
+  *rp = NULL;
+  resizing = true;
+  spin_unlock (&heap_lock);
+
+  trimmed = brk (run) == (void *) run;
+
+  spin_lock (&heap_lock);
+  if (trimmed)
+    heap_top = (uint8_t *) run;
+  else
+    insert_run (run);
+  resizing = false;
+  spin_unlock (&heap_lock);
+}
+
+/* Cuts a new slab into blocks of size class CLASS, puts all but one
+   of them on CACHE's free list, and returns that one.  Returns a
+   null pointer if out of memory.  Called without CACHE's lock, which
+   it takes only to put the blocks on the list. */
+static struct block *
+refill (struct cache *cache, int class)
+{
+  size_t size = (size_t) 1 << (MIN_SHIFT + class);
+  struct block *first = NULL, *last = NULL;
+  struct run *slab;
+  uint8_t *p;
+
+  slab = alloc_run (1);
+  if (slab == NULL)
+    return NULL;
+
+  slab->class = class;
+  for (p = (uint8_t *) slab + HDR_SIZE; p + size <= (uint8_t *) slab + PAGE_SIZE;
+       p += size)
+    {
+      struct block *b = (struct block *) p;
+      b->next = first;
+      first = b;
+      if (last == NULL)
+        last = b;
+    }
+
+  spin_lock (&cache->lock);
+  last->next = cache->free[class];
+  cache->free[class] = first->next;
+  spin_unlock (&cache->lock);
+  return first;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  if (size == 0)
+    return NULL;
+
+  if (size <= MAX_SMALL)
+    {
+      struct cache *cache = current_cache ();
+      int class = size_class (size);
+      struct block *b;
+
+      spin_lock (&cache->lock);
+      b = cache->free[class];
+      if (b != NULL)
+        cache->free[class] = b->next;
+      spin_unlock (&cache->lock);
+      if (b == NULL)
+        b = refill (cache, class);
+      return b;
+    }
+  else
+    {
+      struct run *run;
+
+      if (size > SIZE_MAX - HDR_SIZE - PAGE_SIZE)
+        return NULL;
+      run = alloc_run (DIV_ROUND_UP (size + HDR_SIZE, PAGE_SIZE));
+      if (run == NULL)
+        return NULL;
+      run->class = -1;
+      return (uint8_t *) run + HDR_SIZE;
+    }
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  size = a * b;
+  if (size < a || size < b)
+    return NULL;
+
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+  return p;
+}
+
+/* Returns the number of bytes usable in block P. */
+static size_t
+block_size (void *p)
+{
+  struct run *run = run_of (p);
+
+  if (run->class >= 0)
+    return (size_t) 1 << (MIN_SHIFT + run->class);
+  return run->page_cnt * PAGE_SIZE - HDR_SIZE;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly moving
+   it in the process.  If successful, returns the new block; on
+   failure, returns a null pointer.  A call with null OLD_BLOCK is
+   equivalent to malloc(NEW_SIZE).  A call with zero NEW_SIZE is
+   equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  void *new_block;
+  size_t old_size;
+
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  if (old_block == NULL)
+    return malloc (new_size);
+
+  old_size = block_size (old_block);
+  if (new_size <= old_size)
+    return old_block;
+
+  new_block = malloc (new_size);
+  if (new_block != NULL)
+    {
+      memcpy (new_block, old_block, old_size);
+      free (old_block);
+    }
+  return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  struct run *run;
+
+  if (p == NULL)
+    return;
+
+  run = run_of (p);
+  if (run->class >= 0)
+    {
+      struct cache *cache = current_cache ();
+      struct block *b = p;
+
+      spin_lock (&cache->lock);
+      b->next = cache->free[run->class];
+      cache->free[run->class] = b;
+      spin_unlock (&cache->lock);
+    }
+  else
+    free_run (run);
+}
@@ -54,7 +54,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -155,6 +155,21 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+int
+madvise (void *addr, size_t length, int advice) {
+	return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+msync (void *addr, size_t length, int flags) {
+	return syscall3 (SYS_MSYNC, addr, length, flags);
+}
+
+int
+faultstat (int who, struct faultstat *stats) {
+	return syscall2 (SYS_FAULTSTAT, who, stats);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
@@ -194,3 +209,87 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+pid_t
+waitpid (pid_t pid, int *status, int options) {
+	return (pid_t) syscall3 (SYS_WAITPID, pid, status, options);
+}
+
+int
+pipe (int fds[2]) {
+	return syscall1 (SYS_PIPE, fds);
+}
+
+int
+vmsplice (int fd, const void *buffer, unsigned size) {
+	return syscall3 (SYS_VMSPLICE, fd, buffer, size);
+}
+
+int
+shm_open (const char *name, size_t size) {
+	return syscall2 (SYS_SHM_OPEN, name, size);
+}
+
+bool
+shm_unlink (const char *name) {
+	return syscall1 (SYS_SHM_UNLINK, name);
+}
+
+int
+sendfile (int out_fd, int in_fd, off_t offset, unsigned size) {
+	return syscall4 (SYS_SENDFILE, out_fd, in_fd, offset, size);
+}
+
+bool
+tty_mode (int mode, unsigned min, unsigned timeout) {
+	return syscall3 (SYS_TTY_MODE, mode, min, timeout);
+}
+
+int
+getrusage (int who, struct rusage *usage) {
+	return syscall2 (SYS_GETRUSAGE, who, usage);
+}
+
+/* Where a new thread starts: runs FUNCTION (AUX) and exits with the
+   value it returns. */
+static void
+thread_start (int (*function) (void *), void *aux) {
+	thread_exit (function (aux));
+}
+
+tid_t
+thread_create (int (*function) (void *), void *aux, void *tls) {
+	return syscall4 (SYS_THREAD_CREATE, thread_start, function, aux, tls);
+}
+
+int
+thread_join (tid_t tid) {
+	return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (int status) {
+	syscall1 (SYS_THREAD_EXIT, status);
+	NOT_REACHED ();
+}
+
+void
+set_tls (void *tls) {
+	syscall1 (SYS_SET_TLS, tls);
+}
+
+void *
+brk (void *addr) {
+	return (void *) syscall1 (SYS_BRK, addr);
+}
+
+/* Moves the program break by INCREMENT bytes and returns its old
+   position, or (void *) -1 on failure. */
+void *
+sbrk (intptr_t increment) {
+	uint8_t *old = brk (NULL);
+
+	if (increment != 0 && brk (old + increment) != old + increment)
+		return (void *) -1;
+	return old;
+}
@@ -0,0 +1,27 @@
+#ifndef TESTS_BENCH_H
+#define TESTS_BENCH_H
+
+#include <stdint.h>
+#include "tests/lib.h"
+
+/* Helpers for benchmark tests.
+
+   Timings are taken with the CPU's time-stamp counter, which user
+   programs may read because the kernel leaves CR4.TSD clear.
+   Results are logged with bench(), as "(test) bench: ..." lines.
+   They differ from run to run, so tests/bench.pm drops them
+   before comparing a benchmark's output against its .ck file. */
+
+/* Returns the current value of the time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Logs a benchmark result. */
+#define bench(FORMAT, ...) msg ("bench: " FORMAT, __VA_ARGS__)
+
+#endif /* tests/bench.h */
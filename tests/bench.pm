@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# check_bench ([OPTION...], $EXPECTED)
+#
+# Like check_expected, but first sets aside the "(test) bench: ..."
+# result lines logged by benchmark tests, whose values vary from run
+# to run.  The results are reported along with the verdict.
+sub check_bench {
+    my ($expected) = pop @_;
+    my (@options) = @_;
+    our ($test);
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+
+    my (@results) = grep (/^\([^\)]+\) bench: /, @output);
+    print "$_\n" foreach @results;
+    @output = grep (!/^\([^\)]+\) bench: /, @output);
+
+    compare_output ("run", @options, \@output, $expected);
+}
+
+1;
@@ -0,0 +1,52 @@
+/* Measures how long it takes to write 1 MB to the console, first
+   one 64-byte line per write(), then 4 kB per write().  write()
+   returns once the kernel has queued the data for the serial port,
+   so this should run far faster than the port's 115.2 kbps. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define TOTAL (1024 * 1024)
+#define LINE 64
+#define CHUNK 4096
+
+static char buf[CHUNK];
+
+/* Writes TOTAL / 2 bytes of lines from BUF, over and over, to the
+   console in SIZE-byte writes and returns the cycles it took. */
+static uint64_t
+print (size_t size)
+{
+  uint64_t start = rdtsc ();
+  size_t ofs;
+
+  for (ofs = 0; ofs < TOTAL / 2; ofs += size)
+    if (write (1, buf + ofs % CHUNK, size) != (int) size)
+      fail ("write to the console");
+  return rdtsc () - start;
+}
+
+void
+test_main (void)
+{
+  static const size_t sizes[] = { LINE, CHUNK };
+  size_t i;
+
+  /* Line I is 63 copies of a letter and a new-line. */
+  for (i = 0; i < CHUNK / LINE; i++)
+    {
+      memset (buf + i * LINE, 'a' + i % 26, LINE - 1);
+      buf[i * LINE + LINE - 1] = '\n';
+    }
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      uint64_t cycles = print (sizes[i]);
+      bench ("%d kB in %zu-byte writes: %llu cycles per kB",
+             TOTAL / 2 / 1024, sizes[i],
+             (unsigned long long) (cycles / (TOTAL / 2 / 1024)));
+    }
+}
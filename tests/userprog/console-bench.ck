@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+
+# 1 MB of 64-byte lines, 63 copies of a letter each, running through
+# the alphabet and starting over every 64 lines.
+my ($lines) = join ('', map (chr (ord ('a') + $_ % 26) x 63 . "\n", 0...63));
+check_bench (IGNORE_EXIT_CODES => 1,
+             ["(console-bench) begin\n" . $lines x 256
+              . "(console-bench) end\n"]);
+pass;
@@ -0,0 +1,180 @@
+/* Measures the user-level allocator: pairs of small allocations
+   and frees, a batch of mixed sizes, and large blocks.  Checks
+   that blocks keep their contents, that freeing a large block
+   gives its pages back to the kernel, and that several threads
+   can allocate at once. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAIR_CNT 20000
+#define BATCH_CNT 2000
+#define LARGE_CNT 200
+#define LARGE_SIZE (64 * 1024)
+#define THREAD_CNT 4
+
+static void *blocks[BATCH_CNT];
+
+/* Size of block I of the batch. */
+static inline size_t
+batch_size (int i)
+{
+  return 8 + (i * 37) % 1500;
+}
+
+/* Logs the cost of CNT operations that took CYCLES. */
+static void
+report (const char *how, int cnt, uint64_t cycles)
+{
+  bench ("%s: %llu cycles per operation", how,
+         (unsigned long long) (cycles / cnt));
+}
+
+/* Checks that freeing a large block returns its memory. */
+static void
+test_trim (void)
+{
+  void *base, *p;
+
+  free (malloc (16));
+  base = brk (NULL);
+  CHECK ((p = malloc (LARGE_SIZE)) != NULL, "malloc large block");
+  memset (p, 0x5a, LARGE_SIZE);
+  if (brk (NULL) == base)
+    fail ("heap did not grow");
+  free (p);
+  if (brk (NULL) != base)
+    fail ("heap not trimmed after free");
+  msg ("heap trimmed");
+}
+
+static void
+bench_pairs (void)
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < PAIR_CNT; i++)
+    {
+      char *p = malloc (32);
+      if (p == NULL)
+        fail ("malloc failed");
+      p[0] = i;
+      free (p);
+    }
+  report ("malloc/free pair", PAIR_CNT, rdtsc () - start);
+}
+
+static void
+bench_batch (void)
+{
+  uint64_t start;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < BATCH_CNT; i++)
+    if ((blocks[i] = malloc (batch_size (i))) == NULL)
+      fail ("malloc %zu bytes failed", batch_size (i));
+  report ("batched malloc", BATCH_CNT, rdtsc () - start);
+
+  for (i = 0; i < BATCH_CNT; i++)
+    memset (blocks[i], i, batch_size (i));
+  for (i = 0; i < BATCH_CNT; i++)
+    {
+      unsigned char *p = blocks[i];
+      size_t j;
+
+      for (j = 0; j < batch_size (i); j++)
+        if (p[j] != (unsigned char) i)
+          fail ("block %d corrupted", i);
+    }
+  msg ("batch intact");
+
+  start = rdtsc ();
+  for (i = 0; i < BATCH_CNT; i++)
+    free (blocks[i]);
+  report ("batched free", BATCH_CNT, rdtsc () - start);
+}
+
+static void
+bench_large (void)
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < LARGE_CNT; i++)
+    {
+      char *p = malloc (LARGE_SIZE);
+      if (p == NULL)
+        fail ("malloc large block failed");
+      p[0] = p[LARGE_SIZE - 1] = i;
+      free (p);
+    }
+  report ("large malloc/free", LARGE_CNT, rdtsc () - start);
+}
+
+/* Allocates, fills, checks, and frees blocks of mixed sizes. */
+static int
+worker (void *aux)
+{
+  int id = (int) (long) aux;
+  unsigned char *p[64];
+  int round, i;
+
+  for (round = 0; round < 50; round++)
+    {
+      for (i = 0; i < 64; i++)
+        {
+          size_t size = 16 + (i * 53 + id) % 2000;
+          if ((p[i] = malloc (size)) == NULL)
+            return -1;
+          memset (p[i], id + i, size);
+        }
+      for (i = 0; i < 64; i++)
+        {
+          if (p[i][0] != (unsigned char) (id + i))
+            return -1;
+          free (p[i]);
+        }
+    }
+  return id;
+}
+
+static void
+test_threads (void)
+{
+  tid_t tids[THREAD_CNT];
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    if ((tids[i] = thread_create (worker, (void *) (long) i, NULL))
+        == TID_ERROR)
+      fail ("thread_create failed");
+  for (i = 0; i < THREAD_CNT; i++)
+    if (thread_join (tids[i]) != i)
+      fail ("thread %d failed", i);
+  report ("threaded malloc/free", THREAD_CNT * 50 * 64 * 2,
+          rdtsc () - start);
+  msg ("threads done");
+}
+
+void
+test_main (void)
+{
+  char *p;
+
+  test_trim ();
+  bench_pairs ();
+  bench_batch ();
+  bench_large ();
+  test_threads ();
+
+  CHECK ((p = calloc (100, 10)) != NULL, "calloc");
+  CHECK ((p = realloc (p, 5000)) != NULL, "realloc");
+  free (p);
+}
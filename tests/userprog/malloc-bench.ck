@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(malloc-bench) begin
+(malloc-bench) malloc large block
+(malloc-bench) heap trimmed
+(malloc-bench) batch intact
+(malloc-bench) threads done
+(malloc-bench) calloc
+(malloc-bench) realloc
+(malloc-bench) end
+EOF
+pass;
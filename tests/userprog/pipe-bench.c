@@ -0,0 +1,90 @@
+/* Measures pipe throughput between a producer child and a
+   consumer parent.  The producer sends 1 MB in chunks of
+   different sizes, with write() and with vmsplice(), which moves
+   whole pages into the pipe instead of copying them.  The
+   consumer checks every byte it receives. */
+
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define TOTAL (1024 * 1024)
+#define MAX_CHUNK 16384
+
+static char buf[MAX_CHUNK] __attribute__ ((aligned (4096)));
+
+/* Byte number OFS of the stream. */
+static inline char
+pattern (size_t ofs)
+{
+  return ofs * 7 + (ofs >> 12);
+}
+
+/* Runs one producer/consumer pair moving TOTAL bytes in CHUNK-byte
+   pieces and returns the cycles it took. */
+static uint64_t
+transfer (size_t chunk, bool splice)
+{
+  uint64_t start = rdtsc ();
+  size_t ofs, i;
+  int fds[2];
+  pid_t pid;
+  int n;
+
+  if (pipe (fds) != 0)
+    fail ("pipe");
+  if ((pid = fork ("producer")) == 0)
+    {
+      close (fds[0]);
+      for (ofs = 0; ofs < TOTAL; ofs += chunk)
+        {
+          for (i = 0; i < chunk; i++)
+            buf[i] = pattern (ofs + i);
+          n = splice ? vmsplice (fds[1], buf, chunk)
+                     : write (fds[1], buf, chunk);
+          if (n != (int) chunk)
+            exit (1);
+        }
+      exit (0);
+    }
+  close (fds[1]);
+
+  ofs = 0;
+  while ((n = read (fds[0], buf, chunk)) > 0)
+    for (i = 0; i < (size_t) n; i++, ofs++)
+      if (buf[i] != pattern (ofs))
+        fail ("byte %zu is wrong", ofs);
+  close (fds[0]);
+
+  if (ofs != TOTAL)
+    fail ("received %zu bytes instead of %d", ofs, TOTAL);
+  if (wait (pid) != 0)
+    fail ("producer failed");
+  return rdtsc () - start;
+}
+
+void
+test_main (void)
+{
+  static const size_t chunks[] = { 64, 1024, 4096, MAX_CHUNK };
+  size_t i;
+
+  for (i = 0; i < sizeof chunks / sizeof *chunks; i++)
+    {
+      uint64_t cycles = transfer (chunks[i], false);
+      msg ("%d kB through write() in %zu-byte chunks",
+           TOTAL / 1024, chunks[i]);
+      bench ("write() in %zu-byte chunks: %llu cycles per kB", chunks[i],
+             (unsigned long long) (cycles / (TOTAL / 1024)));
+    }
+
+  for (i = 2; i < sizeof chunks / sizeof *chunks; i++)
+    {
+      uint64_t cycles = transfer (chunks[i], true);
+      msg ("%d kB through vmsplice() in %zu-byte chunks",
+           TOTAL / 1024, chunks[i]);
+      bench ("vmsplice() in %zu-byte chunks: %llu cycles per kB", chunks[i],
+             (unsigned long long) (cycles / (TOTAL / 1024)));
+    }
+}
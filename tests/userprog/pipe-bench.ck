@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pipe-bench) begin
+(pipe-bench) 1024 kB through write() in 64-byte chunks
+(pipe-bench) 1024 kB through write() in 1024-byte chunks
+(pipe-bench) 1024 kB through write() in 4096-byte chunks
+(pipe-bench) 1024 kB through write() in 16384-byte chunks
+(pipe-bench) 1024 kB through vmsplice() in 4096-byte chunks
+(pipe-bench) 1024 kB through vmsplice() in 16384-byte chunks
+(pipe-bench) end
+EOF
+pass;
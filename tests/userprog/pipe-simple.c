@@ -0,0 +1,41 @@
+/* Sends a message from a child to its parent through a pipe,
+   reads it until end of file, and checks that writing to a pipe
+   without readers fails. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char message[] = "Hello through the pipe!";
+
+void
+test_main (void) 
+{
+  char buf[64];
+  int fds[2];
+  int total = 0;
+  int n;
+  pid_t pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  if ((pid = fork ("writer")) == 0)
+    {
+      close (fds[0]);
+      if (write (fds[1], message, sizeof message) != sizeof message)
+        exit (1);
+      exit (0);
+    }
+  close (fds[1]);
+
+  while ((n = read (fds[0], buf + total, sizeof buf - total)) > 0)
+    total += n;
+  CHECK (total == sizeof message && !memcmp (buf, message, total),
+         "read message until end of file");
+  CHECK (wait (pid) == 0, "wait for writer");
+  close (fds[0]);
+
+  CHECK (pipe (fds) == 0, "pipe");
+  close (fds[0]);
+  CHECK (write (fds[1], "x", 1) == -1, "write without readers fails");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pipe-simple) begin
+(pipe-simple) pipe
+(pipe-simple) read message until end of file
+(pipe-simple) wait for writer
+(pipe-simple) pipe
+(pipe-simple) write without readers fails
+(pipe-simple) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Checks that getrusage() reports the caller's resident pages,
+   that a child's usage is added to the parent's only once the
+   child is reaped, and that an unknown WHO is rejected. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[4 * 4096];
+
+void
+test_main (void) 
+{
+  struct rusage self, children;
+  pid_t pid;
+  size_t i;
+
+  CHECK (getrusage (RUSAGE_SELF, &self) == 0, "getrusage self");
+  CHECK (self.maxrss > 0, "self has resident pages");
+
+  CHECK (getrusage (RUSAGE_CHILDREN, &children) == 0, "getrusage children");
+  CHECK (children.maxrss == 0, "no children reaped yet");
+
+  if ((pid = fork ("child")) == 0)
+    {
+      for (i = 0; i < sizeof buf; i += 4096)
+        buf[i] = 1;
+      exit (81);
+    }
+  CHECK (wait (pid) == 81, "wait for child");
+
+  CHECK (getrusage (RUSAGE_CHILDREN, &children) == 0, "getrusage children");
+  CHECK (children.maxrss > 0, "child's pages are counted");
+
+  CHECK (getrusage (2, &self) == -1, "reject bad who");
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rusage-simple) begin
+(rusage-simple) getrusage self
+(rusage-simple) self has resident pages
+(rusage-simple) getrusage children
+(rusage-simple) no children reaped yet
+child: exit(81)
+(rusage-simple) wait for child
+(rusage-simple) getrusage children
+(rusage-simple) child's pages are counted
+(rusage-simple) reject bad who
+(rusage-simple) end
+rusage-simple: exit(0)
+EOF
+pass;
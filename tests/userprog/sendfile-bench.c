@@ -0,0 +1,111 @@
+/* Measures copying a 128 kB file with a user-level read()/write()
+   loop against sendfile(), which moves the data inside the kernel,
+   and checks that both copies match the original.  Also sends a
+   short file to the console. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (128 * 1024)
+#define CHUNK 4096
+
+static char buf[CHUNK];
+
+/* Byte number OFS of the source file. */
+static inline char
+pattern (size_t ofs)
+{
+  return ofs * 13 + (ofs >> 9);
+}
+
+/* Creates FILE_SIZE-byte file NAME and returns it, opened. */
+static int
+make_file (const char *name)
+{
+  int fd;
+
+  CHECK (create (name, FILE_SIZE), "create \"%s\"", name);
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  return fd;
+}
+
+/* Checks that file NAME holds the source data. */
+static void
+verify (const char *name)
+{
+  size_t ofs, i;
+  int fd;
+
+  if ((fd = open (name)) < 2)
+    fail ("open \"%s\"", name);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK)
+    {
+      if (read (fd, buf, CHUNK) != CHUNK)
+        fail ("short read from \"%s\"", name);
+      for (i = 0; i < CHUNK; i++)
+        if (buf[i] != pattern (ofs + i))
+          fail ("byte %zu of \"%s\" is wrong", ofs + i, name);
+    }
+  close (fd);
+  msg ("verified \"%s\"", name);
+}
+
+/* Logs the throughput of copying FILE_SIZE bytes in CYCLES. */
+static void
+report (const char *how, uint64_t cycles)
+{
+  bench ("%s: %llu cycles, %llu bytes per kcycle", how,
+         (unsigned long long) cycles,
+         (unsigned long long) (FILE_SIZE * 1000ULL / cycles));
+}
+
+void
+test_main (void)
+{
+  static const char text[] = "(sendfile-bench) sent to the console\n";
+  int src, in, dst, msg_fd;
+  uint64_t start, cycles;
+  size_t ofs, i;
+
+  src = make_file ("src");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK)
+    {
+      for (i = 0; i < CHUNK; i++)
+        buf[i] = pattern (ofs + i);
+      write (src, buf, CHUNK);
+    }
+
+  /* User-level copy loop. */
+  dst = make_file ("copy-rw");
+  if ((in = open ("src")) < 2)
+    fail ("open \"src\"");
+  start = rdtsc ();
+  while (read (in, buf, CHUNK) == CHUNK)
+    write (dst, buf, CHUNK);
+  cycles = rdtsc () - start;
+  close (in);
+  close (dst);
+  verify ("copy-rw");
+  report ("read()/write()", cycles);
+
+  /* In-kernel copy. */
+  dst = make_file ("copy-sf");
+  start = rdtsc ();
+  if (sendfile (dst, src, 0, FILE_SIZE) != FILE_SIZE)
+    fail ("sendfile to \"copy-sf\"");
+  cycles = rdtsc () - start;
+  close (dst);
+  verify ("copy-sf");
+  report ("sendfile()", cycles);
+
+  /* File to console. */
+  msg_fd = make_file ("msg");
+  write (msg_fd, text, strlen (text));
+  if (sendfile (1, msg_fd, 0, strlen (text)) != (int) strlen (text))
+    fail ("sendfile to the console");
+  close (msg_fd);
+  close (src);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sendfile-bench) begin
+(sendfile-bench) create "src"
+(sendfile-bench) open "src"
+(sendfile-bench) create "copy-rw"
+(sendfile-bench) open "copy-rw"
+(sendfile-bench) verified "copy-rw"
+(sendfile-bench) create "copy-sf"
+(sendfile-bench) open "copy-sf"
+(sendfile-bench) verified "copy-sf"
+(sendfile-bench) create "msg"
+(sendfile-bench) open "msg"
+(sendfile-bench) sent to the console
+(sendfile-bench) end
+EOF
+pass;
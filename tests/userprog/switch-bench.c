@@ -0,0 +1,91 @@
+/* Measures the cost of switching between two processes that pass
+   a token back and forth through a pair of pipes, touching a
+   working set of a given number of pages on every turn.  With
+   PCIDs, the TLB entries of each process survive the switches, so
+   larger working sets should cost less per page than when every
+   switch flushes the TLB (boot with -no-pcid to compare). */
+
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define MAX_PAGES 256
+#define ROUNDS 200
+
+static char ws[MAX_PAGES * PAGE_SIZE];
+
+/* Touches one byte in each of the first PAGE_CNT pages of the
+   working set. */
+static void
+touch (size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    ws[i * PAGE_SIZE]++;
+}
+
+/* Passes the token between this process and a child ROUNDS times,
+   each touching PAGE_CNT pages per turn, and returns the cycles it
+   took. */
+static uint64_t
+ping_pong (size_t page_cnt)
+{
+  int to_child[2], to_parent[2];
+  uint64_t start, cycles;
+  char token = 0;
+  pid_t pid;
+  int i;
+
+  if (pipe (to_child) != 0 || pipe (to_parent) != 0)
+    fail ("pipe");
+  touch (page_cnt);
+  if ((pid = fork ("pong")) == 0)
+    {
+      close (to_child[1]);
+      close (to_parent[0]);
+      touch (page_cnt);
+      while (read (to_child[0], &token, 1) == 1)
+        {
+          touch (page_cnt);
+          if (write (to_parent[1], &token, 1) != 1)
+            exit (1);
+        }
+      exit (0);
+    }
+  close (to_child[0]);
+  close (to_parent[1]);
+
+  start = rdtsc ();
+  for (i = 0; i < ROUNDS; i++)
+    {
+      if (write (to_child[1], &token, 1) != 1
+          || read (to_parent[0], &token, 1) != 1)
+        fail ("token lost in round %d", i);
+      touch (page_cnt);
+    }
+  cycles = rdtsc () - start;
+
+  close (to_child[1]);
+  close (to_parent[0]);
+  if (wait (pid) != 0)
+    fail ("child failed");
+  return cycles;
+}
+
+void
+test_main (void)
+{
+  static const size_t sizes[] = { 0, 16, 64, MAX_PAGES };
+  size_t i;
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      uint64_t cycles = ping_pong (sizes[i]);
+      msg ("%d round trips touching %zu pages", ROUNDS, sizes[i]);
+      bench ("%zu pages: %llu cycles per round trip", sizes[i],
+             (unsigned long long) (cycles / ROUNDS));
+    }
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(switch-bench) begin
+(switch-bench) 200 round trips touching 0 pages
+(switch-bench) 200 round trips touching 16 pages
+(switch-bench) 200 round trips touching 64 pages
+(switch-bench) 200 round trips touching 256 pages
+(switch-bench) end
+EOF
+pass;
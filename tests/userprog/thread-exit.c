@@ -0,0 +1,37 @@
+/* Calls exit() in one thread while another spins and the main
+   thread waits to join the spinning one.  The whole process must
+   exit, with the status given to exit(). */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Never set. */
+static volatile bool stop;
+
+static int
+spin (void *aux UNUSED)
+{
+  while (!stop)
+    continue;
+  return 0;
+}
+
+static int
+quit (void *aux UNUSED)
+{
+  exit (57);
+}
+
+void
+test_main (void) 
+{
+  tid_t spinner;
+
+  spinner = thread_create (spin, NULL, NULL);
+  CHECK (spinner != TID_ERROR, "create spinning thread");
+  CHECK (thread_create (quit, NULL, NULL) != TID_ERROR,
+         "create exiting thread");
+  thread_join (spinner);
+  fail ("should have exited");
+}
@@ -0,0 +1,75 @@
+/* Starts several threads that share the process's memory, each
+   with thread-local storage of its own, and joins them. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define CHUNK 1000
+
+/* Thread-local storage block, found through the FS base. */
+struct tls
+  {
+    struct tls *self;
+    int id;
+  };
+
+static struct tls tls[THREAD_CNT + 1];
+static int data[THREAD_CNT * CHUNK];
+static int sums[THREAD_CNT];
+
+static struct tls *
+get_tls (void)
+{
+  struct tls *t;
+  asm volatile ("movq %%fs:0, %0" : "=r" (t));
+  return t;
+}
+
+static int
+worker (void *aux)
+{
+  int id = (int) (long) aux;
+  struct tls *t = get_tls ();
+  int i, sum = 0;
+
+  if (t != &tls[id] || t->id != id)
+    return -1;
+  for (i = 0; i < CHUNK; i++)
+    sum += data[id * CHUNK + i];
+  sums[id] = sum;
+  return id + 100;
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  int i, total = 0;
+
+  for (i = 0; i < THREAD_CNT * CHUNK; i++)
+    data[i] = i;
+
+  tls[THREAD_CNT].self = &tls[THREAD_CNT];
+  tls[THREAD_CNT].id = THREAD_CNT;
+  set_tls (&tls[THREAD_CNT]);
+  CHECK (get_tls () == &tls[THREAD_CNT], "set main thread's TLS");
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tls[i].self = &tls[i];
+      tls[i].id = i;
+      tids[i] = thread_create (worker, (void *) (long) i, &tls[i]);
+      CHECK (tids[i] != TID_ERROR, "create thread %d", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == i + 100, "join thread %d", i);
+  CHECK (thread_join (tids[0]) == -1, "join thread 0 again");
+
+  for (i = 0; i < THREAD_CNT; i++)
+    total += sums[i];
+  CHECK (total == THREAD_CNT * CHUNK * (THREAD_CNT * CHUNK - 1) / 2,
+         "threads summed shared data");
+  CHECK (get_tls () == &tls[THREAD_CNT], "main thread's TLS kept");
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-simple) begin
+(thread-simple) set main thread's TLS
+(thread-simple) create thread 0
+(thread-simple) create thread 1
+(thread-simple) create thread 2
+(thread-simple) create thread 3
+(thread-simple) join thread 0
+(thread-simple) join thread 1
+(thread-simple) join thread 2
+(thread-simple) join thread 3
+(thread-simple) join thread 0 again
+(thread-simple) threads summed shared data
+(thread-simple) main thread's TLS kept
+(thread-simple) end
+thread-simple: exit(0)
+EOF
+pass;
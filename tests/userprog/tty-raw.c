@@ -0,0 +1,26 @@
+/* Reads the console in raw mode with nothing typed: without a
+   minimum or a timeout, read() returns at once, and with a
+   timeout, it returns empty once the timeout passes. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[16];
+
+  CHECK (!tty_mode (0x100, 0, 0), "reject bad mode");
+
+  CHECK (tty_mode (0, 0, 0), "raw mode, no minimum, no timeout");
+  CHECK (read (0, buf, sizeof buf) == 0, "read returns at once");
+
+  CHECK (tty_mode (0, 0, 100), "raw mode, 100 ms timeout");
+  CHECK (read (0, buf, sizeof buf) == 0, "read times out");
+
+  CHECK (tty_mode (0, 4, 100), "raw mode, 4-byte minimum, 100 ms timeout");
+  CHECK (read (0, buf, sizeof buf) == 0, "read times out");
+
+  CHECK (tty_mode (TTY_CANON | TTY_ECHO, 0, 0), "back to canonical mode");
+}
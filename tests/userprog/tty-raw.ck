@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(tty-raw) begin
+(tty-raw) reject bad mode
+(tty-raw) raw mode, no minimum, no timeout
+(tty-raw) read returns at once
+(tty-raw) raw mode, 100 ms timeout
+(tty-raw) read times out
+(tty-raw) raw mode, 4-byte minimum, 100 ms timeout
+(tty-raw) read times out
+(tty-raw) back to canonical mode
+(tty-raw) end
+tty-raw: exit(0)
+EOF
+pass;
@@ -0,0 +1,50 @@
+/* Reaps children in whatever order they exit with waitpid(-1),
+   and polls a busy child with WNOHANG. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+void
+test_main (void) 
+{
+  pid_t pids[CHILD_CNT];
+  bool reaped[CHILD_CNT] = { false };
+  int status;
+  pid_t pid;
+  int i, j;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    if ((pids[i] = fork ("child")) == 0)
+      exit (81 + i);
+  msg ("fork %d children", CHILD_CNT);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid = waitpid (-1, &status, 0);
+      for (j = 0; j < CHILD_CNT; j++)
+        if (pids[j] == pid && !reaped[j])
+          break;
+      if (j == CHILD_CNT)
+        fail ("waitpid(-1) returned unexpected pid %d", pid);
+      if (status != 81 + j)
+        fail ("child %d exited with %d, not %d", j, status, 81 + j);
+      reaped[j] = true;
+    }
+  msg ("reaped all children");
+  CHECK (waitpid (-1, &status, 0) == PID_ERROR, "no children left");
+
+  if ((pid = fork ("child")) == 0)
+    {
+      volatile int spin;
+      for (spin = 0; spin < 100000000; spin++)
+        continue;
+      exit (82);
+    }
+  CHECK (waitpid (pid, &status, WNOHANG) == 0,
+         "busy child not reaped with WNOHANG");
+  CHECK (waitpid (pid, &status, 0) == pid && status == 82,
+         "reaped busy child");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(wait-any) begin
+(wait-any) fork 4 children
+(wait-any) reaped all children
+(wait-any) no children left
+(wait-any) busy child not reaped with WNOHANG
+(wait-any) reaped busy child
+(wait-any) end
+EOF
+pass;
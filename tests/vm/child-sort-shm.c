@@ -0,0 +1,48 @@
+/* Maps the shared-memory segment named argv[1] and "sorts" the
+   bytes of 128 kB chunk number argv[2] in it, in place, using
+   counting sort, a single-pass algorithm. */
+
+#include <debug.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/parallel-merge.h"
+
+#define CHUNK_SIZE (128 * 1024)
+
+size_t histogram[256];
+
+int
+main (int argc UNUSED, char *argv[]) 
+{
+  unsigned char *shared = (unsigned char *) SHM_ADDR;
+  unsigned char *chunk, *p;
+  int handle;
+  size_t size;
+  size_t i;
+
+  /* Set here, as tests/main.c does: tests/lib.c defines it. */
+  test_name = "child-sort-shm";
+  quiet = true;
+
+  CHECK ((handle = shm_open (argv[1], 0)) > 1, "shm_open \"%s\"", argv[1]);
+  size = filesize (handle);
+  CHECK (mmap (shared, size, 1, handle, 0) == shared, "mmap \"%s\"", argv[1]);
+
+  chunk = shared + CHUNK_SIZE * atoi (argv[2]);
+  for (i = 0; i < CHUNK_SIZE; i++)
+    histogram[chunk[i]]++;
+  p = chunk;
+  for (i = 0; i < sizeof histogram / sizeof *histogram; i++) 
+    {
+      size_t j = histogram[i];
+      while (j-- > 0)
+        *p++ = i;
+    }
+
+  munmap (shared);
+  close (handle);
+  
+  return 123;
+}
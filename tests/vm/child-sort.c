@@ -7,8 +7,6 @@
 #include "tests/lib.h"
 #include "tests/main.h"
 
-const char *test_name = "child-sort";
-
 unsigned char buf[128 * 1024];
 size_t histogram[256];
 
@@ -20,6 +18,8 @@ main (int argc UNUSED, char *argv[])
   size_t size;
   size_t i;
 
+  /* Set here, as tests/main.c does: tests/lib.c defines it. */
+  test_name = "child-sort";
   quiet = true;
 
   CHECK ((handle = open (argv[1])) > 1, "open \"%s\"", argv[1]);
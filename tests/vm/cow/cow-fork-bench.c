@@ -0,0 +1,53 @@
+/* Measures fork latency as a function of the parent's resident
+   size.  With copy-on-write, the cost of fork should grow with
+   the number of page table entries to share, not with the amount
+   of memory to copy.  The children check that they see the
+   parent's data and write to it, forcing one private copy each. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MAX_SIZE (4 * 1024 * 1024)
+#define FORK_CNT 8
+
+static char buf[MAX_SIZE];
+
+void
+test_main (void)
+{
+  static const size_t sizes[] = { 64 * 1024, 256 * 1024,
+                                  1024 * 1024, MAX_SIZE };
+  size_t i;
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      size_t size = sizes[i];
+      uint64_t total = 0;
+      int j;
+
+      /* Make SIZE bytes resident. */
+      memset (buf, 'a' + i, size);
+
+      for (j = 0; j < FORK_CNT; j++)
+        {
+          uint64_t start = rdtsc ();
+          pid_t child = fork ("child");
+          if (child == 0)
+            {
+              if (buf[0] != 'a' + (char) i || buf[size - 1] != 'a' + (char) i)
+                exit (1);
+              buf[size / 2] = 0;
+              exit (0);
+            }
+          total += rdtsc () - start;
+          if (child < 0 || wait (child) != 0)
+            fail ("fork with %zu kB resident", size / 1024);
+        }
+      msg ("fork with %zu kB resident", size / 1024);
+      bench ("fork with %zu kB resident: %llu cycles", size / 1024,
+             (unsigned long long) (total / FORK_CNT));
+    }
+}
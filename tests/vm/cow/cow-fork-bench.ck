@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-fork-bench) begin
+(cow-fork-bench) fork with 64 kB resident
+(cow-fork-bench) fork with 256 kB resident
+(cow-fork-bench) fork with 1024 kB resident
+(cow-fork-bench) fork with 4096 kB resident
+(cow-fork-bench) end
+EOF
+pass;
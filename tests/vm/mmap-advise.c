@@ -0,0 +1,114 @@
+/* Exercises madvise() and MAP_POPULATE: a populated mapping takes
+   no faults to read, MADV_DONTNEED zeros anonymous memory and keeps
+   what was written to a mapped file, MADV_WILLNEED loads pages ahead
+   of use, and bad arguments are refused.  Logs the faults taken. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 16
+
+static char page[PAGE_SIZE];
+static char anon[(PAGE_CNT + 1) * PAGE_SIZE];
+
+/* Fills PAGE with the contents of page I of the file. */
+static void
+fill_page (size_t i)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+    page[ofs] = i * 11 + ofs % 241;
+}
+
+/* Returns the page faults taken so far. */
+static long
+fault_cnt (void)
+{
+  struct rusage usage;
+
+  CHECK (getrusage (RUSAGE_SELF, &usage) == 0, "getrusage");
+  return usage.minflt + usage.majflt;
+}
+
+/* Checks that the PAGE_CNT pages at ADDR hold the file's contents and
+   logs the faults that took. */
+static void
+verify (const char *addr, const char *name)
+{
+  long faults;
+  size_t i;
+
+  quiet = true;
+  faults = fault_cnt ();
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      fill_page (i);
+      if (memcmp (addr + i * PAGE_SIZE, page, PAGE_SIZE))
+        fail ("page %zu of %s mapping has bad data", i, name);
+    }
+  bench ("%s: %ld faults for %d pages", name, fault_cnt () - faults,
+         PAGE_CNT);
+  quiet = false;
+}
+
+void
+test_main (void)
+{
+  char *populated = (char *) 0x10000000;
+  char *advised = (char *) 0x20000000;
+  char *buf = (char *) (((uintptr_t) anon + PAGE_SIZE - 1)
+                        & ~(uintptr_t) (PAGE_SIZE - 1));
+  int handle;
+  size_t i;
+
+  CHECK (create ("data", PAGE_CNT * PAGE_SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      fill_page (i);
+      if (write (handle, page, PAGE_SIZE) != PAGE_SIZE)
+        fail ("write page %zu", i);
+    }
+
+  CHECK (mmap (populated, PAGE_CNT * PAGE_SIZE, 1 | MAP_POPULATE, handle, 0)
+         != MAP_FAILED, "mmap \"data\" with MAP_POPULATE");
+  verify (populated, "populated");
+
+  /* Dirty a page of the file, drop it, and read it back. */
+  populated[0] = 'x';
+  CHECK (madvise (populated, PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise MADV_DONTNEED on file page");
+  CHECK (populated[0] == 'x', "written byte survives");
+  fill_page (0);
+  populated[0] = page[0];
+  munmap (populated);
+
+  CHECK (mmap (advised, PAGE_CNT * PAGE_SIZE, 0, handle, 0) != MAP_FAILED,
+         "mmap \"data\"");
+  CHECK (madvise (advised, PAGE_CNT * PAGE_SIZE, MADV_RANDOM) == 0,
+         "madvise MADV_RANDOM");
+  CHECK (madvise (advised, PAGE_CNT * PAGE_SIZE, MADV_WILLNEED) == 0,
+         "madvise MADV_WILLNEED");
+  verify (advised, "willneed");
+  munmap (advised);
+  close (handle);
+
+  /* Anonymous memory reads as zeros once dropped. */
+  memset (buf, 0xcc, PAGE_CNT * PAGE_SIZE);
+  CHECK (madvise (buf, PAGE_CNT * PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise MADV_DONTNEED on anonymous memory");
+  for (i = 0; i < PAGE_CNT * PAGE_SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu is %02hhx after MADV_DONTNEED", i, buf[i]);
+  msg ("dropped memory reads as zeros");
+
+  CHECK (madvise (buf + 1, PAGE_SIZE, MADV_DONTNEED) == -1,
+         "madvise misaligned address");
+  CHECK (madvise (buf, PAGE_SIZE, 42) == -1, "madvise bad advice");
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-advise) begin
+(mmap-advise) create "data"
+(mmap-advise) open "data"
+(mmap-advise) mmap "data" with MAP_POPULATE
+(mmap-advise) madvise MADV_DONTNEED on file page
+(mmap-advise) written byte survives
+(mmap-advise) mmap "data"
+(mmap-advise) madvise MADV_RANDOM
+(mmap-advise) madvise MADV_WILLNEED
+(mmap-advise) madvise MADV_DONTNEED on anonymous memory
+(mmap-advise) dropped memory reads as zeros
+(mmap-advise) madvise misaligned address
+(mmap-advise) madvise bad advice
+(mmap-advise) end
+EOF
+pass;
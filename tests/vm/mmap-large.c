@@ -0,0 +1,63 @@
+/* Maps a one-page file over 1 GB of address space, several times,
+   touches a few pages of each mapping and unmaps them again.  The
+   mappings are set up without a page of bookkeeping each, so this
+   fits in the kernel's memory; logs what setting them up and tearing
+   them down costs. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define MAP_SIZE ((size_t) 1 << 30)
+#define MAP_CNT 4
+
+static char page[PAGE_SIZE];
+
+void
+test_main (void)
+{
+  char *base = (char *) 0x100000000;
+  char *maps[MAP_CNT];
+  uint64_t start;
+  int handle;
+  int i;
+
+  memset (page, 'm', sizeof page);
+  CHECK (create ("data", PAGE_SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (write (handle, page, PAGE_SIZE) == PAGE_SIZE, "write \"data\"");
+
+  start = rdtsc ();
+  for (i = 0; i < MAP_CNT; i++)
+    {
+      maps[i] = base + i * MAP_SIZE;
+      if (mmap (maps[i], MAP_SIZE, 0, handle, 0) == MAP_FAILED)
+        fail ("mmap %d failed", i);
+    }
+  bench ("mmap: %llu cycles per 1 GB mapping",
+         (unsigned long long) ((rdtsc () - start) / MAP_CNT));
+  msg ("mapped %d GB", MAP_CNT);
+
+  for (i = 0; i < MAP_CNT; i++)
+    {
+      if (maps[i][0] != 'm' || maps[i][PAGE_SIZE - 1] != 'm')
+        fail ("first page of mapping %d has bad data", i);
+      if (maps[i][MAP_SIZE / 2] != 0 || maps[i][MAP_SIZE - 1] != 0)
+        fail ("mapping %d is not zero past the end of the file", i);
+    }
+  msg ("data as expected");
+
+  start = rdtsc ();
+  for (i = 0; i < MAP_CNT; i++)
+    munmap (maps[i]);
+  bench ("munmap: %llu cycles per 1 GB mapping",
+         (unsigned long long) ((rdtsc () - start) / MAP_CNT));
+
+  CHECK (mmap (base, MAP_SIZE, 0, handle, 0) != MAP_FAILED,
+         "mmap again where unmapped");
+  close (handle);
+}
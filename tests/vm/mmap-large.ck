@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-large) begin
+(mmap-large) create "data"
+(mmap-large) open "data"
+(mmap-large) write "data"
+(mmap-large) mapped 4 GB
+(mmap-large) data as expected
+(mmap-large) mmap again where unmapped
+(mmap-large) end
+EOF
+pass;
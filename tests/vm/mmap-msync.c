@@ -0,0 +1,103 @@
+/* Exercises msync(): after MS_SYNC, what was written through a
+   mapping can be read back from the file before it is unmapped,
+   MS_ASYNC succeeds, and bad arguments are refused.  Logs the time
+   taken to write back and to unmap a mapping whose pages are all
+   dirty, and checks that munmap writes back what msync left. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+
+static char page[PAGE_SIZE];
+
+/* Fills PAGE with the contents of page I of the file after
+   ROUND rounds of writes. */
+static void
+fill_page (size_t i, int round)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+    page[ofs] = i * 13 + round * 5 + ofs % 251;
+}
+
+/* Writes round ROUND of the contents through the mapping at
+   ADDR. */
+static void
+write_pages (char *addr, int round)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      fill_page (i, round);
+      memcpy (addr + i * PAGE_SIZE, page, PAGE_SIZE);
+    }
+}
+
+/* Checks that the file open as HANDLE holds round ROUND of the
+   contents. */
+static void
+check_data (int handle, int round)
+{
+  static char buf[PAGE_SIZE];
+  size_t i;
+
+  seek (handle, 0);
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      fill_page (i, round);
+      if (read (handle, buf, PAGE_SIZE) != PAGE_SIZE
+          || memcmp (buf, page, PAGE_SIZE))
+        fail ("page %zu of \"data\" has bad data", i);
+    }
+}
+
+void
+test_main (void)
+{
+  char *addr = (char *) 0x10000000;
+  uint64_t start;
+  int handle;
+  size_t i;
+
+  CHECK (create ("data", PAGE_CNT * PAGE_SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      fill_page (i, 0);
+      if (write (handle, page, PAGE_SIZE) != PAGE_SIZE)
+        fail ("write page %zu", i);
+    }
+  CHECK (mmap (addr, PAGE_CNT * PAGE_SIZE, 1, handle, 0) != MAP_FAILED,
+         "mmap \"data\"");
+
+  write_pages (addr, 1);
+  start = rdtsc ();
+  CHECK (msync (addr, PAGE_CNT * PAGE_SIZE, MS_SYNC) == 0, "msync MS_SYNC");
+  bench ("msync of %d dirty pages: %llu cycles", PAGE_CNT, rdtsc () - start);
+  check_data (handle, 1);
+  msg ("file holds what was written");
+
+  write_pages (addr, 2);
+  CHECK (msync (addr, PAGE_CNT * PAGE_SIZE, MS_ASYNC) == 0, "msync MS_ASYNC");
+  CHECK (msync (addr + 1, PAGE_SIZE, MS_SYNC) == -1,
+         "msync misaligned address");
+  CHECK (msync (addr, (PAGE_CNT + 1) * PAGE_SIZE, MS_SYNC) == -1,
+         "msync past the mapping");
+  CHECK (msync (addr, PAGE_SIZE, 0) == -1, "msync without flags");
+  CHECK (msync (addr, PAGE_SIZE, MS_SYNC | MS_ASYNC) == -1,
+         "msync with both flags");
+
+  start = rdtsc ();
+  munmap (addr);
+  bench ("munmap of %d dirty pages: %llu cycles", PAGE_CNT, rdtsc () - start);
+  check_data (handle, 2);
+  msg ("munmap wrote back the rest");
+  close (handle);
+}
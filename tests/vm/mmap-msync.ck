@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-msync) begin
+(mmap-msync) create "data"
+(mmap-msync) open "data"
+(mmap-msync) mmap "data"
+(mmap-msync) msync MS_SYNC
+(mmap-msync) file holds what was written
+(mmap-msync) msync MS_ASYNC
+(mmap-msync) msync misaligned address
+(mmap-msync) msync past the mapping
+(mmap-msync) msync without flags
+(mmap-msync) msync with both flags
+(mmap-msync) munmap wrote back the rest
+(mmap-msync) end
+EOF
+pass;
@@ -0,0 +1,81 @@
+/* Writes a file of many pages, maps it and reads it through the
+   mapping from start to end, then does the same in an order that
+   jumps around.  Readahead should spare most page faults of the
+   sequential scan; logs the faults taken by each and checks the
+   data. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+
+static char page[PAGE_SIZE];
+
+/* Fills PAGE with the contents of page I of the file. */
+static void
+fill_page (size_t i)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+    page[ofs] = i * 7 + ofs % 253;
+}
+
+/* Returns the page faults taken so far. */
+static long
+fault_cnt (void)
+{
+  struct rusage usage;
+
+  CHECK (getrusage (RUSAGE_SELF, &usage) == 0, "getrusage");
+  return usage.minflt + usage.majflt;
+}
+
+/* Maps the file open as HANDLE at ADDR and reads its pages in the
+   order in which STRIDE steps through them, checking each. */
+static void
+scan (int handle, char *addr, size_t stride, const char *name)
+{
+  void *map;
+  long faults;
+  size_t i, n;
+
+  CHECK ((map = mmap (addr, PAGE_CNT * PAGE_SIZE, 0, handle, 0))
+         != MAP_FAILED, "mmap \"data\" for %s scan", name);
+  quiet = true;
+  faults = fault_cnt ();
+  for (i = n = 0; n < PAGE_CNT; i = (i + stride) % PAGE_CNT, n++)
+    {
+      fill_page (i);
+      if (memcmp (addr + i * PAGE_SIZE, page, PAGE_SIZE))
+        fail ("page %zu of %s scan has bad data", i, name);
+    }
+  bench ("%s scan: %ld faults for %d pages", name, fault_cnt () - faults,
+         PAGE_CNT);
+  quiet = false;
+  munmap (map);
+}
+
+void
+test_main (void)
+{
+  int handle;
+  size_t i;
+
+  CHECK (create ("data", PAGE_CNT * PAGE_SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      fill_page (i);
+      if (write (handle, page, PAGE_SIZE) != PAGE_SIZE)
+        fail ("write page %zu", i);
+    }
+
+  scan (handle, (char *) 0x10000000, 1, "sequential");
+  scan (handle, (char *) 0x20000000, 37, "random");
+  close (handle);
+}
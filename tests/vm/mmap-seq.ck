@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-seq) begin
+(mmap-seq) create "data"
+(mmap-seq) open "data"
+(mmap-seq) mmap "data" for sequential scan
+(mmap-seq) mmap "data" for random scan
+(mmap-seq) end
+EOF
+pass;
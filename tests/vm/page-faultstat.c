@@ -0,0 +1,106 @@
+/* Takes a page fault of each kind that faultstat() tells apart,
+   except for swapping in and bad accesses, and checks that each is
+   counted as such, that the latency histograms add up, and that the
+   system-wide counts include the process's own.  Logs the mean
+   cycles taken by each kind. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static const char *names[FAULT_KINDS] = {
+  "lazy file", "lazy anon", "zero-fill", "swap-in", "stack growth",
+  "write-protect", "resident", "invalid",
+};
+
+static char data[4 * PAGE_SIZE] = { 1 };
+static char bss[4 * PAGE_SIZE];
+static char page[PAGE_SIZE];
+
+/* Returns the process's count of faults of KIND. */
+static long long
+fault_cnt (enum fault_kind kind)
+{
+  struct faultstat stats;
+
+  CHECK (faultstat (FAULTSTAT_SELF, &stats) == 0, "faultstat");
+  return stats.cnt[kind];
+}
+
+/* Grows the stack by several pages. */
+static void __attribute__ ((noinline))
+grow_stack (void)
+{
+  volatile char buf[8 * PAGE_SIZE];
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i += PAGE_SIZE)
+    buf[i] = i;
+}
+
+void
+test_main (void)
+{
+  struct faultstat self, all;
+  char *addr = (char *) 0x10000000;
+  long long before;
+  int handle, kind, bucket;
+
+  CHECK (create ("data", PAGE_SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  memset (page, 'x', PAGE_SIZE);
+  CHECK (write (handle, page, PAGE_SIZE) == PAGE_SIZE, "write \"data\"");
+  CHECK (mmap (addr, PAGE_SIZE, 0, handle, 0) != MAP_FAILED, "mmap \"data\"");
+
+  quiet = true;
+  before = fault_cnt (FAULT_FILE);
+  if (*(volatile char *) addr != 'x')
+    fail ("mapped file has bad data");
+  CHECK (fault_cnt (FAULT_FILE) > before, "lazy file fault counted");
+
+  before = fault_cnt (FAULT_ANON);
+  data[2 * PAGE_SIZE]++;
+  CHECK (fault_cnt (FAULT_ANON) > before, "lazy anon fault counted");
+
+  before = fault_cnt (FAULT_ZERO);
+  if (*(volatile char *) &bss[2 * PAGE_SIZE] != 0)
+    fail ("bss is not zero");
+  CHECK (fault_cnt (FAULT_ZERO) > before, "zero-fill fault counted");
+
+  before = fault_cnt (FAULT_WP);
+  bss[2 * PAGE_SIZE] = 1;
+  CHECK (fault_cnt (FAULT_WP) > before, "write-protect fault counted");
+
+  before = fault_cnt (FAULT_STACK);
+  grow_stack ();
+  CHECK (fault_cnt (FAULT_STACK) > before, "stack growth fault counted");
+  quiet = false;
+
+  CHECK (faultstat (FAULTSTAT_SELF, &self) == 0, "faultstat FAULTSTAT_SELF");
+  CHECK (faultstat (FAULTSTAT_ALL, &all) == 0, "faultstat FAULTSTAT_ALL");
+  CHECK (faultstat (2, &self) == -1, "faultstat bad who");
+  for (kind = 0; kind < FAULT_KINDS; kind++)
+    {
+      long long sum = 0;
+
+      for (bucket = 0; bucket < FAULT_BUCKETS; bucket++)
+        sum += self.hist[kind][bucket];
+      if (sum != self.cnt[kind])
+        fail ("%s histogram holds %lld faults, not %lld",
+              names[kind], sum, self.cnt[kind]);
+      if (all.cnt[kind] < self.cnt[kind])
+        fail ("%lld %s faults in all, fewer than %lld in this process",
+              all.cnt[kind], names[kind], self.cnt[kind]);
+      if (self.cnt[kind] > 0)
+        bench ("%s: %lld faults, mean %lld cycles", names[kind],
+               self.cnt[kind], self.cycles[kind] / self.cnt[kind]);
+    }
+  msg ("histograms add up");
+
+  munmap (addr);
+  close (handle);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-faultstat) begin
+(page-faultstat) create "data"
+(page-faultstat) open "data"
+(page-faultstat) write "data"
+(page-faultstat) mmap "data"
+(page-faultstat) faultstat FAULTSTAT_SELF
+(page-faultstat) faultstat FAULTSTAT_ALL
+(page-faultstat) faultstat bad who
+(page-faultstat) histograms add up
+(page-faultstat) end
+EOF
+pass;
@@ -0,0 +1,67 @@
+/* Sweeps two heap regions of almost 2 MB each, page by page: one
+   that covers a whole aligned huge page, which the kernel may map
+   with a single page-directory entry, and one that falls a page
+   short of it and so is mapped in 4 kB pages.  Logs the cost of
+   the first touch and of later sweeps in each, and checks that
+   the data survives. */
+
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HUGE_SIZE (2 * 1024 * 1024)
+#define SWEEPS 64
+
+/* Logs the cost per page of touching PAGE_CNT pages SWEEPS times
+   in CYCLES. */
+static void
+report (const char *name, const char *how, size_t page_cnt, int sweeps,
+        uint64_t cycles)
+{
+  bench ("%s region, %s: %llu cycles per page", name, how,
+         (unsigned long long) (cycles / (page_cnt * sweeps)));
+}
+
+/* Sweeps the PAGE_CNT pages at BUF, writing each once and then
+   reading them over and over. */
+static void
+sweep (const char *name, volatile char *buf, size_t page_cnt)
+{
+  uint64_t start;
+  size_t i;
+  int round;
+  volatile int sum = 0;
+
+  start = rdtsc ();
+  for (i = 0; i < page_cnt; i++)
+    buf[i * PAGE_SIZE] = i;
+  report (name, "first touch", page_cnt, 1, rdtsc () - start);
+
+  start = rdtsc ();
+  for (round = 0; round < SWEEPS; round++)
+    for (i = 0; i < page_cnt; i++)
+      sum += buf[i * PAGE_SIZE];
+  report (name, "sweep", page_cnt, SWEEPS, rdtsc () - start);
+
+  for (i = 0; i < page_cnt; i++)
+    if (buf[i * PAGE_SIZE] != (char) i)
+      fail ("%s region: page %zu corrupted", name, i);
+  msg ("%s region intact", name);
+}
+
+void
+test_main (void)
+{
+  char *base = brk (NULL);
+  char *huge = (char *) (((uintptr_t) base + HUGE_SIZE - 1)
+                         & ~(uintptr_t) (HUGE_SIZE - 1));
+  char *small = huge + HUGE_SIZE;
+  char *end = small + HUGE_SIZE - PAGE_SIZE;
+
+  CHECK (brk (end) == end, "grow heap");
+  sweep ("huge", huge, HUGE_SIZE / PAGE_SIZE);
+  sweep ("small", small, HUGE_SIZE / PAGE_SIZE - 1);
+  CHECK (brk (base) == base, "shrink heap");
+}
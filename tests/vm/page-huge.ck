@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-huge) begin
+(page-huge) grow heap
+(page-huge) huge region intact
+(page-huge) small region intact
+(page-huge) shrink heap
+(page-huge) end
+EOF
+pass;
@@ -0,0 +1,74 @@
+/* Fills many pages with a few distinct contents and idles while
+   the merge daemon runs, then writes to every other page, which
+   must split merged pages again, and checks that each page holds
+   exactly what was written to it.  Logs how many of the writes
+   faulted, which is how many pages had been merged. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 256
+#define KINDS 4
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+/* Fills the page at P with contents of kind KIND. */
+static void
+fill_page (char *p, int kind)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    p[i] = kind * 37 + i % 251;
+}
+
+/* Returns the page faults taken so far. */
+static long
+fault_cnt (void)
+{
+  struct rusage usage;
+
+  CHECK (getrusage (RUSAGE_SELF, &usage) == 0, "getrusage");
+  return usage.minflt + usage.majflt;
+}
+
+void
+test_main (void)
+{
+  char expect[PAGE_SIZE];
+  char c;
+  long faults;
+  size_t i;
+  int round;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    fill_page (buf + i * PAGE_SIZE, i % KINDS);
+
+  /* Wait in the kernel, so that the merge daemon gets to run. */
+  CHECK (tty_mode (0, 0, 100), "raw mode, 100 ms timeout");
+  for (round = 0; round < 20; round++)
+    read (STDIN_FILENO, &c, 1);
+  CHECK (tty_mode (TTY_CANON | TTY_ECHO, 0, 0), "back to canonical mode");
+
+  quiet = true;
+  faults = fault_cnt ();
+  for (i = 0; i < PAGE_CNT; i += 2)
+    buf[i * PAGE_SIZE] = -1;
+  bench ("%ld of %d writes faulted", fault_cnt () - faults, PAGE_CNT / 2);
+  quiet = false;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      fill_page (expect, i % KINDS);
+      if (i % 2 == 0)
+        expect[0] = -1;
+      if (memcmp (buf + i * PAGE_SIZE, expect, PAGE_SIZE))
+        fail ("page %zu has the wrong contents", i);
+    }
+  msg ("all pages intact");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-ksm) begin
+(page-ksm) raw mode, 100 ms timeout
+(page-ksm) back to canonical mode
+(page-ksm) all pages intact
+(page-ksm) end
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Runs the parallel merge twice, first handing the chunks to the
+   sorting children in files, then in a shared-memory segment,
+   and reports how long each took and the speedup. */
+
+#include "tests/bench.h"
+#include "tests/main.h"
+#include "tests/vm/parallel-merge.h"
+
+void
+test_main (void) 
+{
+  uint64_t start, files, shared;
+
+  start = rdtsc ();
+  parallel_merge ("child-sort", 123);
+  files = rdtsc () - start;
+
+  start = rdtsc ();
+  parallel_merge_shm ("child-sort-shm", 123);
+  shared = rdtsc () - start;
+
+  bench ("files: %llu cycles", (unsigned long long) files);
+  bench ("shared memory: %llu cycles", (unsigned long long) shared);
+  bench ("speedup: %llu.%02llux", (unsigned long long) (files / shared),
+         (unsigned long long) (files * 100 / shared % 100));
+}
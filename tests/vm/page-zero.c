@@ -0,0 +1,52 @@
+/* Reads through a large BSS array that is never written, which
+   should map the shared zero page instead of taking memory, then
+   writes a few of its pages and checks that only those change.
+   Logs the cost per page of the reads. */
+
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 2048
+
+static char zeros[PAGE_CNT * PAGE_SIZE];
+
+/* Returns the peak number of resident pages so far. */
+static int64_t
+maxrss (void)
+{
+  struct rusage usage;
+
+  CHECK (getrusage (RUSAGE_SELF, &usage) == 0, "getrusage");
+  return usage.maxrss;
+}
+
+void
+test_main (void)
+{
+  int64_t before;
+  uint64_t start;
+  size_t i;
+
+  quiet = true;
+  before = maxrss ();
+  start = rdtsc ();
+  for (i = 0; i < PAGE_CNT; i++)
+    if (zeros[i * PAGE_SIZE] != 0)
+      fail ("page %zu not zero", i);
+  bench ("read fault: %llu cycles per page",
+         (unsigned long long) ((rdtsc () - start) / PAGE_CNT));
+  CHECK (maxrss () - before < PAGE_CNT / 16,
+         "reading takes next to no memory");
+  quiet = false;
+  msg ("read %d pages of zeros", PAGE_CNT);
+
+  for (i = 0; i < PAGE_CNT; i += 64)
+    zeros[i * PAGE_SIZE + 1] = 1;
+  for (i = 0; i < PAGE_CNT; i++)
+    if (zeros[i * PAGE_SIZE + 1] != (i % 64 == 0))
+      fail ("page %zu has the wrong contents", i);
+  msg ("written pages are private");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-zero) begin
+(page-zero) read 2048 pages of zeros
+(page-zero) written pages are private
+(page-zero) end
+EOF
+pass;
@@ -5,6 +5,7 @@
 
 #include "tests/vm/parallel-merge.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall.h>
 #include "tests/arc4.h"
 #include "tests/lib.h"
@@ -27,6 +28,7 @@ init (void)
 
   msg ("init");
 
+  memset (histogram, 0, sizeof histogram);
   arc4_init (&arc4, "foobar", 6);
   arc4_crypt (&arc4, buf1, sizeof buf1);
   for (i = 0; i < sizeof buf1; i++)
@@ -82,6 +84,45 @@ sort_chunks (const char *subprocess, int exit_status)
     }
 }
 
+/* Sort each chunk of buf1 using SUBPROCESS, which is expected to
+   return EXIT_STATUS.  The chunks are handed over in a shared-memory
+   segment that SUBPROCESS maps too, instead of in files. */
+static void
+sort_chunks_shm (const char *subprocess, int exit_status)
+{
+  pid_t children[CHUNK_CNT];
+  unsigned char *shared = (unsigned char *) SHM_ADDR;
+  int handle;
+  size_t i;
+
+  CHECK ((handle = shm_open ("sort", DATA_SIZE)) > 1, "shm_open \"sort\"");
+  CHECK (mmap (shared, DATA_SIZE, 1, handle, 0) == shared, "mmap \"sort\"");
+  memcpy (shared, buf1, DATA_SIZE);
+
+  for (i = 0; i < CHUNK_CNT; i++)
+    {
+      char cmd[128];
+
+      msg ("sort chunk %zu", i);
+
+      /* Sort with subprocess. */
+      quiet = true;
+      snprintf (cmd, sizeof cmd, "%s sort %zu", subprocess, i);
+      children[i] = fork (subprocess);
+      if (children[i] == 0)
+        CHECK ((children[i] = exec (cmd)) != -1, "exec \"%s\"", cmd);
+      quiet = false;
+    }
+
+  for (i = 0; i < CHUNK_CNT; i++)
+    CHECK (wait (children[i]) == exit_status, "wait for child %zu", i);
+
+  memcpy (buf1, shared, DATA_SIZE);
+  munmap (shared);
+  close (handle);
+  CHECK (shm_unlink ("sort"), "shm_unlink \"sort\"");
+}
+
 /* Merge the sorted chunks in buf1 into a fully sorted buf2. */
 static void
 merge (void)
@@ -149,3 +190,12 @@ parallel_merge (const char *child_name, int exit_status)
   merge ();
   verify ();
 }
+
+void
+parallel_merge_shm (const char *child_name, int exit_status)
+{
+  init ();
+  sort_chunks_shm (child_name, exit_status);
+  merge ();
+  verify ();
+}
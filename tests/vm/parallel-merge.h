@@ -1,6 +1,10 @@
 #ifndef TESTS_VM_PARALLEL_MERGE
 #define TESTS_VM_PARALLEL_MERGE 1
 
+/* Where parallel_merge_shm() and its children map the shared buffer. */
+#define SHM_ADDR 0x10000000
+
 void parallel_merge (const char *child_name, int exit_status);
+void parallel_merge_shm (const char *child_name, int exit_status);
 
 #endif /* tests/vm/parallel-merge.h */
@@ -0,0 +1,39 @@
+/* Runs a second copy of this program and checks that both copies
+   map their code to the same frame, instead of each reading it
+   from the executable. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+int
+main (int argc, char *argv[])
+{
+  /* Frame number of the page holding this function. */
+  int code = (uintptr_t) get_phys_addr ((void *) main) >> 12;
+  char cmd_line[128];
+  pid_t pid;
+
+  /* Set here, as tests/main.c does: tests/lib.c defines it. */
+  test_name = "share-text";
+  if (argc > 1)
+    {
+      /* The second copy: compare with the first one's frame. */
+      if (code != atoi (argv[1]))
+        fail ("code in frame %d, first copy in frame %s", code, argv[1]);
+      return 0;
+    }
+
+  msg ("begin");
+  snprintf (cmd_line, sizeof cmd_line, "share-text %d", code);
+  if ((pid = fork ("share-text")) == 0)
+    {
+      exec (cmd_line);
+      fail ("exec \"%s\"", cmd_line);
+    }
+  CHECK (pid > 0, "run a second copy");
+  CHECK (wait (pid) == 0, "second copy shares the code");
+  msg ("end");
+  return 0;
+}
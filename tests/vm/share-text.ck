@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(share-text) begin
+(share-text) run a second copy
+(share-text) second copy shares the code
+(share-text) end
+EOF
+pass;
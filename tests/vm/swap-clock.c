@@ -0,0 +1,74 @@
+/* Keeps a small hot set of pages in use while streaming through a
+   cold region several times the size of memory, so that the
+   kernel must keep evicting.  Logs the page faults taken per
+   round, which a policy that spares recently used pages keeps
+   down to the cold pages, and checks that no data is lost.
+   Run as swap-clock and, with -evict=fifo, as swap-fifo. */
+
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HOT_PAGES 64
+#define COLD_PAGES (4096 - HOT_PAGES)
+#define ROUNDS 16
+#define COLD_PER_ROUND (COLD_PAGES / 4)
+
+static char hot[HOT_PAGES * PAGE_SIZE];
+static char cold[COLD_PAGES * PAGE_SIZE];
+
+/* Returns the page faults taken so far. */
+static long
+fault_cnt (void)
+{
+  struct rusage usage;
+
+  CHECK (getrusage (RUSAGE_SELF, &usage) == 0, "getrusage");
+  return usage.minflt + usage.majflt;
+}
+
+void
+test_main (void)
+{
+  long before, hot_faults = 0, total;
+  size_t i, next = 0;
+  int round;
+
+  for (i = 0; i < HOT_PAGES; i++)
+    hot[i * PAGE_SIZE] = i;
+
+  quiet = true;
+  before = fault_cnt ();
+  for (round = 0; round < ROUNDS; round++)
+    {
+      size_t j;
+
+      for (j = 0; j < COLD_PER_ROUND; j++, next = (next + 1) % COLD_PAGES)
+        {
+          long start;
+
+          cold[next * PAGE_SIZE] = next;
+
+          /* Touch the hot set often enough to keep it recently used. */
+          if (j % 16 != 0)
+            continue;
+          start = fault_cnt ();
+          for (i = 0; i < HOT_PAGES; i++)
+            if (hot[i * PAGE_SIZE] != (char) i)
+              fail ("hot page %zu corrupted", i);
+          hot_faults += fault_cnt () - start;
+        }
+    }
+  total = fault_cnt () - before;
+  quiet = false;
+
+  bench ("%ld page faults in %d rounds, %ld on the hot set",
+         total, ROUNDS, hot_faults);
+
+  for (i = 0; i < COLD_PAGES; i++)
+    if (cold[i * PAGE_SIZE] != (char) i)
+      fail ("cold page %zu corrupted", i);
+  msg ("data intact");
+}
@@ -0,0 +1,59 @@
+/* Fills a region twice the size of memory with pages that compress
+   well, much like the data of real programs, then reads it back in
+   several passes.  Logs the cost per page of each phase and checks
+   the data.  Run as swap-compress, with the compressed swap pool,
+   and, with -zswap=0, as swap-nocompress, against the swap disk
+   alone. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 4096
+#define PASSES 3
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+/* Fills the page at P, number I, with records that mention I. */
+static void
+fill_page (char *p, size_t i)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs + 64 <= PAGE_SIZE / 2; ofs += 64)
+    snprintf (p + ofs, 64, "page %zu, record %zu", i, ofs / 64);
+}
+
+void
+test_main (void)
+{
+  char expect[PAGE_SIZE];
+  uint64_t start;
+  size_t i;
+  int pass;
+
+  start = rdtsc ();
+  for (i = 0; i < PAGE_CNT; i++)
+    fill_page (buf + i * PAGE_SIZE, i);
+  bench ("fill: %llu cycles per page",
+         (unsigned long long) ((rdtsc () - start) / PAGE_CNT));
+
+  for (pass = 0; pass < PASSES; pass++)
+    {
+      start = rdtsc ();
+      for (i = 0; i < PAGE_CNT; i++)
+        {
+          memset (expect, 0, sizeof expect);
+          fill_page (expect, i);
+          if (memcmp (buf + i * PAGE_SIZE, expect, PAGE_SIZE))
+            fail ("page %zu corrupted in pass %d", i, pass);
+        }
+      bench ("pass %d: %llu cycles per page", pass,
+             (unsigned long long) ((rdtsc () - start) / PAGE_CNT));
+    }
+  msg ("data intact");
+}
@@ -0,0 +1,65 @@
+/* Writes to each page of a region several times the size of memory,
+   twice, timing every write, and logs percentiles of the times.
+   Once memory is full, nearly every write faults and needs a free
+   frame.  Run as swap-kswapd, with the page-out daemon keeping
+   frames free in the background, and as swap-direct, without it,
+   where each such fault must first evict a page itself. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGES 4096
+#define PASSES 2
+#define SAMPLES (PASSES * PAGES)
+
+static char region[PAGES * PAGE_SIZE];
+static uint64_t cycles[SAMPLES];
+
+static int
+compare_cycles (const void *a_, const void *b_)
+{
+  const uint64_t *a = a_;
+  const uint64_t *b = b_;
+
+  return *a < *b ? -1 : *a > *b;
+}
+
+/* Returns the time below which PERCENT percent of the writes
+   finished.  CYCLES must be sorted. */
+static unsigned long long
+percentile (int percent)
+{
+  return cycles[(SAMPLES - 1) * percent / 100];
+}
+
+void
+test_main (void)
+{
+  size_t i;
+  int pass;
+
+  quiet = true;
+  for (pass = 0; pass < PASSES; pass++)
+    for (i = 0; i < PAGES; i++)
+      {
+        uint64_t start = rdtsc ();
+        region[i * PAGE_SIZE] = i + pass;
+        cycles[pass * PAGES + i] = rdtsc () - start;
+      }
+  quiet = false;
+
+  qsort (cycles, SAMPLES, sizeof *cycles, compare_cycles);
+  bench ("write cycles: p50 %llu, p90 %llu, p99 %llu, max %llu",
+         percentile (50), percentile (90), percentile (99),
+         percentile (100));
+
+  for (i = 0; i < PAGES; i++)
+    if (region[i * PAGE_SIZE] != (char) (i + PASSES - 1))
+      fail ("page %zu corrupted", i);
+  msg ("data intact");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::bench;
+check_bench (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-nocompress) begin
+(swap-nocompress) data intact
+(swap-nocompress) end
+EOF
+pass;
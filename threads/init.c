@@ -12,6 +12,7 @@
 #include "devices/input.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "devices/tty.h"
 #include "devices/vga.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
@@ -21,16 +22,21 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "userprog/pipe.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #endif
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/ksm.h"
+#include "vm/kswapd.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -51,6 +57,14 @@ bool power_off_when_done;
 
 bool thread_tests;
 
+/* -no-pcid: Flush the TLB on every address space switch? */
+static bool no_pcid;
+
+#ifdef USERPROG
+/* -rusage: Print each process's resource usage when it exits? */
+bool print_rusage;
+#endif
+
 static void bss_init(void);
 static void paging_init(uint64_t mem_end);
 
@@ -96,9 +110,12 @@ int main(void)
 	timer_init();
 	kbd_init();
 	input_init();
+	tty_init();
 #ifdef USERPROG
 	exception_init();
 	syscall_init();
+	process_table_init();
+	pipe_init();
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start();
@@ -139,33 +156,91 @@ bss_init(void)
 	memset(&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Returns true if the CPU can map gigabyte pages. */
+static bool
+gb_pages_supported(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+	if (eax < 0x80000001)
+		return false;
+	cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+	return (edx & (1 << 26)) != 0;
+}
+
+/* Returns the size of the largest page that can map physical address PA
+ * in the kernel's direct map: a page of that size must start at PA, end
+ * by MEM_END, and leave the kernel text, which is read-only, alone. */
+static uint64_t
+direct_page_size(uint64_t pa, uint64_t mem_end, bool gb_pages)
+{
+	extern char start, _end_kernel_text;
+	uint64_t text_start = vtop(&start);
+	uint64_t text_end = vtop(&_end_kernel_text);
+	uint64_t size = gb_pages ? GPGSIZE : HPGSIZE;
+
+	for (; size > PGSIZE; size = size == GPGSIZE ? HPGSIZE : PGSIZE)
+		if (pa % size == 0 && mem_end - pa >= size
+			&& (pa + size <= text_start || pa >= text_end))
+			return size;
+	return PGSIZE;
+}
+
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ * Memory is mapped with the largest pages that fit, which keeps the
+ * page table small and the TLB mostly hitting.  Only the kernel text,
+ * read-only, and the end of memory take 4 kB pages. */
 static void
 paging_init(uint64_t mem_end)
 {
 	uint64_t *pml4, *pte;
 	int perm;
 	pml4 = base_pml4 = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+	bool gb_pages = gb_pages_supported();
+	size_t gb_cnt = 0, huge_cnt = 0, small_cnt = 0;
+	uint64_t start_tsc = rdtsc();
 
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE)
+	for (uint64_t pa = 0, size; pa < mem_end; pa += size)
 	{
 		uint64_t va = (uint64_t)ptov(pa);
 
+		size = direct_page_size(pa, mem_end, gb_pages);
 		perm = PTE_P | PTE_W;
 		if ((uint64_t)&start <= va && va < (uint64_t)&_end_kernel_text)
 			perm &= ~PTE_W;
 
-		if ((pte = pml4e_walk(pml4, va, 1)) != NULL)
-			*pte = pa | perm;
+		if (size == PGSIZE)
+		{
+			if ((pte = pml4e_walk(pml4, va, 1)) != NULL)
+				*pte = pa | perm;
+			small_cnt++;
+		}
+		else
+		{
+			if ((pte = pml4e_walk_large(pml4, va, size, 1)) != NULL)
+				*pte = pa | perm | PTE_PS;
+			if (size == GPGSIZE)
+				gb_cnt++;
+			else
+				huge_cnt++;
+		}
 	}
 
 	// reload cr3
 	pml4_activate(0);
+	if (!no_pcid && pml4_enable_pcid())
+		printf("Using process-context identifiers.\n");
+
+	printf("Kernel direct map: %zu 1 GB, %zu 2 MB, %zu 4 kB pages "
+		   "in %llu cycles.\n",
+		   gb_cnt, huge_cnt, small_cnt,
+		   (unsigned long long)(rdtsc() - start_tsc));
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -226,11 +301,39 @@ parse_options(char **argv)
 			random_init(atoi(value));
 		else if (!strcmp(name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp(name, "-no-pcid"))
+			no_pcid = true;
+#ifdef VM
+		else if (!strcmp(name, "-evict"))
+		{
+			if (value != NULL && !strcmp(value, "clock"))
+				evict_policy = EVICT_CLOCK;
+			else if (value != NULL && !strcmp(value, "fifo"))
+				evict_policy = EVICT_FIFO;
+			else
+				PANIC("unknown eviction policy `%s' (use -h for help)",
+					  value != NULL ? value : "");
+		}
+		else if (!strcmp(name, "-zswap"))
+			zswap_max_pages = atoi(value);
+		else if (!strcmp(name, "-ksm"))
+			ksm_pages_to_scan = atoi(value);
+		else if (!strcmp(name, "-ksm-sleep"))
+			ksm_sleep_ms = atoi(value);
+		else if (!strcmp(name, "-kswapd-low"))
+			kswapd_low = atoi(value);
+		else if (!strcmp(name, "-kswapd-high"))
+			kswapd_high = atoi(value);
+		else if (!strcmp(name, "-flush"))
+			flush_interval_ms = atoi(value);
+#endif
 #ifdef USERPROG
 		else if (!strcmp(name, "-ul"))
 			user_page_limit = atoi(value);
 		else if (!strcmp(name, "-threads-tests"))
 			thread_tests = true;
+		else if (!strcmp(name, "-rusage"))
+			print_rusage = true;
 #endif
 		else
 			PANIC("unknown option `%s' (use -h for help)", name);
@@ -261,6 +364,15 @@ run_task(char **argv)
 	printf("Execution of '%s' complete.\n", task);
 }
 
+#ifdef VM
+/* Prints the page faults handled so far. */
+static void
+run_faultstat(char **argv UNUSED)
+{
+	vm_print_faultstat();
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -277,6 +389,9 @@ run_actions(char **argv)
 	/* Table of supported actions. */
 	static const struct action actions[] = {
 		{"run", 2, run_task},
+#ifdef VM
+		{"faultstat", 1, run_faultstat},
+#endif
 #ifdef FILESYS
 		{"ls", 1, fsutil_ls},
 		{"cat", 2, fsutil_cat},
@@ -324,6 +439,9 @@ usage(void)
 #else
 		   "  run TEST           Run TEST.\n"
 #endif
+#ifdef VM
+		   "  faultstat          Print page fault latency histograms.\n"
+#endif
 #ifdef FILESYS
 		   "  ls                 List files in the root directory.\n"
 		   "  cat FILE           Print FILE to the console.\n"
@@ -338,8 +456,24 @@ usage(void)
 		   "  -f                 Format file system disk during startup.\n"
 		   "  -rs=SEED           Set random number seed to SEED.\n"
 		   "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+		   "  -no-pcid           Flush the TLB on every address space switch.\n"
+#ifdef VM
+		   "  -evict=POLICY      Evict pages by POLICY, clock (default) or fifo.\n"
+		   "  -zswap=PAGES       Compress swapped pages into up to PAGES pages\n"
+		   "                     of memory first (default 256, 0 for none).\n"
+		   "  -ksm=PAGES         Merge identical anonymous pages, scanning\n"
+		   "                     PAGES pages per round (default 0, none).\n"
+		   "  -ksm-sleep=MS      Sleep MS milliseconds between rounds (default 20).\n"
+		   "  -kswapd-low=PAGES  Page out in the background whenever fewer than\n"
+		   "                     PAGES user pages are free (default 0, never).\n"
+		   "  -kswapd-high=PAGES ...until PAGES pages are free (default twice\n"
+		   "                     the low watermark).\n"
+		   "  -flush=MS          Write back dirty file pages every MS\n"
+		   "                     milliseconds (default 500, 0 for never).\n"
+#endif
 #ifdef USERPROG
 		   "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+		   "  -rusage            Print resource usage of exiting processes.\n"
 #endif
 	);
 	power_off();
@@ -356,6 +490,7 @@ void power_off(void)
 	print_stats();
 
 	printf("Powering off...\n");
+	serial_flush();
 	outw(0x604, 0x2000); /* Poweroff command for qemu */
 	for (;;)
 		;
@@ -375,4 +510,7 @@ print_stats(void)
 #ifdef USERPROG
 	exception_print_stats();
 #endif
+#ifdef VM
+	vm_print_stats();
+#endif
 }
@@ -13,6 +13,7 @@
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/gdt.h"
+#include "userprog/process.h"
 #endif
 
 /* Number of x86_64 interrupts. */
@@ -371,6 +372,13 @@ intr_handler (struct intr_frame *frame) {
 
 		if (yield_on_return)
 			thread_yield ();
+
+#ifdef USERPROG
+		/* A thread of an exiting process does not go back to user
+		   mode. */
+		if ((frame->cs & 3) == 3)
+			process_check_exit ();
+#endif
 	}
 }
 
@@ -2,12 +2,120 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Process-context identifiers (PCIDs).
+ *
+ * With CR4.PCIDE set, the CPU tags each TLB entry with the PCID in the
+ * low bits of CR3, so that switching to another address space need not
+ * flush the TLB.  A user pml4 takes a fresh PCID the first time it is
+ * activated in a generation.  Once all PCIDs are handed out, a new
+ * generation begins: the whole TLB is flushed and every pml4 takes a new
+ * PCID on its next activation.  PCID 0 is for base_pml4.
+ *
+ * A pml4 keeps its PCID tag in its last entry, which maps nothing: the CPU
+ * ignores all but the present bit of an entry that is not present.  A new
+ * pml4 has a tag of 0, which belongs to no generation. */
+
+#define PCID_CNT 4096                /* Number of PCIDs. */
+#define PML4_TAG 511                 /* Index of the tag in a pml4. */
+#define CR3_NOFLUSH (1ULL << 63)     /* Keep the PCID's TLB entries. */
+#define CR4_PGE (1 << 7)             /* Global pages enable. */
+#define CR4_PCIDE (1 << 17)          /* PCID enable. */
+
+/* Tag fields. */
+#define TAG_PCID(TAG) ((TAG) & 0xfff)   /* PCID. */
+#define TAG_STALE 0x1000                /* TLB entries may be out of date. */
+#define TAG_GEN(TAG) ((TAG) >> 13)      /* Generation of the PCID. */
+
+static bool pcid_enabled;       /* Is CR4.PCIDE set? */
+static bool has_invpcid;        /* Does the CPU have INVPCID? */
+static uint64_t pcid_gen = 1;   /* Current generation. */
+static unsigned next_pcid = 1;  /* Next PCID to hand out. */
+
+static uint64_t
+get_tag (uint64_t *pml4) {
+	return pml4[PML4_TAG] >> 1;
+}
+
+static void
+set_tag (uint64_t *pml4, uint64_t tag) {
+	pml4[PML4_TAG] = tag << 1;
+}
+
+/* Makes any TLB entry for virtual address VA in PML4 go away.  For the
+ * active pml4 that is INVLPG.  Other pml4s have their entry invalidated
+ * by INVPCID, or else are flushed when next activated.  Without PCIDs,
+ * activating a pml4 flushes the TLB anyway. */
+static void
+tlb_invalidate (uint64_t *pml4, uint64_t va) {
+	enum intr_level old_level;
+	uint64_t tag;
+
+	if (PTE_ADDR (rcr3 ()) == vtop (pml4)) {
+		invlpg (va);
+		return;
+	}
+	if (!pcid_enabled)
+		return;
+
+	old_level = intr_disable ();
+	tag = get_tag (pml4);
+	if (TAG_GEN (tag) == pcid_gen) {
+		if (has_invpcid)
+			invpcid (0, TAG_PCID (tag), va);
+		else
+			set_tag (pml4, tag | TAG_STALE);
+	}
+	intr_set_level (old_level);
+}
+
+/* Turns on PCIDs if the CPU has them.  Must be called with base_pml4
+ * active.  Returns true if successful. */
+bool
+pml4_enable_pcid (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	ASSERT ((rcr3 () & PGMASK) == 0);
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if ((ecx & (1 << 17)) == 0)
+		return false;
+	cpuid (0, &eax, &ebx, &ecx, &edx);
+	if (eax >= 7) {
+		cpuid (7, &eax, &ebx, &ecx, &edx);
+		has_invpcid = (ebx & (1 << 10)) != 0;
+	}
+	lcr4 (rcr4 () | CR4_PCIDE);
+	pcid_enabled = true;
+	return true;
+}
+
+/* Replaces the huge page mapping in PDE by a page table that maps the
+ * same memory with the same permissions in 4 kB pages.  Returns false if
+ * no page table could be allocated. */
+static bool
+pde_split (uint64_t *pde) {
+	uint64_t *pt = palloc_get_page (0);
+	uint64_t pa = PTE_ADDR (*pde);
+	uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+
+	if (pt == NULL)
+		return false;
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+	return true;
+}
+
+/* A huge page is mapped by its page-directory entry, which PGDIR_WALK
+ * returns in place of a page table entry unless CREATE is set.  With
+ * CREATE set, the huge page is split into 4 kB pages first. */
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
@@ -22,12 +130,19 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 					return NULL;
 			} else
 				return NULL;
+		} else if (pdp[idx] & PTE_PS) {
+			if (!create)
+				return &pdp[idx];
+			if (!pde_split (&pdp[idx]))
+				return NULL;
 		}
 		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
 	}
 	return NULL;
 }
 
+/* Gigabyte pages, in the kernel's direct map, are returned the same way,
+ * but never split. */
 static uint64_t *
 pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
@@ -35,6 +150,8 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 	int allocated = 0;
 	if (pdpe) {
 		uint64_t *pde = (uint64_t *) pdpe[idx];
+		if ((uint64_t) pde & PTE_P && (uint64_t) pde & PTE_PS)
+			return create ? NULL : &pdpe[idx];
 		if (!((uint64_t) pde & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
@@ -88,6 +205,33 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the address of the entry that maps virtual address VA in PML4
+ * with a page of SIZE bytes: the page-directory entry for a huge page of
+ * HPGSIZE, or the page-directory-pointer entry for a GPGSIZE page.  If
+ * CREATE is true, missing tables above it are created; otherwise a null
+ * pointer is returned for them. */
+uint64_t *
+pml4e_walk_large (uint64_t *pml4, const uint64_t va, uint64_t size,
+		int create) {
+	int levels = size == GPGSIZE ? 1 : 2;
+	uint64_t *table = pml4;
+
+	ASSERT (size == HPGSIZE || size == GPGSIZE);
+	for (int level = 0; level < levels; level++) {
+		uint64_t *e = &table[level == 0 ? PML4 (va) : PDPE (va)];
+
+		if (!(*e & PTE_P)) {
+			uint64_t *new_page;
+
+			if (!create || (new_page = palloc_get_page (PAL_ZERO)) == NULL)
+				return NULL;
+			*e = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		}
+		table = ptov (PTE_ADDR (*e));
+	}
+	return &table[levels == 1 ? PDPE (va) : PDX (va)];
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -122,10 +266,18 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
-					pml4_index, pdp_index, i))
+		if (!(((uint64_t) pte) & PTE_P))
+			continue;
+		if (pdp[i] & PTE_PS) {
+			/* A huge page: FUNC gets the PDE and the first address. */
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
 				return false;
+		} else if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
+					pml4_index, pdp_index, i))
+			return false;
 	}
 	return true;
 }
@@ -135,10 +287,16 @@ pdp_for_each (uint64_t *pdp,
 		pte_for_each_func *func, void *aux, unsigned pml4_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pde) & PTE_P)
-			if (!pgdir_for_each ((uint64_t *) PTE_ADDR (pde), func,
-					 aux, pml4_index, i))
+		if (!(((uint64_t) pde) & PTE_P))
+			continue;
+		if (pdp[i] & PTE_PS) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) i << PDPESHIFT));
+			if (!func (&pdp[i], va, aux))
 				return false;
+		} else if (!pgdir_for_each ((uint64_t *) PTE_ADDR (pde), func,
+					 aux, pml4_index, i))
+			return false;
 	}
 	return true;
 }
@@ -169,7 +327,11 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if (!(((uint64_t) pte) & PTE_P))
+			continue;
+		if (pdp[i] & PTE_PS)
+			palloc_free_multiple ((void *) PTE_ADDR (pte), HPGPAGES);
+		else
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -200,10 +362,44 @@ pml4_destroy (uint64_t *pml4) {
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, the TLB entries of PD survive from its
+ * last activation unless they went stale in the meantime. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	enum intr_level old_level;
+	uint64_t tag;
+	bool flush = false;
+
+	if (!pcid_enabled) {
+		lcr3 (vtop (pml4 ? pml4 : base_pml4));
+		return;
+	}
+	if (pml4 == NULL) {
+		/* Kernel mappings never change. */
+		lcr3 (vtop (base_pml4) | CR3_NOFLUSH);
+		return;
+	}
+
+	old_level = intr_disable ();
+	tag = get_tag (pml4);
+	if (TAG_GEN (tag) != pcid_gen) {
+		if (next_pcid == PCID_CNT) {
+			/* Out of PCIDs: toggling CR4.PGE flushes all of them. */
+			uint64_t cr4 = rcr4 ();
+			lcr4 (cr4 ^ CR4_PGE);
+			lcr4 (cr4);
+			pcid_gen++;
+			next_pcid = 1;
+		}
+		tag = (pcid_gen << 13) | next_pcid++;
+		flush = true;
+	} else if (tag & TAG_STALE) {
+		tag &= ~TAG_STALE;
+		flush = true;
+	}
+	set_tag (pml4, tag);
+	lcr3 (vtop (pml4) | TAG_PCID (tag) | (flush ? 0 : CR3_NOFLUSH));
+	intr_set_level (old_level);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -217,7 +413,8 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
 	if (pte && (*pte & PTE_P))
-		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+		return ptov (PTE_ADDR (*pte))
+			+ (is_huge_pte (pte) ? hpg_ofs (uaddr) : pg_ofs (uaddr));
 	return NULL;
 }
 
@@ -238,15 +435,56 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
 
-	if (pte)
+	if (pte) {
+		bool was_present = (*pte & PTE_P) != 0;
+
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (was_present)
+			tlb_invalidate (pml4, (uint64_t) upage);
+	}
 	return pte != NULL;
 }
 
+/* Maps the huge page at user virtual address UPAGE in PML4 to the
+ * HPGSIZE bytes of physical memory at kernel virtual address KPAGE, as
+ * obtained from palloc_get_huge_page().  Both must be aligned to HPGSIZE.
+ * The range may hold no mapped 4 kB pages.  If WRITABLE is true, the new
+ * page is read/write; otherwise it is read-only.
+ * Returns true if successful, false if the range is in use or memory
+ * allocation failed. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	ASSERT (hpg_ofs (upage) == 0);
+	ASSERT (hpg_ofs (kpage) == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	uint64_t *pde = pml4e_walk_large (pml4, (uint64_t) upage, HPGSIZE, 1);
+
+	if (pde == NULL)
+		return false;
+	if (*pde & PTE_P) {
+		/* An empty page table is left over from pages since unmapped. */
+		uint64_t *pt = ptov (PTE_ADDR (*pde));
+
+		if (*pde & PTE_PS)
+			return false;
+		for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+			if (pt[i] & PTE_P)
+				return false;
+		palloc_free_page (pt);
+	}
+	*pde = vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+	tlb_invalidate (pml4, (uint64_t) upage);
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
- * UPAGE need not be mapped. */
+ * UPAGE need not be mapped.  A huge page around UPAGE is split
+ * first, or, if that fails for lack of memory, made not present
+ * as a whole. */
 void
 pml4_clear_page (uint64_t *pml4, void *upage) {
 	uint64_t *pte;
@@ -254,17 +492,20 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 	ASSERT (is_user_vaddr (upage));
 
 	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	if (pte != NULL && (*pte & PTE_P) != 0 && is_huge_pte (pte)
+			&& pde_split (pte))
+		pte = pml4e_walk (pml4, (uint64_t) upage, false);
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_invalidate (pml4, (uint64_t) upage);
 	}
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
- * installed.
+ * installed.  The pages of a huge page share its dirty and
+ * accessed bits.
  * Returns false if PML4 contains no PTE for VPAGE. */
 bool
 pml4_is_dirty (uint64_t *pml4, const void *vpage) {
@@ -283,8 +524,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, (uint64_t) vpage);
 	}
 }
 
@@ -309,7 +549,6 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, (uint64_t) vpage);
 	}
 }
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -31,6 +32,7 @@ struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	size_t free_cnt;                /* Number of free pages. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +44,7 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void count_free (struct pool *, long page_cnt);
 
 /* multiboot info */
 struct multiboot_info {
@@ -250,6 +253,10 @@ palloc_init (void) {
 	printf ("\text_mem: 0x%llx ~ 0x%llx (Usable: %'llu kB)\n",
 		  ext_mem.start, ext_mem.end, ext_mem.size / 1024);
 	populate_pools (&base_mem, &ext_mem);
+	kernel_pool.free_cnt = bitmap_count (kernel_pool.used_map, 0,
+			bitmap_size (kernel_pool.used_map), false);
+	user_pool.free_cnt = bitmap_count (user_pool.used_map, 0,
+			bitmap_size (user_pool.used_map), false);
 	return ext_mem.end;
 }
 
@@ -265,6 +272,8 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 
 	lock_acquire (&pool->lock);
 	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	if (page_idx != BITMAP_ERROR)
+		count_free (pool, -(long) page_cnt);
 	lock_release (&pool->lock);
 	void *pages;
 
@@ -296,6 +305,39 @@ palloc_get_page (enum palloc_flags flags) {
 	return palloc_get_multiple (flags, 1);
 }
 
+/* Obtains HPGPAGES contiguous free pages that start on a huge
+   page boundary, so that they can be mapped as one huge page, and
+   returns their kernel virtual address.  FLAGS are as for
+   palloc_get_multiple().  The pages may be freed all together or
+   one by one. */
+void *
+palloc_get_huge_page (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t page_cnt = bitmap_size (pool->used_map);
+	size_t page_idx;
+	void *pages = NULL;
+
+	lock_acquire (&pool->lock);
+	page_idx = (HPGPAGES - pg_no (pool->base) % HPGPAGES) % HPGPAGES;
+	for (; page_idx + HPGPAGES <= page_cnt; page_idx += HPGPAGES)
+		if (bitmap_none (pool->used_map, page_idx, HPGPAGES)) {
+			bitmap_set_multiple (pool->used_map, page_idx, HPGPAGES, true);
+			count_free (pool, -HPGPAGES);
+			pages = pool->base + PGSIZE * page_idx;
+			break;
+		}
+	lock_release (&pool->lock);
+
+	if (pages) {
+		if (flags & PAL_ZERO)
+			memset (pages, 0, HPGSIZE);
+	} else {
+		if (flags & PAL_ASSERT)
+			PANIC ("palloc_get_huge_page: out of pages");
+	}
+	return pages;
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
@@ -320,6 +362,7 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	count_free (pool, page_cnt);
 }
 
 /* Frees the page at PAGE. */
@@ -328,6 +371,24 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of free pages in the user pool if PAL_USER is
+   set in FLAGS, otherwise in the kernel pool. */
+size_t
+palloc_count_free (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	return pool->free_cnt;
+}
+
+/* Adds PAGE_CNT to the number of free pages in POOL.  Pages are
+   freed without the pool's lock, even from the scheduler, so the
+   count is kept with interrupts off instead. */
+static void
+count_free (struct pool *pool, long page_cnt) {
+	enum intr_level old_level = intr_disable ();
+	pool->free_cnt += page_cnt;
+	intr_set_level (old_level);
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
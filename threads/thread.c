@@ -163,21 +163,26 @@ void thread_start(void)
 	sema_down(&idle_started);
 }
 
-/* Called by the timer interrupt handler at each timer tick.
+/* Called by the timer interrupt handler at each timer tick, with
+   USER true if the tick interrupted user code.
    Thus, this function runs in an external interrupt context. */
-void thread_tick(void)
+void thread_tick(bool user)
 {
 	struct thread *t = thread_current();
 
 	/* Update statistics. */
 	if (t == idle_thread)
 		idle_ticks++;
-#ifdef USERPROG
-	else if (t->pml4 != NULL)
+	else if (user)
+	{
 		user_ticks++;
-#endif
+		t->usage.utime++;
+	}
 	else
+	{
 		kernel_ticks++;
+		t->usage.stime++;
+	}
 
 	/* Enforce preemption. */
 	if (++thread_ticks >= TIME_SLICE)
@@ -234,9 +239,11 @@ tid_t thread_create(const char *name, int priority,
 	t->tf.cs = SEL_KCSEG;
 	t->tf.eflags = FLAG_IF;
 
+	t->parent = thread_current();
+
 	/* Add to run queue. */
 	thread_unblock(t);
-	t->fd_table = malloc(sizeof(struct file *) * 1024);
+	t->fd_table = malloc(sizeof(struct file *) * FDT_LIMIT);
 	if (t->fd_table == NULL) {
 		PANIC("Memory allocation for fd_table failed");
 	}
@@ -245,8 +252,6 @@ tid_t thread_create(const char *name, int priority,
 		*(t->fd_table+1) = NULL;
 		*(t->fd_table+2) = NULL;
 	}
-	list_push_back(&thread_current()->child_list, &t->child_elem);	
-	t->parent = thread_current();
 
 	// 현재 스레드보다 우선 순위가 크면 양보
 	thread_change();
@@ -433,9 +438,9 @@ void thread_exit(void)
 
 #ifdef USERPROG
 	struct thread *curr = thread_current();
+	process_exit();
 	if (curr->fd_table != NULL)
 		free(curr->fd_table);
-	process_exit();
 #endif
 	if (thread_mlfqs)
 		list_remove(&thread_current()->all_elem);
@@ -483,6 +488,15 @@ void thread_set_priority(int new_priority)
 	thread_change();
 }
 
+/* Adds PAGES, which may be negative, to the resident pages of T
+   and keeps track of the peak. */
+void thread_add_rss(struct thread *t, int pages)
+{
+	t->rss += pages;
+	if (t->rss > t->usage.maxrss)
+		t->usage.maxrss = t->rss;
+}
+
 void thread_change(void)
 {
 	struct thread *curr = thread_current();
@@ -636,9 +650,18 @@ init_thread(struct thread *t, const char *name, int priority)
 	t->exit_status = 0;
 	
 	t->max_fd = 2;
+	lock_init(&t->fd_lock);
 	list_init(&t->child_list);
-	sema_init(&t->wait_sema, 0);
 	t->parent = NULL;
+#ifdef USERPROG
+	list_init(&t->zombie_list);
+	cond_init(&t->child_exit);
+	sema_init(&t->fork_sema, 0);
+	t->proc = t;
+	t->stack_slot = -1;
+	list_init(&t->thread_list);
+	cond_init(&t->thread_done);
+#endif
 
 	/** project1-Advanced Scheduler */
 	if (thread_mlfqs)
@@ -806,6 +829,11 @@ schedule(void)
 
 	if (curr != next)
 	{
+		if (curr->status == THREAD_BLOCKED)
+			curr->usage.nvcsw++;
+		else if (curr->status == THREAD_READY)
+			curr->usage.nivcsw++;
+
 		/* If the thread we switched from is dying, destroy its struct
 		   thread. This must happen late so that thread_exit() doesn't
 		   pull out the rug under itself.
@@ -2,8 +2,11 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "intrinsic.h"
 
 /* Number of page faults processed. */
@@ -86,6 +89,7 @@ kill (struct intr_frame *f) {
 			printf ("%s: dying due to interrupt %#04llx (%s).\n",
 					thread_name (), f->vec_no, intr_name (f->vec_no));
 			intr_dump_frame (f);
+			process_exit_group (-1);
 			thread_exit ();
 
 		case SEL_KCSEG:
@@ -144,6 +148,13 @@ page_fault (struct intr_frame *f) {
 	/* For project 3 and later. */
 	if (vm_try_handle_fault (f, fault_addr, user, write, not_present))
 		return;
+
+	/* The kernel touched a bad user address on behalf of a system
+	   call: that is the process's fault, not a kernel bug. */
+	if (!user && is_user_vaddr (fault_addr)) {
+		page_fault_cnt++;
+		exit (-1);
+	}
 #endif
 
 	/* Count page faults. */
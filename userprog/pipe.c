@@ -0,0 +1,401 @@
+/* pipe.c: Pipes between processes.
+ *
+ * A pipe keeps its data in a ring of up to PIPE_PAGES page-sized buffers.
+ * pipe_write() copies into the buffer at the tail of the ring, starting a
+ * new one when it is full, and pipe_read() copies out of the head, freeing
+ * buffers as they drain.  pipe_vmsplice() moves whole page-aligned user
+ * pages into the ring without copying them: the page's frame becomes a
+ * buffer and the user is left with a fresh zero page at the same address.
+ *
+ * User memory is never touched with a pipe's lock held, since touching it
+ * may fault and sleep on the disk.  Reads and writes go through a kernel
+ * bounce page a page at a time instead.
+ *
+ * The two ends of a pipe are struct files (see filesys/file.c), so they
+ * are inherited across fork and closed like any other open file.
+ *
+ * A thread whose process is exiting gives up waiting on a pipe, so that
+ * the process can finish exiting.  pipe_interrupt() wakes the waiters of
+ * every pipe for them to notice. */
+
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <list.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
+
+/* Maximum number of page buffers in a pipe. */
+#define PIPE_PAGES 16
+
+/* One page of data in a pipe. */
+struct pipe_buf {
+	uint8_t *page;              /* Kernel page holding the data. */
+	size_t ofs;                 /* Offset of the first unread byte. */
+	size_t len;                 /* Bytes written from the page's start. */
+};
+
+struct pipe {
+	struct lock lock;           /* Protects all members. */
+	struct condition not_empty; /* Signaled when data arrives. */
+	struct condition not_full;  /* Signaled when a buffer frees up. */
+	struct pipe_buf bufs[PIPE_PAGES]; /* Ring of buffers. */
+	size_t head;                /* Index of the oldest buffer. */
+	size_t cnt;                 /* Number of buffers in use. */
+	int readers;                /* Open read ends. */
+	int writers;                /* Open write ends. */
+	struct list_elem elem;      /* Element in all_pipes. */
+};
+
+/* All pipes, for pipe_interrupt(). */
+static struct list all_pipes;
+static struct lock all_pipes_lock;
+
+/* Initializes the list of pipes. */
+void
+pipe_init (void) {
+	list_init (&all_pipes);
+	lock_init (&all_pipes_lock);
+}
+
+/* Returns true if the current thread must stop waiting on a pipe,
+ * because its process is exiting. */
+static bool
+interrupted (void) {
+	return thread_current ()->proc->exiting;
+}
+
+/* Wakes every thread waiting on a pipe, so that those whose process is
+ * exiting give up. */
+void
+pipe_interrupt (void) {
+	struct list_elem *e;
+
+	lock_acquire (&all_pipes_lock);
+	for (e = list_begin (&all_pipes); e != list_end (&all_pipes);
+			e = list_next (e)) {
+		struct pipe *p = list_entry (e, struct pipe, elem);
+
+		lock_acquire (&p->lock);
+		cond_broadcast (&p->not_empty, &p->lock);
+		cond_broadcast (&p->not_full, &p->lock);
+		lock_release (&p->lock);
+	}
+	lock_release (&all_pipes_lock);
+}
+
+/* Creates a pipe and stores files for its read end in *READP and its
+ * write end in *WRITEP.  Returns false if out of memory. */
+bool
+pipe_create (struct file **readp, struct file **writep) {
+	struct pipe *p = calloc (1, sizeof *p);
+	struct file *r, *w;
+
+	if (p == NULL)
+		return false;
+	lock_init (&p->lock);
+	cond_init (&p->not_empty);
+	cond_init (&p->not_full);
+	p->readers = p->writers = 1;
+
+	r = file_open_pipe (p, false);
+	w = r != NULL ? file_open_pipe (p, true) : NULL;
+	if (w == NULL) {
+		if (r != NULL) {
+			/* Closing the only end frees the pipe. */
+			p->writers = 0;
+			file_close (r);
+		} else
+			free (p);
+		return false;
+	}
+
+	lock_acquire (&all_pipes_lock);
+	list_push_back (&all_pipes, &p->elem);
+	lock_release (&all_pipes_lock);
+
+	*readp = r;
+	*writep = w;
+	return true;
+}
+
+/* Adds a reference to one end of P, the write end if WRITER is true. */
+void
+pipe_dup (struct pipe *p, bool writer) {
+	lock_acquire (&p->lock);
+	if (writer)
+		p->writers++;
+	else
+		p->readers++;
+	lock_release (&p->lock);
+}
+
+/* Drops a reference to one end of P, the write end if WRITER is true,
+ * and frees P when no end is open any more.  Readers see end of file once
+ * the last writer is gone; writers fail once the last reader is. */
+void
+pipe_close (struct pipe *p, bool writer) {
+	bool last;
+
+	lock_acquire (&p->lock);
+	if (writer)
+		p->writers--;
+	else
+		p->readers--;
+	cond_broadcast (&p->not_empty, &p->lock);
+	cond_broadcast (&p->not_full, &p->lock);
+	last = p->readers == 0 && p->writers == 0;
+	lock_release (&p->lock);
+
+	if (last) {
+		lock_acquire (&all_pipes_lock);
+		list_remove (&p->elem);
+		lock_release (&all_pipes_lock);
+		for (; p->cnt > 0; p->cnt--) {
+			palloc_free_page (p->bufs[p->head].page);
+			p->head = (p->head + 1) % PIPE_PAGES;
+		}
+		free (p);
+	}
+}
+
+/* Moves up to SIZE bytes from the head of P into the kernel buffer DST
+ * and returns their number.  The caller must hold P's lock. */
+static size_t
+take (struct pipe *p, uint8_t *dst, size_t size) {
+	size_t taken = 0;
+
+	while (taken < size && p->cnt > 0) {
+		struct pipe_buf *b = &p->bufs[p->head];
+		size_t chunk = b->len - b->ofs;
+
+		if (chunk > size - taken)
+			chunk = size - taken;
+		memcpy (dst + taken, b->page + b->ofs, chunk);
+		b->ofs += chunk;
+		taken += chunk;
+
+		if (b->ofs == b->len) {
+			palloc_free_page (b->page);
+			p->head = (p->head + 1) % PIPE_PAGES;
+			p->cnt--;
+			cond_broadcast (&p->not_full, &p->lock);
+		}
+	}
+	return taken;
+}
+
+/* Reads up to SIZE bytes from P into BUFFER, waiting until there is
+ * some data.  Returns the number of bytes read, which is 0 at end of
+ * file, that is, when P is empty and has no writers, or if the process
+ * is exiting, or -1 if memory runs out. */
+off_t
+pipe_read (struct pipe *p, void *buffer_, off_t size) {
+	uint8_t *buffer = buffer_;
+	uint8_t *bounce;
+	off_t bytes_read = 0;
+
+	if (size <= 0)
+		return 0;
+	bounce = palloc_get_page (0);
+	if (bounce == NULL)
+		return -1;
+
+	lock_acquire (&p->lock);
+	while (p->cnt == 0 && p->writers > 0 && !interrupted ())
+		cond_wait (&p->not_empty, &p->lock);
+
+	while (bytes_read < size && p->cnt > 0) {
+		size_t chunk = size - bytes_read;
+
+		chunk = take (p, bounce, chunk < PGSIZE ? chunk : PGSIZE);
+		lock_release (&p->lock);
+		memcpy (buffer + bytes_read, bounce, chunk);
+		bytes_read += chunk;
+		lock_acquire (&p->lock);
+	}
+	lock_release (&p->lock);
+	palloc_free_page (bounce);
+	return bytes_read;
+}
+
+/* Appends the SIZE bytes at the kernel buffer SRC to P, waiting for room
+ * as needed, and returns how many were appended, fewer only if the
+ * readers go away, memory runs out or the process is exiting.  The
+ * caller must hold P's lock. */
+static size_t
+put (struct pipe *p, const uint8_t *src, size_t size) {
+	size_t written = 0;
+
+	while (written < size && p->readers > 0) {
+		struct pipe_buf *tail = NULL;
+		size_t chunk;
+
+		if (p->cnt > 0)
+			tail = &p->bufs[(p->head + p->cnt - 1) % PIPE_PAGES];
+		if (tail == NULL || tail->len == PGSIZE) {
+			uint8_t *page;
+
+			if (p->cnt == PIPE_PAGES) {
+				if (interrupted ())
+					break;
+				cond_wait (&p->not_full, &p->lock);
+				continue;
+			}
+			page = palloc_get_page (PAL_USER);
+			if (page == NULL)
+				break;
+			tail = &p->bufs[(p->head + p->cnt) % PIPE_PAGES];
+			*tail = (struct pipe_buf) { .page = page };
+			p->cnt++;
+		}
+
+		chunk = PGSIZE - tail->len;
+		if (chunk > size - written)
+			chunk = size - written;
+		memcpy (tail->page + tail->len, src + written, chunk);
+		tail->len += chunk;
+		written += chunk;
+		cond_broadcast (&p->not_empty, &p->lock);
+	}
+	return written;
+}
+
+/* Writes SIZE bytes from BUFFER into P, waiting for room as needed.
+ * Returns the number of bytes written, which is less than SIZE only if
+ * the readers go away, memory runs out or the process is exiting, or -1
+ * if nothing could be written for that reason. */
+off_t
+pipe_write (struct pipe *p, const void *buffer_, off_t size) {
+	const uint8_t *buffer = buffer_;
+	uint8_t *bounce;
+	off_t written = 0;
+
+	if (size == 0)
+		return 0;
+	bounce = palloc_get_page (0);
+	if (bounce == NULL)
+		return -1;
+
+	while (written < size) {
+		size_t chunk = size - written;
+		size_t n;
+
+		if (chunk > PGSIZE)
+			chunk = PGSIZE;
+		memcpy (bounce, buffer + written, chunk);
+		lock_acquire (&p->lock);
+		n = put (p, bounce, chunk);
+		lock_release (&p->lock);
+		written += n;
+		if (n < chunk)
+			break;
+	}
+	palloc_free_page (bounce);
+	return written > 0 ? written : -1;
+}
+
+/* Takes the frame of the current process's writable user page UPAGE away
+ * from it, leaving a zero page in its place.  Returns the frame's kernel
+ * address, now owned by the caller, or a null pointer if the page cannot
+ * be taken. */
+static void *
+steal_user_page (const void *upage) {
+#ifdef VM
+	return vm_steal_page ((void *) upage);
+#else
+	uint64_t *pml4 = thread_current ()->pml4;
+	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 0);
+	void *kva, *fresh;
+
+	if (pte == NULL || (*pte & PTE_P) == 0 || !is_writable (pte))
+		return NULL;
+	kva = pml4_get_page (pml4, upage);
+	fresh = palloc_get_page (PAL_USER | PAL_ZERO);
+	if (fresh == NULL)
+		return NULL;
+	pml4_clear_page (pml4, (void *) upage);
+	pml4_set_page (pml4, (void *) upage, fresh, true);
+	return kva;
+#endif
+}
+
+/* Waits until P has room for another buffer or no readers, or until the
+ * process is exiting, and returns true if there is room for a reader.
+ * The caller must hold P's lock. */
+static bool
+wait_room (struct pipe *p) {
+	while (p->cnt == PIPE_PAGES && p->readers > 0 && !interrupted ())
+		cond_wait (&p->not_full, &p->lock);
+	return p->cnt < PIPE_PAGES && p->readers > 0;
+}
+
+/* Moves the user page UPAGE into P as a whole buffer, waiting for room.
+ * Returns false if P has no readers or the page cannot be moved.  The
+ * page is taken without P's lock held, as taking it locks the process's
+ * page table; should the readers go away meanwhile, its data goes with
+ * them. */
+static bool
+move_page (struct pipe *p, const void *upage) {
+	void *kva;
+	bool moved;
+
+	lock_acquire (&p->lock);
+	moved = wait_room (p);
+	lock_release (&p->lock);
+	if (!moved)
+		return false;
+
+	kva = steal_user_page (upage);
+	if (kva == NULL)
+		return false;
+
+	lock_acquire (&p->lock);
+	moved = wait_room (p);
+	if (moved) {
+		p->bufs[(p->head + p->cnt) % PIPE_PAGES] = (struct pipe_buf) {
+			.page = kva,
+			.len = PGSIZE,
+		};
+		p->cnt++;
+		cond_broadcast (&p->not_empty, &p->lock);
+	}
+	lock_release (&p->lock);
+	if (!moved)
+		palloc_free_page (kva);
+	return moved;
+}
+
+/* Like pipe_write(), but whole page-aligned pages of BUFFER are moved
+ * into P instead of copied.  Those pages read as zeros afterward. */
+off_t
+pipe_vmsplice (struct pipe *p, const void *buffer_, off_t size) {
+	const uint8_t *buffer = buffer_;
+	off_t written = 0;
+
+	while (written < size) {
+		const uint8_t *upage = buffer + written;
+		off_t chunk = PGSIZE - pg_ofs (upage);
+		off_t n;
+
+		if (chunk > size - written)
+			chunk = size - written;
+		if (chunk == PGSIZE && move_page (p, upage))
+			n = PGSIZE;
+		else
+			n = pipe_write (p, upage, chunk);
+
+		if (n > 0)
+			written += n;
+		if (n < chunk)
+			break;
+	}
+	return written > 0 || size == 0 ? written : -1;
+}
@@ -1,18 +1,23 @@
 #include "userprog/process.h"
 #include <debug.h>
+#include <hash.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <syscall-nr.h>
 #include "userprog/gdt.h"
+#include "userprog/pipe.h"
 #include "userprog/tss.h"
+#include "devices/tty.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -23,12 +28,152 @@
 
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/vma.h"
 #endif
 
 static void process_cleanup(void);
 static bool load(const char *file_name, struct intr_frame *if_);
 static void initd(void *f_name);
 static void __do_fork(void *);
+static void start_thread(void *);
+static bool setup_thread_stack(int slot, struct intr_frame *if_);
+static void free_thread_stack(int slot);
+static bool map_heap(uintptr_t start, uintptr_t end);
+static void unmap_heap(uintptr_t start, uintptr_t end);
+
+/* Exit record of a process.  It is created by the process's thread as it
+ * starts, before the parent learns its pid, and kept by the parent,
+ * outliving the thread until the parent reaps it or exits itself, so that
+ * the exit status survives.  Kernel threads have none.
+ *
+ * A thread of a process other than its main one has an exit record too,
+ * kept by the main thread in its thread_list for thread_join(), and not
+ * in pid_table. */
+struct child_record
+{
+	tid_t tid;				   /* Process identifier. */
+	struct thread *parent;	   /* Null once the parent has exited. */
+	bool exited;			   /* Has the process exited? */
+	int exit_status;		   /* Exit status, once EXITED. */
+	struct rusage usage;	   /* Resources used, reaped children's
+								* included, once EXITED. */
+	struct thread *thread;	   /* Of a thread's record, the thread, until
+								* EXITED. */
+	struct hash_elem pid_elem; /* Element in pid_table. */
+	struct list_elem elem;	   /* Element in the parent's child_list while
+								* running, its zombie_list once exited. */
+};
+
+/* User stacks of the threads other than the main one lie below the
+ * 1 MB that the main stack may grow to, THREAD_STACK_SIZE bytes per
+ * slot.  The lowest page of each is left unmapped, to catch overflow. */
+#define THREAD_STACK_TOP (USER_STACK - (1 << 20))
+#define THREAD_STACK_SIZE (64 * 1024)
+#define THREAD_MAX 32 /* Slots, so threads besides the main one. */
+
+/* The heap grows up from the end of the program to the thread stacks. */
+#define HEAP_LIMIT (THREAD_STACK_TOP - THREAD_MAX * THREAD_STACK_SIZE)
+
+/* FS base register, for thread-local storage. */
+#define MSR_FS_BASE 0xc0000100
+
+/* How a new thread of a process starts, passed from
+ * process_thread_create() to start_thread(). */
+struct thread_start
+{
+	struct thread *creator;	   /* Thread that creates it. */
+	struct intr_frame if_;	   /* User context to start in. */
+	uintptr_t fs_base;		   /* FS base to start with. */
+};
+
+/* Exit records of all processes not yet reaped, hashed by tid. */
+static struct hash pid_table;
+
+/* Protects pid_table and every exit record. */
+static struct lock pid_lock;
+
+static uint64_t
+pid_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	return hash_int(hash_entry(e, struct child_record, pid_elem)->tid);
+}
+
+static bool
+pid_less(const struct hash_elem *a, const struct hash_elem *b,
+		 void *aux UNUSED)
+{
+	return hash_entry(a, struct child_record, pid_elem)->tid
+		< hash_entry(b, struct child_record, pid_elem)->tid;
+}
+
+/* Initializes the table of exit records. */
+void process_table_init(void)
+{
+	hash_init(&pid_table, pid_hash, pid_less, NULL);
+	lock_init(&pid_lock);
+}
+
+/* Creates the exit record of the current thread, a new user process or
+ * thread created by PARENT.  Kernel threads have none.  Returns a null
+ * pointer if out of memory. */
+static struct child_record *
+new_record(struct thread *parent)
+{
+	struct thread *curr = thread_current();
+	struct child_record *r = malloc(sizeof *r);
+
+	if (r != NULL)
+	{
+		r->tid = curr->tid;
+		r->parent = parent->proc;
+		r->exited = false;
+		r->exit_status = 0;
+	}
+	curr->record = r;
+	return r;
+}
+
+/* Gives the current thread, a new process created by PARENT, its exit
+ * record, kept by PARENT's process.  Called before PARENT may return the
+ * new process's pid.  Returns false if out of memory. */
+static bool
+add_child(struct thread *parent)
+{
+	struct child_record *r = new_record(parent);
+
+	if (r == NULL)
+		return false;
+	lock_acquire(&pid_lock);
+	hash_insert(&pid_table, &r->pid_elem);
+	list_push_back(&r->parent->child_list, &r->elem);
+	lock_release(&pid_lock);
+	return true;
+}
+
+/* Adds the resources in B to those in A.  The peak resident size is the
+ * larger of the two. */
+static void
+rusage_add(struct rusage *a, const struct rusage *b)
+{
+	a->utime += b->utime;
+	a->stime += b->stime;
+	a->nvcsw += b->nvcsw;
+	a->nivcsw += b->nivcsw;
+	a->majflt += b->majflt;
+	a->minflt += b->minflt;
+	a->inblock += b->inblock;
+	a->oublock += b->oublock;
+	if (b->maxrss > a->maxrss)
+		a->maxrss = b->maxrss;
+}
+
+/* Frees exit record R, which is in no list.  Called with pid_lock held. */
+static void
+free_record(struct child_record *r)
+{
+	hash_delete(&pid_table, &r->pid_elem);
+	free(r);
+}
 
 /* General process initializer for initd and other process. */
 static void
@@ -39,11 +184,13 @@ process_init(void)
 
 /* Starts the first userland program, called "initd", loaded from FILE_NAME.
  * The new thread may be scheduled (and may even exit)
- * before process_create_initd() returns. Returns the initd's
+ * before process_create_initd() returns, but only once it has an exit
+ * record, so that it can be waited for. Returns the initd's
  * thread id, or TID_ERROR if the thread cannot be created.
  * Notice that THIS SHOULD BE CALLED ONCE. */
 tid_t process_create_initd(const char *file_name)
 {
+	struct thread *curr = thread_current();
 	char *fn_copy;
 	tid_t tid;
 
@@ -58,18 +205,35 @@ tid_t process_create_initd(const char *file_name)
 	/* Create a new thread to execute FILE_NAME. */
 	tid = thread_create(strtok_r(file_name, " ", &save_ptr), PRI_DEFAULT, initd, fn_copy);
 	if (tid == TID_ERROR)
+	{
 		palloc_free_page(fn_copy);
-	return tid;
+		return TID_ERROR;
+	}
+
+	sema_down(&curr->fork_sema);
+	return curr->fork_succ ? tid : TID_ERROR;
 }
 
 /* A thread function that launches first user process. */
 static void
 initd(void *f_name)
 {
+	struct thread *creator = thread_current()->parent;
+	bool success;
+
 #ifdef VM
 	supplemental_page_table_init(&thread_current()->spt);
 #endif
 
+	success = add_child(creator);
+	creator->fork_succ = success;
+	sema_up(&creator->fork_sema);
+	if (!success)
+	{
+		palloc_free_page(f_name);
+		thread_exit();
+	}
+
 	process_init();
 
 	if (process_exec(f_name) < 0)
@@ -81,17 +245,57 @@ initd(void *f_name)
  * TID_ERROR if the thread cannot be created. */
 tid_t process_fork(const char *name, struct intr_frame *if_ UNUSED)
 {
-	memcpy(&thread_current()->fork_if, if_, sizeof(struct intr_frame));
+	struct thread *curr = thread_current();
+
+	memcpy(&curr->fork_if, if_, sizeof(struct intr_frame));
 	/* Clone current thread to new thread.*/
 	tid_t tid = thread_create(name,
-						 PRI_DEFAULT, __do_fork, thread_current());
-	
-	sema_down(&thread_current()->wait_sema);
-	
+						 PRI_DEFAULT, __do_fork, curr);
+	if (tid == TID_ERROR)
+		return TID_ERROR;
+
+	sema_down(&curr->fork_sema);
+	if (!curr->fork_succ)
+	{
+		/* Reap the child, which exits right away. */
+		process_wait(tid);
+		return TID_ERROR;
+	}
 	return tid;
 }
 
 #ifndef VM
+static bool duplicate_pte(uint64_t *pte, void *va, void *aux);
+
+/* Gives the current process a copy of PARENT's huge page at VA, as a huge
+ * page if one is free.  Otherwise copies it page by page. */
+static bool
+duplicate_huge_page(uint64_t *pte, void *va, struct thread *parent)
+{
+	struct thread *current = thread_current();
+	void *parent_page = pml4_get_page(parent->pml4, va);
+	void *newpage = palloc_get_huge_page(PAL_USER);
+	uint64_t sub_pte;
+	size_t i;
+
+	if (newpage != NULL)
+	{
+		memcpy(newpage, parent_page, HPGSIZE);
+		if (pml4_set_huge_page(current->pml4, va, newpage, is_writable(pte)))
+		{
+			thread_add_rss(current, HPGPAGES);
+			return true;
+		}
+		palloc_free_multiple(newpage, HPGPAGES);
+	}
+
+	sub_pte = *pte & ~PTE_PS;
+	for (i = 0; i < HPGPAGES; i++)
+		if (!duplicate_pte(&sub_pte, va + i * PGSIZE, parent))
+			return false;
+	return true;
+}
+
 /* Duplicate the parent's address space by passing this function to the
  * pml4_for_each. This is only for the project 2. */
 static bool
@@ -107,6 +311,8 @@ duplicate_pte(uint64_t *pte, void *va, void *aux)
 	if (is_kernel_vaddr(va)) {
         return true;
     }
+	if (is_huge_pte(pte))
+		return duplicate_huge_page(pte, va, parent);
 
 	/* 2. Resolve VA from the parent's page map level 4. */
 	parent_page = pml4_get_page(parent->pml4, va);
@@ -136,6 +342,7 @@ duplicate_pte(uint64_t *pte, void *va, void *aux)
 		printf("Failed to set page at virtual address %p for the child process.\n", va);
 		return false;
 	}
+	thread_add_rss(current, 1);
 	
 	return true;
 }
@@ -166,17 +373,28 @@ __do_fork(void *aux)
 	if (current->pml4 == NULL)
 		goto error;
 
+	current->fs_base = parent->fs_base;
 	process_activate(current);
 
+	/* The stacks of the parent's other threads are copied as well, so
+	 * their slots stay taken. */
+	current->stack_slots = parent->proc->stack_slots;
+	current->heap_start = parent->proc->heap_start;
+	current->heap_end = parent->proc->heap_end;
+
 #ifdef VM
 	supplemental_page_table_init(&current->spt);
-	if (!supplemental_page_table_copy(&current->spt, &parent->spt))
+	if (!supplemental_page_table_copy(&current->spt, &parent->proc->spt))
 		goto error;
 #else
 	if (!pml4_for_each(parent->pml4, duplicate_pte, parent))
 		goto error;
 #endif
 
+	/* Only a process that got this far can be waited for. */
+	if (!add_child(parent))
+		goto error;
+
 	/* TODO: Your code goes here.
 	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
 	 * TODO:       in include/filesys/file.h. Note that parent should not return
@@ -193,18 +411,25 @@ __do_fork(void *aux)
 
 	process_init();
 
-	for (int i = 3; i <= parent->max_fd; i++) {
-		*(current->fd_table+i) = file_duplicate(*(parent->fd_table+i));
+	/* The parent's other threads may open and close files meanwhile. */
+	lock_acquire(&parent->proc->fd_lock);
+	for (int i = 3; i <= parent->proc->max_fd; i++) {
+		struct file *file = *(parent->proc->fd_table+i);
+		*(current->fd_table+i) = file != NULL ? file_duplicate(file) : NULL;
 	}
 
-	current->max_fd = parent->max_fd;
+	current->max_fd = parent->proc->max_fd;
+	lock_release(&parent->proc->fd_lock);
 
-	sema_up(&parent->wait_sema);
+	parent->fork_succ = true;
+	sema_up(&parent->fork_sema);
 
 	/* Finally, switch to the newly created process. */
 	if (succ)
 		do_iret(&if_);
 error:
+	parent->fork_succ = false;
+	sema_up(&parent->fork_sema);
 	exit(TID_ERROR);
 }
 
@@ -225,6 +450,11 @@ int process_exec(void *f_name)
 
 	/* We first kill the current context */
 	process_cleanup();
+	thread_current()->fs_base = 0;
+	thread_current()->stack_slots = 0;
+#ifdef VM
+	supplemental_page_table_init(&thread_current()->spt);
+#endif
 
 	/* And then load the binary */
 	success = load(file_name, &_if);
@@ -242,50 +472,432 @@ int process_exec(void *f_name)
 	NOT_REACHED();
 }
 
-struct thread *get_child(int pid) {
-	struct thread *curr = thread_current ();
-	struct list *child_list = &curr->child_list;
-	for (struct list_elem *e = list_begin(child_list); e != list_end(child_list); e = list_next(e)){
-		struct thread *t = list_entry(e, struct thread, child_elem);
-		if (t->tid == pid) {
-			return t;
-		}
-	}
-	return NULL;
-}
-
 /* Waits for thread TID to die and returns its exit status.  If
  * it was terminated by the kernel (i.e. killed due to an
  * exception), returns -1.  If TID is invalid or if it was not a
  * child of the calling process, or if process_wait() has already
  * been successfully called for the given TID, returns -1
- * immediately, without waiting.
+ * immediately, without waiting.  A TID of -1 waits for whichever
+ * child exits first. */
+int process_wait(tid_t child_tid)
+{
+	int status;
+
+	if (process_waitpid(child_tid, &status, 0) == TID_ERROR)
+		return -1;
+	return status;
+}
+
+/* Reaps child process PID, waiting for it to exit, and stores its
+ * exit status in *STATUS if STATUS is nonnull.  If PID is -1, reaps
+ * the child that exited first, or waits for any child to exit.
+ * With WNOHANG in OPTIONS, returns 0 instead of waiting.  Returns the
+ * reaped child's tid, or TID_ERROR if there is no such child or the
+ * process starts exiting meanwhile. */
+tid_t process_waitpid(tid_t pid, int *status, int options)
+{
+	struct thread *curr = thread_current()->proc;
+	struct child_record *r;
+	int exit_status;
+	tid_t tid;
+
+	lock_acquire(&pid_lock);
+	for (;;)
+	{
+		if (pid == -1)
+		{
+			if (!list_empty(&curr->zombie_list))
+			{
+				r = list_entry(list_front(&curr->zombie_list),
+							   struct child_record, elem);
+				break;
+			}
+			if (list_empty(&curr->child_list))
+			{
+				r = NULL;
+				break;
+			}
+		}
+		else
+		{
+			struct child_record key;
+			struct hash_elem *e;
+
+			key.tid = pid;
+			e = hash_find(&pid_table, &key.pid_elem);
+			r = e != NULL ? hash_entry(e, struct child_record, pid_elem) : NULL;
+			if (r == NULL || r->parent != curr)
+			{
+				r = NULL;
+				break;
+			}
+			if (r->exited)
+				break;
+		}
+
+		if (options & WNOHANG)
+		{
+			lock_release(&pid_lock);
+			return 0;
+		}
+		if (curr->exiting)
+		{
+			r = NULL;
+			break;
+		}
+		cond_wait(&curr->child_exit, &pid_lock);
+	}
+
+	if (r == NULL)
+	{
+		lock_release(&pid_lock);
+		return TID_ERROR;
+	}
+	tid = r->tid;
+	exit_status = r->exit_status;
+	rusage_add(&curr->child_usage, &r->usage);
+	list_remove(&r->elem);
+	free_record(r);
+	lock_release(&pid_lock);
+
+	/* STATUS may be in user memory, which can fault. */
+	if (status != NULL)
+		*status = exit_status;
+	return tid;
+}
+
+/* Stores in *USAGE the resources used by the current process if WHO is
+ * RUSAGE_SELF, or by its reaped children if WHO is RUSAGE_CHILDREN.
+ * Returns false if WHO is neither.
  *
- * This function will be implemented in problem 2-2.  For now, it
- * does nothing. */
-int process_wait(tid_t child_tid UNUSED)
-{
-	/* XXX: Hint) The pintos exit if process_wait (initd), we recommend you
-	 * XXX:       to add infinite loop here before
-	 * XXX:       implementing the process_wait. */
-		
-	// pid가 살아있다면 대기
-	struct thread *child = get_child(child_tid);
+ * The main thread's usage holds its own and that of the threads that
+ * have exited, which exit_thread() adds in, so the threads still running
+ * are added here. */
+bool process_getrusage(int who, struct rusage *usage)
+{
+	struct thread *curr = thread_current()->proc;
+	struct list_elem *e;
+
+	if (who != RUSAGE_SELF && who != RUSAGE_CHILDREN)
+		return false;
+
+	lock_acquire(&pid_lock);
+	if (who == RUSAGE_SELF)
+	{
+		*usage = curr->usage;
+		for (e = list_begin(&curr->thread_list);
+			 e != list_end(&curr->thread_list); e = list_next(e))
+		{
+			struct child_record *r = list_entry(e, struct child_record, elem);
+
+			if (!r->exited)
+				rusage_add(usage, &r->thread->usage);
+		}
+	}
+	else
+		*usage = curr->child_usage;
+	lock_release(&pid_lock);
+	return true;
+}
+
+/* Starts a new thread in the current process, which runs user code at
+ * ENTRY with ARG0 and ARG1 as its first two arguments, on a stack of its
+ * own, and with FS_BASE as its FS base.  It shares the address space and
+ * open files of the process.  Returns the new thread's tid, or TID_ERROR
+ * if the thread cannot be created. */
+tid_t process_thread_create(uintptr_t entry, uint64_t arg0, uint64_t arg1,
+							uintptr_t fs_base)
+{
 	struct thread *curr = thread_current();
-	
-	if (child == NULL)
+	struct thread_start start;
+	tid_t tid;
+
+	memset(&start.if_, 0, sizeof start.if_);
+	start.if_.rip = entry;
+	start.if_.R.rdi = arg0;
+	start.if_.R.rsi = arg1;
+	start.if_.ds = start.if_.es = start.if_.ss = SEL_UDSEG;
+	start.if_.cs = SEL_UCSEG;
+	start.if_.eflags = FLAG_IF | FLAG_MBS;
+	start.creator = curr;
+	start.fs_base = fs_base;
+
+	tid = thread_create(curr->proc->name, PRI_DEFAULT, start_thread, &start);
+	if (tid == TID_ERROR)
+		return TID_ERROR;
+
+	sema_down(&curr->fork_sema);
+	if (!curr->fork_succ)
+	{
+		/* Reap the thread, which exits right away. */
+		process_thread_join(tid);
+		return TID_ERROR;
+	}
+	return tid;
+}
+
+/* A thread function that turns a new thread into a thread of its
+ * creator's process and enters user mode. */
+static void
+start_thread(void *aux)
+{
+	struct thread_start *start = aux;
+	struct thread *creator = start->creator;
+	struct thread *proc = creator->proc;
+	struct thread *curr = thread_current();
+	struct child_record *r = new_record(proc);
+	struct intr_frame if_ = start->if_;
+	int slot = -1;
+
+	/* Open files belong to the process. */
+	free(curr->fd_table);
+	curr->fd_table = NULL;
+
+	curr->proc = proc;
+	curr->pml4 = proc->pml4;
+	curr->fs_base = start->fs_base;
+	process_activate(curr);
+
+	/* A thread's exit record is in no pid_table, as it is no process.
+	 * Without one, the thread exits at once. */
+	lock_acquire(&pid_lock);
+	if (r != NULL)
+	{
+		list_push_back(&proc->thread_list, &r->elem);
+		r->thread = curr;
+		proc->thread_cnt++;
+	}
+	if (r != NULL && !proc->exiting)
+		for (int i = 0; i < THREAD_MAX; i++)
+			if (!(proc->stack_slots & (1u << i)))
+			{
+				proc->stack_slots |= 1u << i;
+				slot = i;
+				break;
+			}
+	lock_release(&pid_lock);
+
+	if (slot >= 0 && !setup_thread_stack(slot, &if_))
+	{
+		lock_acquire(&pid_lock);
+		proc->stack_slots &= ~(1u << slot);
+		lock_release(&pid_lock);
+		slot = -1;
+	}
+	curr->stack_slot = slot;
+	if (slot < 0)
+	{
+		creator->fork_succ = false;
+		sema_up(&creator->fork_sema);
+		curr->exit_status = -1;
+		thread_exit();
+	}
+
+	creator->fork_succ = true;
+	sema_up(&creator->fork_sema);
+	do_iret(&if_);
+	NOT_REACHED();
+}
+
+/* Waits for thread TID of the current process to exit and returns the
+ * status it exited with.  Returns -1 at once if TID is not a thread of
+ * the current process other than the caller, if it has been joined
+ * already, or if the process is exiting. */
+int process_thread_join(tid_t tid)
+{
+	struct thread *proc = thread_current()->proc;
+	int status = -1;
+
+	if (tid == thread_current()->tid)
 		return -1;
 
-	sema_down(&curr->wait_sema);
+	lock_acquire(&pid_lock);
+	while (!proc->exiting)
+	{
+		struct child_record *r = NULL;
+		struct list_elem *e;
+
+		for (e = list_begin(&proc->thread_list);
+			 e != list_end(&proc->thread_list); e = list_next(e))
+			if (list_entry(e, struct child_record, elem)->tid == tid)
+			{
+				r = list_entry(e, struct child_record, elem);
+				break;
+			}
+
+		if (r == NULL)
+			break;
+		if (r->exited)
+		{
+			status = r->exit_status;
+			list_remove(&r->elem);
+			free(r);
+			break;
+		}
+		cond_wait(&proc->thread_done, &pid_lock);
+	}
+	lock_release(&pid_lock);
+	return status;
+}
+
+/* Wakes the threads of process PROC, which is exiting, from the waits
+ * that could keep them from it: for a child, on a pipe or for console
+ * input.  They give up on seeing PROC->exiting.  Does nothing if PROC
+ * has no threads besides the main one.  Called with pid_lock held. */
+static void
+interrupt_threads(struct thread *proc)
+{
+	ASSERT(proc->exiting);
+
+	if (proc->thread_cnt == 0)
+		return;
+	cond_broadcast(&proc->child_exit, &pid_lock);
+	pipe_interrupt();
+	tty_interrupt();
+}
 
-	// 자식의 종료 상태를 찾음
-	// pid가 종료될 때 전달한 상태 반환
-	// terminate 된거면 -1 반환
-	list_remove(&child->child_elem);
+/* Waits for the other threads of process PROC to exit.  Called with
+ * pid_lock held. */
+static void
+wait_threads(struct thread *proc)
+{
+	while (proc->thread_cnt > 0)
+		cond_wait(&proc->thread_done, &pid_lock);
+}
 
-	return child->exit_status;
+/* Makes the current process exit with STATUS, unless one of its threads
+ * has done so already, in which case the process keeps that status.  The
+ * other threads exit on their way back to user mode; if the current
+ * thread is the main one, waits for them.  Returns the exit status of
+ * the process. */
+int process_exit_group(int status)
+{
+	struct thread *curr = thread_current();
+	struct thread *proc = curr->proc;
 
-	// return -1;
+	lock_acquire(&pid_lock);
+	if (!proc->exiting)
+	{
+		proc->exiting = true;
+		proc->exit_status = status;
+		cond_broadcast(&proc->thread_done, &pid_lock);
+		interrupt_threads(proc);
+	}
+	if (curr == proc)
+		wait_threads(proc);
+	status = proc->exit_status;
+	lock_release(&pid_lock);
+	return status;
+}
+
+/* Waits for the other threads of the current process to exit, or for the
+ * process to start exiting. */
+void process_wait_threads(void)
+{
+	struct thread *proc = thread_current()->proc;
+
+	lock_acquire(&pid_lock);
+	while (proc->thread_cnt > 0 && !proc->exiting)
+		cond_wait(&proc->thread_done, &pid_lock);
+	lock_release(&pid_lock);
+}
+
+/* Ends the other threads of the current process and waits for them, so
+ * that its program can be replaced.  Returns false, doing nothing, if the
+ * current thread is not the main one or the process is exiting anyway. */
+bool process_end_threads(void)
+{
+	struct thread *curr = thread_current();
+	bool success = false;
+
+	lock_acquire(&pid_lock);
+	if (curr == curr->proc && !curr->exiting)
+	{
+		curr->exiting = true;
+		cond_broadcast(&curr->thread_done, &pid_lock);
+		interrupt_threads(curr);
+		wait_threads(curr);
+		curr->exiting = false;
+		success = true;
+	}
+	lock_release(&pid_lock);
+	return success;
+}
+
+/* Moves the program break of the current process to ADDR, mapping or
+ * unmapping heap pages to match, unless ADDR is null.  The heap may not
+ * shrink below its start or grow into the thread stacks or into pages in
+ * use.  Returns the new break, or the unchanged one on failure.
+ *
+ * The threads of the process may move the break at once, so the whole
+ * move happens under its page table's lock, which also covers the pages
+ * mapped, or under pid_lock without VM. */
+void *process_brk(void *addr)
+{
+	struct thread *proc = thread_current()->proc;
+#ifdef VM
+	struct lock *lock = &proc->spt.lock;
+#else
+	struct lock *lock = &pid_lock;
+#endif
+	uintptr_t new_end = (uintptr_t)addr;
+	uintptr_t old_top, new_top;
+
+	lock_acquire(lock);
+	old_top = ROUND_UP(proc->heap_end, PGSIZE);
+	new_top = ROUND_UP(new_end, PGSIZE);
+	if (addr != NULL && new_end >= proc->heap_start && new_end <= HEAP_LIMIT
+		&& (new_top <= old_top || map_heap(old_top, new_top)))
+	{
+		if (new_top < old_top)
+			unmap_heap(new_top, old_top);
+		proc->heap_end = new_end;
+	}
+	addr = (void *)proc->heap_end;
+	lock_release(lock);
+	return addr;
+}
+
+/* Ends the current thread if its process is exiting.  Called on the way
+ * back to user mode. */
+void process_check_exit(void)
+{
+	if (thread_current()->proc->exiting)
+	{
+		intr_enable();
+		exit(-1);
+	}
+}
+
+/* Exit the current thread, which is not the main thread of its process:
+ * gives back its stack and leaves its status for thread_join(). */
+static void
+exit_thread(void)
+{
+	struct thread *curr = thread_current();
+	struct thread *proc = curr->proc;
+	struct child_record *r = curr->record;
+
+	if (curr->stack_slot >= 0)
+		free_thread_stack(curr->stack_slot);
+
+	/* Stop using the page table before the main thread may destroy it,
+	 * as in process_cleanup(). */
+	curr->pml4 = NULL;
+	pml4_activate(NULL);
+
+	lock_acquire(&pid_lock);
+	if (curr->stack_slot >= 0)
+		proc->stack_slots &= ~(1u << curr->stack_slot);
+	rusage_add(&proc->usage, &curr->usage);
+	if (r != NULL)
+	{
+		r->exited = true;
+		r->exit_status = curr->exit_status;
+		proc->thread_cnt--;
+		cond_broadcast(&proc->thread_done, &pid_lock);
+	}
+	lock_release(&pid_lock);
 }
 
 /* Exit the process. This function is called by thread_exit (). */
@@ -295,12 +907,68 @@ void process_exit(void)
 	 * TODO: Implement process termination message (see
 	 * TODO: project2/process_termination.html).
 	 * TODO: We recommend you to implement process resource cleanup here. */
-	struct thread *parent = thread_current()->parent;
-	
-	if (parent)
-		sema_up(&parent->wait_sema);
+	struct thread *curr = thread_current();
+	struct child_record *r = curr->record;
+
+	if (curr != curr->proc)
+	{
+		exit_thread();
+		return;
+	}
+
+	/* The other threads go first, as they share everything. */
+	lock_acquire(&pid_lock);
+	curr->exiting = true;
+	cond_broadcast(&curr->thread_done, &pid_lock);
+	interrupt_threads(curr);
+	wait_threads(curr);
+	while (!list_empty(&curr->thread_list))
+		free(list_entry(list_pop_front(&curr->thread_list),
+						struct child_record, elem));
+	lock_release(&pid_lock);
+
+	/* Close every open file.  This is what lets the other end of a
+	 * pipe see end of file. */
+	if (curr->fd_table != NULL)
+		for (int fd = 3; fd <= curr->max_fd; fd++)
+		{
+			file_close(curr->fd_table[fd]);
+			curr->fd_table[fd] = NULL;
+		}
+
+	lock_acquire(&pid_lock);
+
+	/* Orphan the running children and drop the exited ones. */
+	while (!list_empty(&curr->child_list))
+		list_entry(list_pop_front(&curr->child_list),
+				   struct child_record, elem)->parent = NULL;
+	while (!list_empty(&curr->zombie_list))
+		free_record(list_entry(list_pop_front(&curr->zombie_list),
+							   struct child_record, elem));
+
+	/* Leave the exit status to the parent, if it is still there. */
+	if (r != NULL)
+	{
+		r->exited = true;
+		r->exit_status = curr->exit_status;
+		r->usage = curr->usage;
+		rusage_add(&r->usage, &curr->child_usage);
+		if (r->parent == NULL)
+			free_record(r);
+		else
+		{
+			list_remove(&r->elem);
+			list_push_back(&r->parent->zombie_list, &r->elem);
+			cond_broadcast(&r->parent->child_exit, &pid_lock);
+		}
+	}
+	lock_release(&pid_lock);
 
 	process_cleanup();
+#ifdef VM
+	free(curr->faults);
+	curr->faults = NULL;
+#endif
 }
 
 /* Free the current process's resources. */
@@ -340,6 +1008,9 @@ void process_activate(struct thread *next)
 	/* Activate thread's page tables. */
 	pml4_activate(next->pml4);
 
+	/* Switch thread-local storage. */
+	write_msr(MSR_FS_BASE, next->fs_base);
+
 	/* Set thread's kernel stack for use in processing interrupts. */
 	tss_update(next);
 }
@@ -463,6 +1134,7 @@ load(const char *file_name, struct intr_frame *if_)
 	if (t->pml4 == NULL)
 		goto done;
 	process_activate(thread_current());
+	t->heap_start = 0;
 
 	// 공백을 기준으로 단어 분리
 	char *token, *save_ptr;
@@ -538,6 +1210,8 @@ load(const char *file_name, struct intr_frame *if_)
 				if (!load_segment(file, file_page, (void *)mem_page,
 								  read_bytes, zero_bytes, writable))
 					goto done;
+				if (mem_page + read_bytes + zero_bytes > t->heap_start)
+					t->heap_start = mem_page + read_bytes + zero_bytes;
 			}
 			else
 				goto done;
@@ -545,6 +1219,9 @@ load(const char *file_name, struct intr_frame *if_)
 		}
 	}
 
+	/* The heap starts out empty, right after the program. */
+	t->heap_end = t->heap_start;
+
 	/* Set up stack. */
 	if (!setup_stack(if_))
 		goto done;
@@ -712,7 +1389,103 @@ install_page(void *upage, void *kpage, bool writable)
 
 	/* Verify that there's not already a page at that virtual
 	 * address, then map our page there. */
-	return (pml4_get_page(t->pml4, upage) == NULL && pml4_set_page(t->pml4, upage, kpage, writable));
+	if (pml4_get_page(t->pml4, upage) != NULL || !pml4_set_page(t->pml4, upage, kpage, writable))
+		return false;
+	thread_add_rss(t->proc, 1);
+	return true;
+}
+
+/* Maps a zeroed page at the top of thread stack SLOT, as setup_stack()
+ * does for the main thread. */
+static bool
+setup_thread_stack(int slot, struct intr_frame *if_)
+{
+	uint8_t *top = (uint8_t *)THREAD_STACK_TOP - slot * THREAD_STACK_SIZE;
+	uint8_t *kpage;
+
+	kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+	if (kpage == NULL)
+		return false;
+	if (!install_page(top - PGSIZE, kpage, true))
+	{
+		palloc_free_page(kpage);
+		return false;
+	}
+	if_->rsp = (uintptr_t)top - sizeof(void *);
+	return true;
+}
+
+/* Unmaps and frees the page of thread stack SLOT, if mapped. */
+static void
+free_thread_stack(int slot)
+{
+	struct thread *proc = thread_current()->proc;
+	uint8_t *upage = (uint8_t *)THREAD_STACK_TOP - slot * THREAD_STACK_SIZE
+		- PGSIZE;
+	void *kpage = pml4_get_page(proc->pml4, upage);
+
+	if (kpage != NULL)
+	{
+		pml4_clear_page(proc->pml4, upage);
+		palloc_free_page(kpage);
+		thread_add_rss(proc, -1);
+	}
+}
+
+/* Unmaps and frees the heap pages from START up to END.  Called with
+ * pid_lock held. */
+static void
+unmap_heap(uintptr_t start, uintptr_t end)
+{
+	struct thread *proc = thread_current()->proc;
+
+	for (; start < end; start += PGSIZE)
+	{
+		void *kpage = pml4_get_page(proc->pml4, (void *)start);
+
+		if (kpage == NULL)
+			continue;
+		pml4_clear_page(proc->pml4, (void *)start);
+		palloc_free_page(kpage);
+		thread_add_rss(proc, -1);
+	}
+}
+
+/* Maps zeroed heap pages from START up to END, using huge pages where the
+ * range covers them and contiguous memory is free.  On failure, maps none
+ * of them.  Called with pid_lock held. */
+static bool
+map_heap(uintptr_t start, uintptr_t end)
+{
+	struct thread *t = thread_current();
+	uintptr_t va;
+
+	for (va = start; va < end; va += PGSIZE)
+	{
+		void *kpage;
+
+		if (hpg_ofs(va) == 0 && end - va >= HPGSIZE
+			&& (kpage = palloc_get_huge_page(PAL_USER | PAL_ZERO)) != NULL)
+		{
+			if (pml4_set_huge_page(t->pml4, (void *)va, kpage, true))
+			{
+				thread_add_rss(t->proc, HPGPAGES);
+				va += HPGSIZE - PGSIZE;
+				continue;
+			}
+			palloc_free_multiple(kpage, HPGPAGES);
+		}
+
+		kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+
+		if (kpage == NULL || !install_page((void *)va, kpage, true))
+		{
+			palloc_free_page(kpage);
+			unmap_heap(start, va);
+			return false;
+		}
+	}
+	return true;
 }
 #else
 /* From here, codes will be used after project 3.
@@ -722,9 +1495,18 @@ install_page(void *upage, void *kpage, bool writable)
 static bool
 lazy_load_segment(struct page *page, void *aux)
 {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
+	struct lazy_load_arg *arg = aux;
+	void *kva = page->frame->kva;
+	bool success = true;
+
+	if (file_read_at(arg->file, kva, arg->read_bytes, arg->ofs) != (int)arg->read_bytes)
+		success = false;
+	else
+		memset(kva + arg->read_bytes, 0, arg->zero_bytes);
+
+	file_close(arg->file);
+	free(arg);
+	return success;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -749,26 +1531,17 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT(pg_ofs(upage) == 0);
 	ASSERT(ofs % PGSIZE == 0);
 
-	while (read_bytes > 0 || zero_bytes > 0)
-	{
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer(VM_ANON, upage,
-											writable, lazy_load_segment, aux))
-			return false;
-
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-	}
-	return true;
+	/* The segment is one VMA, whose pages are read as they are touched.
+	 * Read-only pages are text: they come from the text cache, marked
+	 * with VM_MARKER_1, and keep the executable from being written while
+	 * they exist.  Writable pages get a private anonymous copy, or start
+	 * out as zeros past the file's data. */
+	if (writable)
+		return vma_map(upage, (read_bytes + zero_bytes) / PGSIZE, VM_ANON,
+					   true, lazy_load_segment, file, ofs, read_bytes) != NULL;
+	return vma_map(upage, (read_bytes + zero_bytes) / PGSIZE,
+				   VM_FILE | VM_MARKER_1, false, file_lazy_load, file, ofs,
+				   read_bytes) != NULL;
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
@@ -778,11 +1551,84 @@ setup_stack(struct intr_frame *if_)
 	bool success = false;
 	void *stack_bottom = (void *)(((uint8_t *)USER_STACK) - PGSIZE);
 
-	/* TODO: Map the stack on stack_bottom and claim the page immediately.
-	 * TODO: If success, set the rsp accordingly.
-	 * TODO: You should mark the page is stack. */
-	/* TODO: Your code goes here */
+	/* The stack is a VMA of anonymous pages, marked with VM_MARKER_0,
+	 * which grows down on faults. */
+	if (vma_map(stack_bottom, 1, VM_ANON | VM_MARKER_0, true, NULL, NULL, 0, 0)
+		!= NULL)
+	{
+		success = vm_claim_page(stack_bottom);
+		if (success)
+			if_->rsp = USER_STACK;
+	}
+
+	return success;
+}
+
+/* Sets up thread stack SLOT as a VMA of anonymous stack pages, which are
+ * brought in when first touched.  The stack does not grow beyond the
+ * slot.  Fails, changing nothing, if any of the pages is in use already. */
+static bool
+setup_thread_stack(int slot, struct intr_frame *if_)
+{
+	struct supplemental_page_table *spt = &thread_current()->proc->spt;
+	uint8_t *top = (uint8_t *)THREAD_STACK_TOP - slot * THREAD_STACK_SIZE;
+	bool success;
 
+	lock_acquire(&spt->lock);
+	success = vma_map(top - THREAD_STACK_SIZE + PGSIZE,
+					  THREAD_STACK_SIZE / PGSIZE - 1, VM_ANON | VM_MARKER_0,
+					  true, NULL, NULL, 0, 0) != NULL;
+	lock_release(&spt->lock);
+
+	if (success)
+		if_->rsp = (uintptr_t)top - sizeof(void *);
 	return success;
 }
+
+/* Removes the VMA of thread stack SLOT, along with its pages. */
+static void
+free_thread_stack(int slot)
+{
+	struct supplemental_page_table *spt = &thread_current()->proc->spt;
+	uint8_t *top = (uint8_t *)THREAD_STACK_TOP - slot * THREAD_STACK_SIZE;
+	struct vma *stack;
+
+	lock_acquire(&spt->lock);
+	stack = vma_find(spt, top - 1);
+	if (stack != NULL)
+		vma_unmap(spt, stack);
+	lock_release(&spt->lock);
+}
+
+/* Trims the heap, which is one anonymous VMA ending at END, back to
+ * START, removing the pages that have been touched from there on, or
+ * removes the VMA if START is its start.  Called with the page table's
+ * lock held. */
+static void
+unmap_heap(uintptr_t start, uintptr_t end)
+{
+	struct supplemental_page_table *spt = &thread_current()->proc->spt;
+	struct vma *heap = vma_find(spt, (void *)(end - 1));
+
+	if ((uintptr_t)heap->start == start)
+		vma_unmap(spt, heap);
+	else
+		vma_set_end(spt, heap, (void *)start);
+}
+
+/* Extends the heap, which ends at START, up to END.  The heap is one
+ * anonymous VMA, set up when it first grows, whose pages are brought in,
+ * zeroed, when first touched.  Fails, changing nothing, if another VMA or
+ * page is in the way.  Called with the page table's lock held. */
+static bool
+map_heap(uintptr_t start, uintptr_t end)
+{
+	struct thread *proc = thread_current()->proc;
+	struct supplemental_page_table *spt = &proc->spt;
+
+	if (start == ROUND_UP(proc->heap_start, PGSIZE))
+		return vma_map((void *)start, (end - start) / PGSIZE, VM_ANON, true,
+					   NULL, NULL, 0, 0) != NULL;
+	return vma_set_end(spt, vma_find(spt, (void *)(start - 1)), (void *)end);
+}
 #endif /* VM */
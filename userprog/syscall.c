@@ -11,10 +11,16 @@
 #include "filesys/file.h"
 #include "threads/init.h"
 #include "devices/input.h"
+#include "devices/tty.h"
 #include "userprog/process.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "string.h"
+#include "userprog/pipe.h"
+#ifdef VM
+#include "vm/shm.h"
+#include "vm/vma.h"
+#endif
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
@@ -54,8 +60,23 @@ void
 exit (int status) {
 	struct thread *curr = thread_current();
 
-	curr->exit_status = status;
+	/* Every thread of the process exits, and the main thread reports the
+	 * status given by whichever called exit() first. */
+	curr->exit_status = process_exit_group(status);
+	if (curr != curr->proc)
+		thread_exit();
+
 	printf ("%s: exit(%d)\n", curr->name, curr->exit_status);
+	if (print_rusage) {
+		struct rusage usage, *u = &usage;
+
+		process_getrusage(RUSAGE_SELF, u);
+		printf ("%s: rusage: utime %lld stime %lld nvcsw %lld nivcsw %lld "
+				"majflt %lld minflt %lld inblock %lld oublock %lld "
+				"maxrss %lld\n", curr->name, u->utime, u->stime, u->nvcsw,
+				u->nivcsw, u->majflt, u->minflt, u->inblock, u->oublock,
+				u->maxrss);
+	}
 	thread_exit();
 }
 
@@ -70,6 +91,11 @@ int
 exec (const char *file) {
 	check_address(file);
 
+	/* Only the main thread may replace the program, and it ends the
+	 * others first. */
+	if (!process_end_threads())
+		return -1;
+
 	char *fn_copy = palloc_get_page(PAL_ZERO);
 	if (fn_copy == NULL) {
 		exit(-1);
@@ -89,10 +115,33 @@ wait (tid_t pid) {
 	return process_wait(pid);
 }
 
+static tid_t
+waitpid (tid_t pid, int *status, int options) {
+	if (status != NULL)
+		check_address((const uint64_t *)status);
+	return process_waitpid(pid, status, options);
+}
+
 void check_address(const uint64_t *addr) {
 	struct thread *curr = thread_current();
-	if (addr == NULL || !(is_user_vaddr(addr)) || pml4_get_page(curr->pml4, addr) == NULL)
+	if (addr == NULL || !(is_user_vaddr(addr)))
 		exit(-1);
+#ifdef VM
+	/* Pages may not be loaded yet, and the stack grows on fault. */
+	struct supplemental_page_table *spt = &curr->proc->spt;
+	bool mapped;
+
+	lock_acquire(&spt->lock);
+	mapped = spt_find_page(spt, (void *)addr) != NULL
+		|| vma_find(spt, addr) != NULL;
+	lock_release(&spt->lock);
+	if (!mapped
+		&& !((uintptr_t)addr >= curr->user_rsp - 8 && (uintptr_t)addr >= USER_STACK - STACK_LIMIT))
+		exit(-1);
+#else
+	if (pml4_get_page(curr->pml4, addr) == NULL)
+		exit(-1);
+#endif
 }
 
 bool
@@ -105,36 +154,59 @@ create (const char *file, unsigned initial_size) {
 int
 open (const char *file) {
 	check_address(file);
-	struct thread *curr = thread_current();
+	struct thread *curr = thread_current()->proc;
 	struct file *f;
 
 	if ((f = filesys_open(file))) {
-		// fd 생성
-		curr->max_fd++;
+		int fd;
 
 		if (strcmp(thread_name(), file) == 0)
 			file_deny_write(f);
+
+		lock_acquire(&curr->fd_lock);
+		// fd 생성
+		fd = ++curr->max_fd;
 		// 스레드 구조체 속 파일 배열에 push
-		*(curr->fd_table + curr->max_fd) = f;
+		*(curr->fd_table + fd) = f;
+		lock_release(&curr->fd_lock);
 		
 		// fd 반환
-		return curr->max_fd;
+		return fd;
 	}
 	return -1;
 }
 
+/* Returns the file open as FD in the current process, with a reference
+ * that the caller drops with file_close() once done with it, or a null
+ * pointer if FD is not open.  Another thread may close FD meanwhile; the
+ * file stays valid until the reference is dropped. */
+static struct file *
+fd_get (int fd) {
+	struct thread *curr = thread_current()->proc;
+	struct file *file = NULL;
+
+	lock_acquire(&curr->fd_lock);
+	if (fd >= 0 && fd <= curr->max_fd && curr->fd_table[fd] != NULL)
+		file = file_get(curr->fd_table[fd]);
+	lock_release(&curr->fd_lock);
+	return file;
+}
+
 int
 filesize (int fd) {
-	struct thread *curr = thread_current();
 	// file 찾기
-	struct file *file = *(curr->fd_table + fd);
+	struct file *file = fd_get(fd);
+	int length;
+
 	if (file == NULL)
 		return -1;
-	return file_length(file);
+	length = file_length(file);
+	file_close(file);
+	return length;
 }
 
 void check_fd(const int fd) {
-	struct thread *curr = thread_current();
+	struct thread *curr = thread_current()->proc;
 	if (fd < 0 || fd > curr->max_fd)
 		exit(-1);
 }
@@ -144,19 +216,16 @@ read (int fd, void *buffer, unsigned size) {
 	check_fd(fd);
 	check_address(buffer);
 	
-	struct thread *curr = thread_current();
 	int bytes = 0;
-	if (fd == 0) {
-		for (unsigned i = 0; i< size; i++)
-			*((char *)buffer + i) = input_getc();
-		bytes = size;
-	}
+	if (fd == 0)
+		bytes = tty_read(buffer, size);
 	else if (fd >=3) {
 		// file 찾기
-		struct file *file = *(curr->fd_table + fd);
+		struct file *file = fd_get(fd);
 		if (file == NULL)
 			return -1;
 		bytes = file_read(file, buffer, size);
+		file_close(file);
 	}
 	
 	return bytes;
@@ -165,15 +234,20 @@ read (int fd, void *buffer, unsigned size) {
 void
 close (int fd) {
 	check_fd(fd);
-	struct thread *curr = thread_current();
+	struct thread *curr = thread_current()->proc;
+	lock_acquire(&curr->fd_lock);
 	// file 찾기
 	struct file *file = *(curr->fd_table + fd);
 	if (file == NULL)
+	{
+		lock_release(&curr->fd_lock);
 		exit(-1);
-	file_close(file);
+	}
 	if (fd == curr->max_fd)
 		curr->max_fd--;
 	*(curr->fd_table + fd) = NULL;
+	lock_release(&curr->fd_lock);
+	file_close(file);
 }
 
 int
@@ -187,14 +261,16 @@ write (int fd, const void *buffer, unsigned size) {
 		return size;
 	}
 	else if (fd >= 3) {
-		struct thread *curr = thread_current();
-		struct file *file = *(curr->fd_table + fd);
+		struct file *file = fd_get(fd);
+		int bytes;
 
 		if (file == NULL)
 			return -1;
 
 		// buffer에서 fd 파일로 size 바이트만큼 쓰기
-		return file_write(file, buffer, size);
+		bytes = file_write(file, buffer, size);
+		file_close(file);
+		return bytes;
 	}
 	return 0;
 	
@@ -204,6 +280,216 @@ write (int fd, const void *buffer, unsigned size) {
 	// (큰 버퍼는 분할)
 }
 
+static int
+pipe (int *fds) {
+	struct thread *curr = thread_current()->proc;
+	struct file *r, *w;
+	int rfd, wfd;
+
+	check_address((const uint64_t *)fds);
+	check_address((const uint64_t *)(fds + 1));
+	lock_acquire(&curr->fd_lock);
+	if (curr->max_fd + 2 >= FDT_LIMIT || !pipe_create(&r, &w))
+	{
+		lock_release(&curr->fd_lock);
+		return -1;
+	}
+	rfd = ++curr->max_fd;
+	curr->fd_table[rfd] = r;
+	wfd = ++curr->max_fd;
+	curr->fd_table[wfd] = w;
+	lock_release(&curr->fd_lock);
+
+	/* Storing into FDS may fault, so it waits until the lock is free. */
+	fds[0] = rfd;
+	fds[1] = wfd;
+	return 0;
+}
+
+/* Stores in *USAGE the resources used by the current process if WHO is
+ * RUSAGE_SELF, or by its reaped children if RUSAGE_CHILDREN.  Returns 0,
+ * or -1 if WHO is neither. */
+static int
+getrusage (int who, struct rusage *usage) {
+	check_address((const uint64_t *)usage);
+	check_address((const uint64_t *)(usage + 1) - 1);
+	return process_getrusage(who, usage) ? 0 : -1;
+}
+
+/* Starts a new thread of the current process at user address ENTRY, with
+ * ARG0 and ARG1 as its first two arguments and TLS as its FS base.
+ * Returns the new thread's tid, or -1. */
+static tid_t
+thread_create_sys (void *entry, uint64_t arg0, uint64_t arg1, void *tls) {
+	if (entry == NULL || !is_user_vaddr(entry) || !is_user_vaddr(tls))
+		return -1;
+	return process_thread_create((uintptr_t)entry, arg0, arg1, (uintptr_t)tls);
+}
+
+/* Ends the current thread with STATUS, for thread_join().  The process
+ * goes on until its last thread ends; if that is the main thread, this
+ * waits for the others first. */
+static void
+thread_exit_sys (int status) {
+	struct thread *curr = thread_current();
+
+	if (curr != curr->proc) {
+		curr->exit_status = status;
+		thread_exit();
+	}
+	process_wait_threads();
+	exit(0);
+}
+
+/* Makes TLS the FS base of the current thread. */
+static void
+set_tls (void *tls) {
+	if (!is_user_vaddr(tls))
+		exit(-1);
+	thread_current()->fs_base = (uintptr_t)tls;
+	process_activate(thread_current());
+}
+
+/* Writes SIZE bytes from BUFFER into the pipe whose write end is FD,
+ * moving whole pages instead of copying them.  The moved pages of
+ * BUFFER read as zeros afterward. */
+static int
+vmsplice (int fd, const void *buffer, unsigned size) {
+	check_fd(fd);
+	check_address(buffer);
+
+	struct file *file = fd >= 3 ? fd_get(fd) : NULL;
+	struct pipe *p;
+	bool writer;
+	int written = -1;
+
+	if (file != NULL && (p = file_get_pipe(file, &writer)) != NULL && writer)
+		written = pipe_vmsplice(p, buffer, size);
+	file_close(file);
+	return written;
+}
+
+/* Copies up to SIZE bytes of the file IN_FD, starting at byte OFS, to
+ * OUT_FD, which may be the console, through a kernel bounce buffer.  The
+ * position of IN_FD is unaffected; that of OUT_FD advances.  Returns the
+ * number of bytes copied, or -1. */
+static int
+sendfile (int out_fd, int in_fd, off_t ofs, unsigned size) {
+	check_fd(out_fd);
+	check_fd(in_fd);
+
+	struct file *in = in_fd >= 3 ? fd_get(in_fd) : NULL;
+	struct file *out = out_fd >= 3 ? fd_get(out_fd) : NULL;
+	void *bounce = NULL;
+	int copied = 0;
+
+	if (in == NULL || file_get_inode(in) == NULL || ofs < 0
+		|| (out_fd != 1 && out == NULL)
+		|| (bounce = palloc_get_page(0)) == NULL)
+	{
+		file_close(in);
+		file_close(out);
+		return -1;
+	}
+
+	while (size > 0) {
+		int chunk = size < PGSIZE ? size : PGSIZE;
+		int n = file_read_at(in, bounce, chunk, ofs + copied);
+		int written;
+
+		if (n <= 0)
+			break;
+		if (out_fd == 1) {
+			putbuf(bounce, n);
+			written = n;
+		}
+		else
+			written = file_write(out, bounce, n);
+		if (written > 0)
+			copied += written;
+		if (written != n)
+			break;
+		size -= n;
+	}
+
+	palloc_free_page(bounce);
+	file_close(in);
+	file_close(out);
+	return copied;
+}
+
+#ifdef VM
+static void *
+mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
+	struct file *file = fd >= 3 ? fd_get(fd) : NULL;
+	void *mapped;
+
+	if (file == NULL)
+		return NULL;
+	mapped = do_mmap(addr, length, writable, file, offset);
+	file_close(file);
+	return mapped;
+}
+
+static void
+munmap (void *addr) {
+	do_munmap(addr);
+}
+
+static int
+madvise (void *addr, size_t length, int advice) {
+	return do_madvise(addr, length, advice);
+}
+
+static int
+msync (void *addr, size_t length, int flags) {
+	return do_msync(addr, length, flags);
+}
+
+/* Stores in *STATS the page faults handled for the current process if WHO
+ * is FAULTSTAT_SELF, or for every process if FAULTSTAT_ALL.  Returns 0, or
+ * -1 if WHO is neither or kernel memory runs out. */
+static int
+faultstat (int who, struct faultstat *stats) {
+	check_address((const uint64_t *)stats);
+	check_address((const uint64_t *)(stats + 1) - 1);
+	return vm_get_faultstat(who, stats) ? 0 : -1;
+}
+
+/* Opens the shared-memory segment NAME, creating it with SIZE bytes of
+ * zeros if it does not exist and SIZE is nonzero.  Returns a file
+ * descriptor to mmap() it with, or -1. */
+static int
+shm_open (const char *name, size_t size) {
+	check_address((const uint64_t *)name);
+
+	struct thread *curr = thread_current()->proc;
+	struct shm *shm;
+	struct file *file;
+	int fd = -1;
+
+	lock_acquire(&curr->fd_lock);
+	if (curr->max_fd + 1 < FDT_LIMIT && (shm = shm_lookup(name, size)) != NULL)
+	{
+		if ((file = file_open_shm(shm)) != NULL)
+		{
+			fd = ++curr->max_fd;
+			curr->fd_table[fd] = file;
+		}
+		else
+			shm_put(shm);
+	}
+	lock_release(&curr->fd_lock);
+	return fd;
+}
+
+static bool
+shm_unlink (const char *name) {
+	check_address((const uint64_t *)name);
+	return shm_remove(name);
+}
+#endif
+
 void
 seek (int fd, unsigned position) {
 
@@ -220,6 +506,8 @@ syscall_handler (struct intr_frame *f UNUSED) {
 	// intr_frame 통해 레지스터 상태 접근
 	// %rax 에 함수 리턴값 배치
 	 
+	thread_current()->user_rsp = f->rsp;
+
 	switch (f->R.rax)
 	{
 		case SYS_HALT:
@@ -264,12 +552,73 @@ syscall_handler (struct intr_frame *f UNUSED) {
 		case SYS_CLOSE:
 			close(f->R.rdi);
 			break;
+		case SYS_WAITPID:
+			f->R.rax = waitpid(f->R.rdi, (int *)f->R.rsi, f->R.rdx);
+			break;
+		case SYS_PIPE:
+			f->R.rax = pipe((int *)f->R.rdi);
+			break;
+		case SYS_VMSPLICE:
+			f->R.rax = vmsplice(f->R.rdi, (void *)f->R.rsi, f->R.rdx);
+			break;
+		case SYS_TTY_MODE:
+			f->R.rax = tty_set_mode(f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_THREAD_CREATE:
+			f->R.rax = thread_create_sys((void *)f->R.rdi, f->R.rsi, f->R.rdx,
+				(void *)f->R.r10);
+			break;
+		case SYS_THREAD_JOIN:
+			f->R.rax = process_thread_join(f->R.rdi);
+			break;
+		case SYS_THREAD_EXIT:
+			thread_exit_sys(f->R.rdi);
+			break;
+		case SYS_SET_TLS:
+			set_tls((void *)f->R.rdi);
+			break;
+		case SYS_BRK:
+			f->R.rax = (uint64_t)process_brk((void *)f->R.rdi);
+			break;
+		case SYS_GETRUSAGE:
+			f->R.rax = getrusage(f->R.rdi, (struct rusage *)f->R.rsi);
+			break;
+		case SYS_SENDFILE:
+			f->R.rax = sendfile(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10);
+			break;
+#ifdef VM
+		case SYS_MMAP:
+			f->R.rax = (uint64_t)mmap((void *)f->R.rdi, f->R.rsi, f->R.rdx,
+				f->R.r10, f->R.r8);
+			break;
+		case SYS_MUNMAP:
+			munmap((void *)f->R.rdi);
+			break;
+		case SYS_MADVISE:
+			f->R.rax = madvise((void *)f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_MSYNC:
+			f->R.rax = msync((void *)f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_FAULTSTAT:
+			f->R.rax = faultstat(f->R.rdi, (struct faultstat *)f->R.rsi);
+			break;
+		case SYS_SHM_OPEN:
+			f->R.rax = shm_open((char *)f->R.rdi, f->R.rsi);
+			break;
+		case SYS_SHM_UNLINK:
+			f->R.rax = shm_unlink((char *)f->R.rdi);
+			break;
+#endif
 		
 		default:
 			exit(-1);
 			break;
 	}
 
+	/* A thread of an exiting process does not go back to user mode. */
+	process_check_exit();
+
 	// printf ("system call!\n");
 	// thread_exit ();
 }
@@ -1,7 +1,15 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <bitmap.h>
+#include <stdio.h>
+#include <string.h>
 #include "devices/disk.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/shm.h"
+#include "vm/zswap.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,36 +25,336 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Number of disk sectors in a swap slot, which holds one page. */
+#define SLOT_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Slots of swap_disk in use. */
+static struct bitmap *swap_slots;
+
+/* Protects swap_slots. */
+static struct lock swap_lock;
+
+/* Swap clusters.  Neighbouring anonymous pages of a process that are
+ * evicted together go to consecutive slots in a single disk request,
+ * and come back together the same way.  A cluster lies within an aligned
+ * block of CLUSTER_PAGES pages of the address space. */
+#define CLUSTER_PAGES 8
+#define CLUSTER_SIZE (CLUSTER_PAGES * PGSIZE)
+
+/* Bounce buffer for the disk transfer of a cluster, whose pages are
+ * scattered over memory. */
+static void *cluster_buf;
+
+/* Protects cluster_buf. */
+static struct lock cluster_lock;
+
+/* Statistics. */
+static long long out_pages;         /* Pages written to swap. */
+static long long out_clusters;      /* ...in this many disk requests. */
+static long long in_pages;          /* Pages read from swap. */
+static long long in_clusters;       /* ...in this many disk requests. */
+static long long readahead_pages;   /* ...of which nobody asked for yet. */
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	swap_disk = disk_get (1, 1);
+	swap_slots = bitmap_create (swap_disk != NULL
+			? disk_size (swap_disk) / SLOT_SECTORS : 0);
+	if (swap_slots == NULL)
+		PANIC ("vm_anon_init: out of memory");
+	lock_init (&swap_lock);
+	cluster_buf = palloc_get_multiple (PAL_ASSERT, CLUSTER_PAGES);
+	lock_init (&cluster_lock);
+	zswap_init ();
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void) {
+	printf ("Swap: %lld pages out in %lld requests, "
+			"%lld pages in in %lld requests (%lld read ahead)\n",
+			out_pages, out_clusters, in_pages, in_clusters, readahead_pages);
+	zswap_print_stats ();
+}
+
+/* Allocates CNT consecutive swap slots and returns the first, or
+ * BITMAP_ERROR if there is no such run free. */
+static size_t
+swap_alloc (size_t cnt) {
+	size_t slot;
+
+	lock_acquire (&swap_lock);
+	slot = bitmap_scan_and_flip (swap_slots, 0, cnt, false);
+	lock_release (&swap_lock);
+	return slot;
+}
+
+/* Writes the page at KVA to a free swap slot and returns the slot, or
+ * BITMAP_ERROR if swap is full. */
+size_t
+swap_write (const void *kva) {
+	size_t slot = swap_alloc (1);
+
+	if (slot != BITMAP_ERROR) {
+		disk_write_multiple (swap_disk, slot * SLOT_SECTORS, kva,
+				SLOT_SECTORS);
+		out_pages++;
+		out_clusters++;
+	}
+	return slot;
+}
+
+/* Reads swap slot SLOT into the page at KVA and frees the slot. */
+void
+swap_read (size_t slot, void *kva) {
+	swap_copy (slot, kva);
+	swap_free (slot);
+}
+
+/* Reads swap slot SLOT into the page at KVA and keeps the slot. */
+void
+swap_copy (size_t slot, void *kva) {
+	disk_read_multiple (swap_disk, slot * SLOT_SECTORS, kva, SLOT_SECTORS);
+	in_pages++;
+	in_clusters++;
+}
+
+/* Frees swap slot SLOT without reading it. */
+void
+swap_free (size_t slot) {
+	lock_acquire (&swap_lock);
+	ASSERT (bitmap_test (swap_slots, slot));
+	bitmap_reset (swap_slots, slot);
+	lock_release (&swap_lock);
+}
+
+/* Returns the start of the cluster block that VA lies in. */
+static uint8_t *
+cluster_base (void *va) {
+	return (uint8_t *) ((uintptr_t) va & ~(uintptr_t) (CLUSTER_SIZE - 1));
+}
+
+/* Returns true if NEAR is a private anonymous page. */
+static bool
+is_private_anon (struct page *near) {
+	return near != NULL && VM_TYPE (near->operations->type) == VM_ANON
+		&& near->anon.shm == NULL;
+}
+
+/* Returns true if NEAR may go to swap in the same cluster as PAGE. */
+static bool
+swap_out_along (struct page *page, struct page *near) {
+	return is_private_anon (near) && vm_evict_along (page, near);
+}
+
+/* Returns true if NEAR is swapped out in the same cluster as PAGE, at the
+ * slot that matches its distance from PAGE. */
+static bool
+swapped_along (struct page *page, struct page *near) {
+	ptrdiff_t distance;
+
+	if (!is_private_anon (near) || near->frame != NULL
+			|| near->anon.swap_slot == BITMAP_ERROR)
+		return false;
+	distance = ((uint8_t *) near->va - (uint8_t *) page->va) / PGSIZE;
+	return (ptrdiff_t) (near->anon.swap_slot - page->anon.swap_slot)
+		== distance;
+}
+
+/* Fills CLUSTER with the pages, in address order, of the largest run
+ * around PAGE within its cluster block whose pages all satisfy
+ * ALONG (PAGE, page), and returns their number.  PAGE is always
+ * included.  The caller must hold the page table lock of PAGE's
+ * process. */
+static size_t
+cluster_gather (struct page *page, struct page *cluster[],
+		bool (*along) (struct page *, struct page *)) {
+	struct supplemental_page_table *spt = &page->owner->spt;
+	uint8_t *base = cluster_base (page->va);
+	uint8_t *lo = page->va, *hi = (uint8_t *) page->va + PGSIZE;
+	size_t cnt = 0;
+	uint8_t *va;
+
+	while (lo > base && along (page, spt_find_page (spt, lo - PGSIZE)))
+		lo -= PGSIZE;
+	while (hi < base + CLUSTER_SIZE && along (page, spt_find_page (spt, hi)))
+		hi += PGSIZE;
+	for (va = lo; va < hi; va += PGSIZE)
+		cluster[cnt++] = va == page->va ? page : spt_find_page (spt, va);
+	return cnt;
 }
 
 /* Initialize the file mapping */
 bool
-anon_initializer (struct page *page, enum vm_type type, void *kva) {
+anon_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &anon_ops;
 
-	struct anon_page *anon_page = &page->anon;
+	page->anon = (struct anon_page) {
+		.swap_slot = BITMAP_ERROR,
+	};
+	return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Swap in the page by read contents from the swap disk.  The rest of
+ * its cluster that is still swapped out comes along in the same disk
+ * request, into free frames, if there are any.  This is only done in a
+ * page fault, whose handler holds the page table lock. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	struct page *cluster[CLUSTER_PAGES];
+	size_t cnt, first, i;
+
+	if (anon_page->shm != NULL)
+		return shm_swap_in (page, kva);
+	if (anon_page->zswap != NULL) {
+		zswap_load (anon_page->zswap, kva);
+		anon_page->zswap = NULL;
+		return true;
+	}
+	if (anon_page->swap_slot == BITMAP_ERROR)
+		return true;
+
+	cnt = lock_held_by_current_thread (&page->owner->spt.lock)
+		? cluster_gather (page, cluster, swapped_along) : 1;
+	if (cnt == 1) {
+		swap_read (anon_page->swap_slot, kva);
+		anon_page->swap_slot = BITMAP_ERROR;
+		return true;
+	}
+
+	first = cluster[0]->anon.swap_slot;
+	lock_acquire (&cluster_lock);
+	disk_read_multiple (swap_disk, first * SLOT_SECTORS, cluster_buf,
+			cnt * SLOT_SECTORS);
+	in_pages += cnt;
+	in_clusters++;
+	for (i = 0; i < cnt; i++) {
+		struct page *p = cluster[i];
+		void *src = (uint8_t *) cluster_buf + i * PGSIZE;
+
+		if (p == page)
+			memcpy (kva, src, PGSIZE);
+		else {
+			/* Read ahead only into memory that is free anyway. */
+			void *ra = palloc_get_page (PAL_USER);
+
+			if (ra == NULL)
+				continue;
+			memcpy (ra, src, PGSIZE);
+			if (!vm_install_page (p, ra))
+				continue;
+			readahead_pages++;
+		}
+		swap_free (p->anon.swap_slot);
+		p->anon.swap_slot = BITMAP_ERROR;
+	}
+	lock_release (&cluster_lock);
+	return true;
 }
 
-/* Swap out the page by writing contents to the swap disk. */
+/* Swap out the page by writing contents to the swap disk.  Neighbouring
+ * anonymous pages that have not been used lately go too, in the same
+ * disk request, and their frames are freed.  Every page of the cluster is
+ * unmapped before its contents are read, so that nothing stored to it
+ * meanwhile is lost. */
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+	struct page *cluster[CLUSTER_PAGES];
+	struct frame *frames[CLUSTER_PAGES];
+	struct frame *frame = page->frame;
+	size_t cnt, first, i;
+	bool dirty;
+
+	if (anon_page->shm != NULL)
+		return shm_swap_out (page);
+
+	/* Frames shared copy-on-write have no single page to swap for. */
+	ASSERT (frame->ref_cnt == 1);
+
+	dirty = pml4_is_dirty (page->owner->pml4, page->va);
+	vm_unmap_frame (frame);
+
+	/* Try the compressed pool first. */
+	anon_page->zswap = zswap_store (frame->kva);
+	if (anon_page->zswap != NULL)
+		return true;
+
+	cnt = cluster_gather (page, cluster, swap_out_along);
+	first = swap_alloc (cnt);
+	if (first == BITMAP_ERROR && cnt > 1) {
+		/* Swap is too fragmented for the cluster; go alone. */
+		cluster[0] = page;
+		cnt = 1;
+		first = swap_alloc (1);
+	}
+	if (first == BITMAP_ERROR) {
+		vm_restore_frame (page, frame, dirty);
+		return false;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		if (cluster[i] == page) {
+			frames[i] = frame;
+			continue;
+		}
+		frames[i] = cluster[i]->frame;
+		vm_unmap_frame (frames[i]);
+	}
+	if (cnt == 1)
+		disk_write_multiple (swap_disk, first * SLOT_SECTORS,
+				frames[0]->kva, SLOT_SECTORS);
+	else {
+		lock_acquire (&cluster_lock);
+		for (i = 0; i < cnt; i++)
+			memcpy ((uint8_t *) cluster_buf + i * PGSIZE, frames[i]->kva,
+					PGSIZE);
+		disk_write_multiple (swap_disk, first * SLOT_SECTORS, cluster_buf,
+				cnt * SLOT_SECTORS);
+		lock_release (&cluster_lock);
+	}
+	out_pages += cnt;
+	out_clusters++;
+
+	for (i = 0; i < cnt; i++) {
+		cluster[i]->anon.swap_slot = first + i;
+		/* The caller reuses PAGE's frame. */
+		if (cluster[i] != page)
+			vm_free_frame (frames[i]);
+	}
+	return true;
+}
+
+/* Reads the contents of PAGE, a private anonymous page that is swapped
+ * out, into the page at KVA.  PAGE stays swapped out. */
+void
+anon_swap_copy (struct page *page, void *kva) {
+	struct anon_page *anon_page = &page->anon;
+
+	ASSERT (anon_page->shm == NULL && page->frame == NULL);
+
+	if (anon_page->zswap != NULL)
+		zswap_copy (anon_page->zswap, kva);
+	else if (anon_page->swap_slot != BITMAP_ERROR)
+		swap_copy (anon_page->swap_slot, kva);
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	if (anon_page->shm != NULL)
+		shm_unmap_page (page);
+	else {
+		if (anon_page->swap_slot != BITMAP_ERROR)
+			swap_free (anon_page->swap_slot);
+		if (anon_page->zswap != NULL)
+			zswap_free (anon_page->zswap);
+		vm_release_frame (page);
+	}
 }
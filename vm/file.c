@@ -1,10 +1,23 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall-nr.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
+#include "vm/shm.h"
+#include "vm/vma.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
+static void flusher (void *aux);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
@@ -14,45 +27,492 @@ static const struct page_operations file_ops = {
 	.type = VM_FILE,
 };
 
+/* The text cache: frames holding executable text, shared by every process
+ * that runs the same executable.  A text page is identified by its file's
+ * inode, its offset in the file and the number of bytes read from there,
+ * since the rest of the page is zero.  An entry lives as long as some page
+ * maps its frame.  Every text page keeps writes to its file denied, so the
+ * cached contents cannot go stale. */
+struct text_frame {
+	struct hash_elem elem;      /* Element in text_frames. */
+	struct inode *inode;        /* Executable file. */
+	off_t ofs;                  /* Offset of the page in the file. */
+	size_t read_bytes;          /* Bytes of the page read from the file. */
+	struct frame *frame;        /* Frame holding the page. */
+};
+
+static struct hash text_frames;
+
+/* Protects text_frames and the sharing of the frames in it: pages start or
+ * stop mapping a cached frame only while holding this lock. */
+static struct lock text_lock;
+
+/* Write-back.  Dirty pages of a file mapping are written back when they
+ * are evicted or unmapped, by msync(), and by the flusher, a kernel thread
+ * that wakes up every flush_interval_ms and writes back whatever it finds
+ * dirty, so that little is left to write when a process unmaps or exits.
+ * Adjacent dirty pages are gathered into WRITEBACK_PAGES-page runs, copied
+ * into writeback_buf and written to the file together. */
+#define WRITEBACK_PAGES 16
+
+unsigned flush_interval_ms = 500;
+
+static uint8_t *writeback_buf;
+static struct lock writeback_lock;  /* Protects writeback_buf. */
+
+/* Statistics. */
+static long long writeback_cnt;     /* Pages written back in runs. */
+static long long run_cnt;           /* Runs written. */
+static long long flush_cnt;         /* Pages written back by the flusher. */
+
+static uint64_t
+text_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct text_frame *t = hash_entry (e, struct text_frame, elem);
+	return hash_bytes (&t->inode, sizeof t->inode)
+		^ hash_int (t->ofs) ^ hash_int (t->read_bytes);
+}
+
+static bool
+text_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct text_frame *a = hash_entry (a_, struct text_frame, elem);
+	const struct text_frame *b = hash_entry (b_, struct text_frame, elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	if (a->ofs != b->ofs)
+		return a->ofs < b->ofs;
+	return a->read_bytes < b->read_bytes;
+}
+
+/* Returns the text cache entry for PAGE, or a null pointer if there is none.
+ * The caller must hold text_lock. */
+static struct text_frame *
+text_find (struct page *page) {
+	struct text_frame key;
+	struct hash_elem *e;
+
+	ASSERT (lock_held_by_current_thread (&text_lock));
+
+	key.inode = file_get_inode (page->file.file);
+	key.ofs = page->file.ofs;
+	key.read_bytes = page->file.read_bytes;
+	e = hash_find (&text_frames, &key.elem);
+	return e != NULL ? hash_entry (e, struct text_frame, elem) : NULL;
+}
+
 /* The initializer of file vm */
 void
 vm_file_init (void) {
+	hash_init (&text_frames, text_hash, text_less, NULL);
+	lock_init (&text_lock);
+	writeback_buf = palloc_get_multiple (PAL_ASSERT, WRITEBACK_PAGES);
+	lock_init (&writeback_lock);
+	if (flush_interval_ms > 0)
+		thread_create ("flusher", PRI_DEFAULT, flusher, NULL);
+}
+
+/* Prints write-back statistics. */
+void
+file_print_stats (void) {
+	printf ("Write-back: %lld pages in %lld runs, %lld by the flusher\n",
+			writeback_cnt, run_cnt, flush_cnt);
 }
 
 /* Initialize the file backed page */
 bool
-file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+file_backed_initializer (struct page *page, enum vm_type type, void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &file_ops;
 
+	/* The backing file is filled in by file_lazy_load(). */
+	page->file = (struct file_page) {
+		.shared = (type & VM_MARKER_1) != 0,
+	};
+	return true;
+}
+
+/* Lazy loader of file backed pages.  AUX is a struct lazy_load_arg, whose
+ * file becomes the page's backing file. */
+bool
+file_lazy_load (struct page *page, void *aux) {
+	struct lazy_load_arg *arg = aux;
 	struct file_page *file_page = &page->file;
+
+	file_page->file = arg->file;
+	file_page->ofs = arg->ofs;
+	file_page->read_bytes = arg->read_bytes;
+	free (arg);
+
+	return file_backed_swap_in (page, page->frame->kva);
+}
+
+/* Returns true if the not yet loaded page whose lazy loader takes ARG
+ * has its contents in the text cache already. */
+bool
+file_is_cached (const struct lazy_load_arg *arg) {
+	struct text_frame key;
+	bool cached;
+
+	key.inode = file_get_inode (arg->file);
+	key.ofs = arg->ofs;
+	key.read_bytes = arg->read_bytes;
+	lock_acquire (&text_lock);
+	cached = hash_find (&text_frames, &key.elem) != NULL;
+	lock_release (&text_lock);
+	return cached;
+}
+
+/* Reads the contents of FILE_PAGE into KVA. */
+static bool
+file_read_page (struct file_page *file_page, void *kva) {
+	if (file_read_at (file_page->file, kva, file_page->read_bytes,
+				file_page->ofs) != (int) file_page->read_bytes)
+		return false;
+	memset (kva + file_page->read_bytes, 0, PGSIZE - file_page->read_bytes);
+	return true;
+}
+
+/* Swaps in the text page PAGE.  If another process already has the page in
+ * the text cache, PAGE switches over to that frame and the fresh one at KVA
+ * is given back; otherwise the page is read into KVA and its frame cached. */
+static bool
+text_swap_in (struct page *page, void *kva) {
+	struct text_frame *t;
+	bool success = true;
+
+	lock_acquire (&text_lock);
+	t = text_find (page);
+	if (t == NULL) {
+		/* Do not hold the lock across the disk read. */
+		lock_release (&text_lock);
+		if (!file_read_page (&page->file, kva))
+			return false;
+		lock_acquire (&text_lock);
+
+		/* Somebody may have loaded the same page meanwhile. */
+		t = text_find (page);
+		if (t == NULL) {
+			t = malloc (sizeof *t);
+			if (t != NULL) {
+				t->inode = file_get_inode (page->file.file);
+				t->ofs = page->file.ofs;
+				t->read_bytes = page->file.read_bytes;
+				t->frame = page->frame;
+				hash_insert (&text_frames, &t->elem);
+			}
+			lock_release (&text_lock);
+			return true;
+		}
+	}
+
+	if (t->frame != page->frame)
+		success = vm_remap_frame (page, t->frame);
+	lock_release (&text_lock);
+	return success;
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	if (file_page->shared)
+		return text_swap_in (page, kva);
+	return file_read_page (file_page, kva);
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.  Text never
+ * changes, so the frame is simply dropped from the text cache, unless
+ * another process has started sharing it meanwhile.  A dirty page is
+ * unmapped before it is written, so that nothing its process stores
+ * meanwhile is lost. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	struct frame *frame = page->frame;
+	bool dirty;
+
+	if (file_page->shared) {
+		struct text_frame *t;
+
+		lock_acquire (&text_lock);
+		if (frame->ref_cnt != 1) {
+			lock_release (&text_lock);
+			return false;
+		}
+		t = text_find (page);
+		if (t != NULL && t->frame == frame) {
+			hash_delete (&text_frames, &t->elem);
+			free (t);
+		}
+		vm_unmap_frame (frame);
+		lock_release (&text_lock);
+		return true;
+	}
+
+	ASSERT (frame->ref_cnt == 1);
+	dirty = pml4_is_dirty (page->owner->pml4, page->va);
+	vm_unmap_frame (frame);
+	if (dirty && file_write_at (file_page->file, frame->kva,
+				file_page->read_bytes, file_page->ofs)
+			!= (int) file_page->read_bytes) {
+		vm_restore_frame (page, frame, true);
+		return false;
+	}
+	return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	struct frame *frame = page->frame;
+
+	if (file_page->shared) {
+		/* The last page mapping a cached frame takes it out of the text
+		 * cache.  Pages of other processes can only join while we hold
+		 * text_lock, except in fork, whose parent keeps the frame busy. */
+		lock_acquire (&text_lock);
+		if (frame != NULL && frame->ref_cnt == 1) {
+			struct text_frame *t = text_find (page);
+			if (t != NULL && t->frame == frame) {
+				hash_delete (&text_frames, &t->elem);
+				free (t);
+			}
+		}
+		vm_release_frame (page);
+		lock_release (&text_lock);
+	} else {
+		if (frame != NULL
+				&& pml4_is_dirty (thread_current ()->pml4, page->va))
+			file_write_at (file_page->file, frame->kva,
+					file_page->read_bytes, file_page->ofs);
+		vm_release_frame (page);
+	}
+	file_close (file_page->file);
 }
 
-/* Do the mmap */
+/* Do the mmap.  A shared-memory segment is mapped shared: every process
+ * that maps it sees the others' writes.  A regular file is mapped with
+ * dirty pages written back to it when they are unmapped, and what lies
+ * past its end reads as zeros.  The mapping is one VMA, whose pages are
+ * set up as they are touched, unless MAP_POPULATE in WRITABLE asks for
+ * all of them right away.
+ * Returns ADDR, or a null pointer on failure. */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	struct shm *shm = file_get_shm (file);
+	bool populate = (writable & MAP_POPULATE) != 0;
+	size_t page_cnt, read_bytes;
+	struct vma *vma;
+	bool writer;
+
+	writable &= ~MAP_POPULATE;
+	if (addr == NULL || pg_ofs (addr) != 0 || offset < 0
+			|| pg_ofs (offset) != 0 || length == 0
+			|| file_get_pipe (file, &writer) != NULL)
+		return NULL;
+	if (shm == NULL && file_length (file) == 0)
+		return NULL;
+
+	page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	if (!is_user_vaddr (addr) || page_cnt > (KERN_BASE - (uint64_t) addr)
+			/ PGSIZE)
+		return NULL;
+	if (shm != NULL) {
+		size_t first = offset / PGSIZE, shm_pages = shm_size (shm) / PGSIZE;
+
+		if (first > shm_pages || page_cnt > shm_pages - first)
+			return NULL;
+		read_bytes = 0;
+	} else
+		read_bytes = offset >= file_length (file) ? 0
+			: (size_t) (file_length (file) - offset) < length
+			? (size_t) (file_length (file) - offset) : length;
+
+	lock_acquire (&spt->lock);
+	vma = vma_map (addr, page_cnt, VM_FILE, writable, file_lazy_load, file,
+			offset, read_bytes);
+	if (vma != NULL) {
+		vma->mmapped = true;
+		vma->ra.next = addr;    /* Reading from the start is sequential. */
+		if (populate)
+			vm_populate (addr, page_cnt);
+	}
+	lock_release (&spt->lock);
+	return vma != NULL ? addr : NULL;
 }
 
-/* Do the munmap */
+/* Do the munmap.  The dirty pages are written back in order first, so
+ * that adjacent ones go to the file together. */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	struct vma *vma;
+
+	lock_acquire (&spt->lock);
+	vma = vma_find (spt, addr);
+	if (vma != NULL && vma->mmapped && vma->start == (uint8_t *) addr) {
+		file_sync (spt, vma->start, vma->end);
+		vma_unmap (spt, vma);
+	}
+	lock_release (&spt->lock);
+}
+
+/* Returns true if PAGE is a page of a file mapping with data from the
+ * file that has been written to since it was last written back. */
+static bool
+needs_writeback (struct page *page) {
+	return page != NULL && page->operations == &file_ops
+		&& !page->file.shared && page->frame != NULL
+		&& page->file.read_bytes > 0
+		&& pml4_is_dirty (page->owner->pml4, page->va);
+}
+
+/* Writes back the CNT pages in RUN, adjacent pages of one file mapping in
+ * order of address, with a single write to the file.  The page table lock
+ * of their process must be held.  A page is marked clean before it is
+ * copied out, so that a write to it meanwhile leaves it dirty. */
+static void
+write_run (struct page **run, size_t cnt) {
+	struct file_page *first = &run[0]->file;
+	size_t bytes = (cnt - 1) * PGSIZE + run[cnt - 1]->file.read_bytes;
+	size_t i;
+	bool success;
+
+	ASSERT (cnt > 0 && cnt <= WRITEBACK_PAGES);
+	ASSERT (lock_held_by_current_thread (&run[0]->owner->spt.lock));
+
+	for (i = 0; i < cnt; i++)
+		pml4_set_dirty (run[i]->owner->pml4, run[i]->va, false);
+	if (cnt == 1)
+		success = file_write_at (first->file, run[0]->frame->kva, bytes,
+				first->ofs) == (int) bytes;
+	else {
+		lock_acquire (&writeback_lock);
+		for (i = 0; i < cnt; i++)
+			memcpy (writeback_buf + i * PGSIZE, run[i]->frame->kva,
+					run[i]->file.read_bytes);
+		success = file_write_at (first->file, writeback_buf, bytes,
+				first->ofs) == (int) bytes;
+		lock_release (&writeback_lock);
+	}
+
+	if (!success) {
+		for (i = 0; i < cnt; i++)
+			pml4_set_dirty (run[i]->owner->pml4, run[i]->va, true);
+		return;
+	}
+	writeback_cnt += cnt;
+	run_cnt++;
+}
+
+/* Writes back the dirty pages of SPT's file mappings from START up to END,
+ * in order of address, a run of adjacent ones at a time.  Only the part of
+ * a mapping that lies within its file can be dirty, so a large mapping of
+ * a small file is cheap to go through.  SPT's lock must be held.  Returns
+ * the number of pages written back. */
+size_t
+file_sync (struct supplemental_page_table *spt, void *start_, void *end_) {
+	uint8_t *start = start_, *end = end_;
+	size_t written = 0;
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&spt->lock));
+
+	for (i = 0; i < spt->vma_cnt; i++) {
+		struct vma *vma = spt->vmas[i];
+		struct page *run[WRITEBACK_PAGES];
+		size_t cnt = 0;
+		uint8_t *va, *hi;
+
+		if (!vma->mmapped || vma->end <= start || vma->start >= end)
+			continue;
+		hi = vma->start + ROUND_UP (vma->read_bytes, PGSIZE);
+		if (hi > end)
+			hi = end;
+		for (va = vma->start > start ? vma->start : start; va < hi;
+				va += PGSIZE) {
+			struct page *page = spt_find_page (spt, va);
+
+			if (needs_writeback (page))
+				run[cnt++] = page;
+			if (cnt > 0 && (cnt == WRITEBACK_PAGES || run[cnt - 1] != page)) {
+				write_run (run, cnt);
+				written += cnt;
+				cnt = 0;
+			}
+		}
+		if (cnt > 0) {
+			write_run (run, cnt);
+			written += cnt;
+		}
+	}
+	return written;
+}
+
+/* Do the msync.  With MS_SYNC, writes back the dirty pages of the file
+ * mappings from ADDR for LENGTH bytes before returning.  With MS_ASYNC,
+ * returns at once and leaves them to the flusher, as Linux does, except
+ * that with the flusher off (flush_interval_ms of 0) nothing else would
+ * write them before eviction or munmap, so MS_ASYNC acts as MS_SYNC.
+ * Returns 0, or -1 if ADDR is not page-aligned, part of the range is not
+ * mapped, or FLAGS is not one of the two. */
+int
+do_msync (void *addr, size_t length, int flags) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	uint8_t *start = addr, *end, *va;
+	size_t i;
+	int result = 0;
+
+	if (pg_ofs (addr) != 0 || (flags != MS_ASYNC && flags != MS_SYNC)
+			|| !is_user_vaddr (addr)
+			|| length > KERN_BASE - (uint64_t) addr)
+		return -1;
+	end = pg_round_up (start + length);
+
+	lock_acquire (&spt->lock);
+	/* The VMAs must cover the whole range. */
+	for (i = 0, va = start; i < spt->vma_cnt && va < end; i++)
+		if (spt->vmas[i]->end > va) {
+			if (spt->vmas[i]->start > va)
+				break;
+			va = spt->vmas[i]->end;
+		}
+	if (va < end)
+		result = -1;
+	else if (flags == MS_SYNC || flush_interval_ms == 0)
+		file_sync (spt, start, end);
+	lock_release (&spt->lock);
+	return result;
+}
+
+/* The flusher: every flush_interval_ms, makes one pass over the frame
+ * table and writes back the dirty file pages it finds, each together
+ * with the dirty pages around it, forever.  Pages of processes that are
+ * busy with their page table are left for the next pass. */
+static void
+flusher (void *aux UNUSED) {
+	for (;;) {
+		bool last;
+
+		timer_msleep (flush_interval_ms);
+		do {
+			struct page *page = vm_scan_dirty (&last);
+			struct supplemental_page_table *spt;
+			uint8_t *block;
+
+			if (page == NULL)
+				continue;
+			spt = &page->owner->spt;
+			block = (uint8_t *) ROUND_DOWN ((uint64_t) page->va,
+					WRITEBACK_PAGES * PGSIZE);
+			flush_cnt += file_sync (spt, block,
+					block + WRITEBACK_PAGES * PGSIZE);
+			lock_release (&spt->lock);
+		} while (!last);
+	}
 }
@@ -0,0 +1,232 @@
+/* ksm.c: Same-page merging.
+ *
+ * Processes running the same program often hold many anonymous pages with
+ * the same contents, each in a frame of its own.  The merge daemon, a
+ * kernel thread at the lowest priority, scans the frame table a few pages
+ * at a time and makes identical private anonymous pages share one
+ * read-only frame.  A write to a merged page takes a private copy in the
+ * write-protect fault path, just as after fork.
+ *
+ * Pages are found by a checksum of their contents.  Merged frames are
+ * kept in the stable table.  The unstable table holds one frame per
+ * checksum of pages not merged yet, to be merged with the next page found
+ * to match.  Their contents may change at any time, so a page only goes
+ * into the unstable table once its checksum has held still for a whole
+ * scan, and every merge compares the contents again after write-protecting
+ * both pages. */
+
+#include "vm/ksm.h"
+#include <hash.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+/* Where a frame's node is. */
+enum ksm_state {
+	KSM_NONE,                   /* In no table. */
+	KSM_UNSTABLE,               /* In unstable. */
+	KSM_STABLE                  /* In stable: the frame is merged. */
+};
+
+/* What the merge daemon knows about a frame it has scanned. */
+struct ksm_node {
+	struct hash_elem elem;      /* Element in stable or unstable. */
+	struct frame *frame;        /* The frame. */
+	uint64_t checksum;          /* Checksum at the last scan. */
+	enum ksm_state state;
+};
+
+size_t ksm_pages_to_scan = 0;
+unsigned ksm_sleep_ms = 20;
+
+/* Tables of frames by checksum, at most one frame per checksum each. */
+static struct hash stable;
+static struct hash unstable;
+
+/* Protects the tables and the nodes.  A frame's node only goes away in
+ * ksm_forget(), under this lock, so a frame found in a table stays
+ * allocated while the lock is held. */
+static struct lock ksm_lock;
+
+/* Statistics. */
+static long long scan_cnt;          /* Pages scanned. */
+static long long merge_cnt;         /* Pages merged. */
+static long long full_scans;        /* Passes over the frame table. */
+
+static void ksmd (void *aux);
+
+static uint64_t
+node_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry (e, struct ksm_node, elem)->checksum;
+}
+
+static bool
+node_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct ksm_node, elem)->checksum
+		< hash_entry (b, struct ksm_node, elem)->checksum;
+}
+
+/* Initializes same-page merging and starts the merge daemon, if it is to
+ * run at all. */
+void
+ksm_init (void) {
+	hash_init (&stable, node_hash, node_less, NULL);
+	hash_init (&unstable, node_hash, node_less, NULL);
+	lock_init (&ksm_lock);
+	if (ksm_pages_to_scan > 0)
+		thread_create ("ksmd", PRI_MIN, ksmd, NULL);
+}
+
+/* Prints same-page merging statistics. */
+void
+ksm_print_stats (void) {
+	struct hash_iterator i;
+	long long shared = 0, sharing = 0;
+
+	lock_acquire (&ksm_lock);
+	hash_first (&i, &stable);
+	while (hash_next (&i)) {
+		struct ksm_node *node = hash_entry (hash_cur (&i), struct ksm_node,
+				elem);
+		shared++;
+		sharing += node->frame->ref_cnt;
+	}
+	lock_release (&ksm_lock);
+
+	printf ("Page merging: %lld frames shared by %lld pages, "
+			"%lld merges, %lld pages scanned in %lld passes\n",
+			shared, sharing, merge_cnt, scan_cnt, full_scans);
+}
+
+/* Returns TABLE's node with CHECKSUM, or a null pointer. */
+static struct ksm_node *
+table_find (struct hash *table, uint64_t checksum) {
+	struct ksm_node key;
+	struct hash_elem *e;
+
+	key.checksum = checksum;
+	e = hash_find (table, &key.elem);
+	return e != NULL ? hash_entry (e, struct ksm_node, elem) : NULL;
+}
+
+/* Takes NODE out of whichever table it is in. */
+static void
+node_remove (struct ksm_node *node) {
+	if (node->state != KSM_NONE)
+		hash_delete (node->state == KSM_STABLE ? &stable : &unstable,
+				&node->elem);
+	node->state = KSM_NONE;
+}
+
+/* Puts NODE in TABLE, which is STATE, unless TABLE has a node with the
+ * same checksum already. */
+static void
+node_insert (struct ksm_node *node, struct hash *table,
+		enum ksm_state state) {
+	node_remove (node);
+	if (hash_insert (table, &node->elem) == NULL)
+		node->state = state;
+}
+
+/* Forgets everything about FRAME, which is about to be freed or reused. */
+void
+ksm_forget (struct frame *frame) {
+	/* The merge daemon frees frames itself as it merges. */
+	bool held = lock_held_by_current_thread (&ksm_lock);
+
+	if (!held)
+		lock_acquire (&ksm_lock);
+	if (frame->ksm != NULL) {
+		node_remove (frame->ksm);
+		free (frame->ksm);
+		frame->ksm = NULL;
+	}
+	frame->merged = false;
+	if (!held)
+		lock_release (&ksm_lock);
+}
+
+/* Merges PAGE, whose process's page table lock the caller holds, with an
+ * identical page if there is one. */
+static void
+ksm_merge (struct page *page) {
+	struct frame *frame = page->frame;
+	struct ksm_node *node = frame->ksm, *other;
+	uint64_t checksum = hash_bytes (frame->kva, PGSIZE);
+	struct page *other_page;
+	bool acquired;
+
+	scan_cnt++;
+
+	/* Join a merged frame with the same contents. */
+	other = table_find (&stable, checksum);
+	if (other != NULL && vm_merge_page (page, other->frame)) {
+		merge_cnt++;
+		return;
+	}
+
+	/* Wait for the contents to hold still over a whole scan. */
+	if (node == NULL) {
+		node = malloc (sizeof *node);
+		if (node == NULL)
+			return;
+		node->frame = frame;
+		node->checksum = checksum;
+		node->state = KSM_NONE;
+		frame->ksm = node;
+		return;
+	}
+	if (node->checksum != checksum) {
+		node_remove (node);
+		node->checksum = checksum;
+		return;
+	}
+
+	other = table_find (&unstable, checksum);
+	if (other == NULL || other == node) {
+		node_insert (node, &unstable, KSM_UNSTABLE);
+		return;
+	}
+
+	/* Merge with the page in the unstable table, whose frame becomes a
+	 * merged frame.  If it no longer matches, this page takes its place. */
+	other_page = vm_lock_frame (other->frame, &acquired);
+	if (other_page == NULL)
+		return;
+	if (vm_merge_page (page, other->frame)) {
+		node_insert (other, &stable, KSM_STABLE);
+		merge_cnt++;
+	} else
+		node_insert (node, &unstable, KSM_UNSTABLE);
+	if (acquired)
+		lock_release (&other_page->owner->spt.lock);
+}
+
+/* The merge daemon: scans ksm_pages_to_scan frames, then sleeps for
+ * ksm_sleep_ms, forever. */
+static void
+ksmd (void *aux UNUSED) {
+	for (;;) {
+		size_t i;
+
+		for (i = 0; i < ksm_pages_to_scan; i++) {
+			bool wrapped;
+			struct page *page = vm_scan_page (&wrapped);
+
+			if (wrapped)
+				full_scans++;
+			if (page == NULL)
+				continue;
+			lock_acquire (&ksm_lock);
+			ksm_merge (page);
+			lock_release (&ksm_lock);
+			lock_release (&page->owner->spt.lock);
+		}
+		timer_msleep (ksm_sleep_ms);
+	}
+}
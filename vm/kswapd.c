@@ -0,0 +1,91 @@
+/* kswapd.c: Background page-out.
+ *
+ * Without help, a process that faults with user memory full must evict a
+ * page itself and wait for it to be written out before it can go on.  The
+ * page-out daemon, a kernel thread, wakes up when fewer than kswapd_low
+ * user pages are free and evicts pages in batches until kswapd_high pages
+ * are free again, so that most faults find a free frame at once.  Faults
+ * still evict directly when the daemon falls behind. */
+
+#include "vm/kswapd.h"
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+/* Pages evicted between looks at the free page count. */
+#define KSWAPD_BATCH 16
+
+size_t kswapd_low = 0;
+size_t kswapd_high = 0;
+
+/* Upped to wake the daemon. */
+static struct semaphore kswapd_sema;
+
+/* True from the time the daemon is woken until it goes back to sleep. */
+static bool kswapd_awake;
+
+/* Statistics. */
+static long long wake_cnt;          /* Times woken. */
+static long long reclaim_cnt;       /* Pages evicted. */
+
+static void kswapd (void *aux);
+
+/* Initializes background page-out and starts the page-out daemon, if it is
+ * to run at all.  The daemon runs just above the priority of user
+ * processes, so that it gets to work as soon as it is woken, and gives way
+ * to them whenever it waits for the disk. */
+void
+kswapd_init (void) {
+	sema_init (&kswapd_sema, 0);
+	if (kswapd_low == 0)
+		return;
+	if (kswapd_high <= kswapd_low)
+		kswapd_high = 2 * kswapd_low;
+	kswapd_awake = true;
+	thread_create ("kswapd", PRI_DEFAULT + 1, kswapd, NULL);
+}
+
+/* Wakes the page-out daemon if fewer than kswapd_low user pages are
+ * free. */
+void
+kswapd_check (void) {
+	if (kswapd_low == 0 || kswapd_awake
+			|| palloc_count_free (PAL_USER) >= kswapd_low)
+		return;
+	kswapd_awake = true;
+	wake_cnt++;
+	sema_up (&kswapd_sema);
+}
+
+/* Prints background page-out statistics. */
+void
+kswapd_print_stats (void) {
+	printf ("Page-out daemon: %lld wakeups, %lld pages evicted\n",
+			wake_cnt, reclaim_cnt);
+}
+
+/* The page-out daemon: sleeps until woken, then evicts pages until
+ * kswapd_high pages are free or no page can be evicted, forever. */
+static void
+kswapd (void *aux UNUSED) {
+	for (;;) {
+		bool progress = true;
+
+		kswapd_awake = false;
+		sema_down (&kswapd_sema);
+
+		while (progress && palloc_count_free (PAL_USER) < kswapd_high) {
+			size_t i;
+
+			progress = false;
+			for (i = 0; i < KSWAPD_BATCH; i++) {
+				if (!vm_reclaim_frame ())
+					break;
+				reclaim_cnt++;
+				progress = true;
+			}
+		}
+	}
+}
@@ -0,0 +1,275 @@
+/* shm.c: Named shared-memory segments.
+ *
+ * A segment is a run of anonymous pages that any number of processes map
+ * at once, through mmap() of a file descriptor from shm_open().  Unlike a
+ * private anonymous page, whose frame belongs to the pages mapping it, the
+ * frames of a segment belong to the segment: a page of a segment is an
+ * anon page that only borrows its frame, so the contents survive while no
+ * process maps them, and every process sees the same frame.  A page of a
+ * segment that is swapped out is swapped out for everybody at once.
+ *
+ * A segment lives as long as it has a name or a reference.  References
+ * are held by the open files for it and by the pages that map it. */
+
+#include "vm/shm.h"
+#include <bitmap.h>
+#include <list.h>
+#include <round.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+/* One page of a segment. */
+struct shm_slot {
+	struct frame *frame;        /* Frame holding the page, or null. */
+	size_t swap_slot;           /* Swap slot holding the page while it is
+	                               swapped out, or BITMAP_ERROR. */
+	bool loading;               /* Being read from SWAP_SLOT? */
+};
+
+/* A shared-memory segment. */
+struct shm {
+	char name[SHM_NAME_MAX + 1];    /* Name, while not unlinked. */
+	size_t page_cnt;                /* Number of pages. */
+	struct shm_slot *slots;         /* Its pages. */
+	int ref_cnt;                    /* Open files plus mapped pages. */
+	bool unlinked;                  /* Removed by shm_remove()? */
+	struct list_elem elem;          /* Element in shms while named. */
+};
+
+/* Segments that have a name. */
+static struct list shms;
+
+/* Protects shms and every segment. */
+static struct lock shm_lock;
+
+/* Signaled when a page has been read from swap. */
+static struct condition shm_loaded;
+
+/* Initializes the shared-memory segments. */
+void
+shm_init (void) {
+	list_init (&shms);
+	lock_init (&shm_lock);
+	cond_init (&shm_loaded);
+}
+
+/* Returns the segment named NAME, or a null pointer if there is none.
+ * The caller must hold shm_lock. */
+static struct shm *
+shm_find (const char *name) {
+	struct list_elem *e;
+
+	ASSERT (lock_held_by_current_thread (&shm_lock));
+
+	for (e = list_begin (&shms); e != list_end (&shms); e = list_next (e)) {
+		struct shm *shm = list_entry (e, struct shm, elem);
+		if (!strcmp (shm->name, name))
+			return shm;
+	}
+	return NULL;
+}
+
+/* Frees SHM, whose last reference is gone and which has no name any more,
+ * together with its frames and swap slots. */
+static void
+shm_free (struct shm *shm) {
+	size_t i;
+
+	for (i = 0; i < shm->page_cnt; i++) {
+		struct shm_slot *slot = &shm->slots[i];
+
+		if (slot->frame != NULL)
+			vm_free_frame (slot->frame);
+		if (slot->swap_slot != BITMAP_ERROR)
+			swap_free (slot->swap_slot);
+	}
+	free (shm->slots);
+	free (shm);
+}
+
+/* Returns a new reference to the segment named NAME.  If there is no such
+ * segment and SIZE is nonzero, creates one of SIZE bytes, rounded up to
+ * whole pages, which reads as zeros.  Returns a null pointer if the name
+ * is too long, if there is no segment and SIZE is 0, or if an allocation
+ * fails. */
+struct shm *
+shm_lookup (const char *name, size_t size) {
+	struct shm *shm;
+	size_t i;
+
+	if (strlen (name) > SHM_NAME_MAX)
+		return NULL;
+
+	lock_acquire (&shm_lock);
+	shm = shm_find (name);
+	if (shm != NULL)
+		shm->ref_cnt++;
+	else if (size > 0 && (shm = calloc (1, sizeof *shm)) != NULL) {
+		strlcpy (shm->name, name, sizeof shm->name);
+		shm->page_cnt = DIV_ROUND_UP (size, PGSIZE);
+		shm->slots = calloc (shm->page_cnt, sizeof *shm->slots);
+		if (shm->slots != NULL) {
+			for (i = 0; i < shm->page_cnt; i++)
+				shm->slots[i].swap_slot = BITMAP_ERROR;
+			shm->ref_cnt = 1;
+			list_push_back (&shms, &shm->elem);
+		} else {
+			free (shm);
+			shm = NULL;
+		}
+	}
+	lock_release (&shm_lock);
+	return shm;
+}
+
+/* Removes the name NAME.  The segment goes away once its last reference
+ * is dropped; a later shm_lookup() of NAME creates a new one.  Returns
+ * false if there is no segment named NAME. */
+bool
+shm_remove (const char *name) {
+	struct shm *shm;
+
+	lock_acquire (&shm_lock);
+	shm = shm_find (name);
+	if (shm != NULL) {
+		list_remove (&shm->elem);
+		shm->unlinked = true;
+		if (shm->ref_cnt == 0)
+			shm_free (shm);
+	}
+	lock_release (&shm_lock);
+	return shm != NULL;
+}
+
+/* Adds a reference to SHM. */
+void
+shm_get (struct shm *shm) {
+	lock_acquire (&shm_lock);
+	shm->ref_cnt++;
+	lock_release (&shm_lock);
+}
+
+/* Drops a reference to SHM, freeing it if that was the last one and it
+ * has been unlinked. */
+void
+shm_put (struct shm *shm) {
+	lock_acquire (&shm_lock);
+	ASSERT (shm->ref_cnt > 0);
+	if (--shm->ref_cnt == 0 && shm->unlinked)
+		shm_free (shm);
+	lock_release (&shm_lock);
+}
+
+/* Returns the size of SHM in bytes. */
+size_t
+shm_size (struct shm *shm) {
+	return shm->page_cnt * PGSIZE;
+}
+
+/* Makes PAGE, an uninit page of the current process, page IDX of SHM.
+ * The page gets its frame on the first fault.  Returns false if SHM has
+ * no page IDX. */
+bool
+shm_attach (struct page *page, struct shm *shm, size_t idx) {
+	if (page == NULL || idx >= shm->page_cnt)
+		return false;
+	anon_initializer (page, VM_ANON, NULL);
+	page->anon.shm = shm;
+	page->anon.shm_idx = idx;
+	shm_get (shm);
+	return true;
+}
+
+/* Maps the segment page SRC of the parent into the current process, at the
+ * same address.  Both processes go on sharing it. */
+bool
+shm_copy_page (struct page *src) {
+	struct shm *shm = src->anon.shm;
+	struct shm_slot *slot = &shm->slots[src->anon.shm_idx];
+	struct page *page;
+	bool success = true;
+
+	if (!vm_alloc_page (VM_ANON, src->va, src->writable))
+		return false;
+	page = spt_find_page (&thread_current ()->proc->spt, src->va);
+	if (!shm_attach (page, shm, src->anon.shm_idx))
+		return false;
+
+	/* Map it right away if resident, saving the child a fault. */
+	lock_acquire (&shm_lock);
+	if (slot->frame != NULL)
+		success = vm_map_frame (page, slot->frame);
+	lock_release (&shm_lock);
+	return success;
+}
+
+/* Swaps in the segment page PAGE, which has just got the fresh frame KVA.
+ * If the segment holds the page in a frame already, PAGE switches over to
+ * that one; otherwise the fresh frame becomes the segment's.  The page is
+ * read from swap without shm_lock held, marked as loading so that other
+ * processes faulting on it meanwhile wait for the read. */
+bool
+shm_swap_in (struct page *page, void *kva) {
+	struct shm_slot *slot = &page->anon.shm->slots[page->anon.shm_idx];
+	bool success = true;
+
+	lock_acquire (&shm_lock);
+	while (slot->loading)
+		cond_wait (&shm_loaded, &shm_lock);
+	if (slot->frame != NULL)
+		success = vm_remap_frame (page, slot->frame);
+	else {
+		if (slot->swap_slot != BITMAP_ERROR) {
+			slot->loading = true;
+			lock_release (&shm_lock);
+			swap_read (slot->swap_slot, kva);
+			lock_acquire (&shm_lock);
+			slot->swap_slot = BITMAP_ERROR;
+			slot->loading = false;
+			cond_broadcast (&shm_loaded, &shm_lock);
+		}
+		slot->frame = page->frame;
+	}
+	lock_release (&shm_lock);
+	return success;
+}
+
+/* Swaps out the segment page PAGE for every process that maps it.  The
+ * page is unmapped everywhere before it is written, so that no process
+ * can store to it meanwhile: their faults wait in shm_swap_in() for
+ * shm_lock.  If it cannot be written, the segment keeps the frame and the
+ * processes map it again on their next access. */
+bool
+shm_swap_out (struct page *page) {
+	struct shm_slot *slot = &page->anon.shm->slots[page->anon.shm_idx];
+	struct frame *frame = page->frame;
+
+	lock_acquire (&shm_lock);
+	ASSERT (slot->frame == frame);
+	vm_unmap_frame (frame);
+	slot->swap_slot = swap_write (frame->kva);
+	if (slot->swap_slot == BITMAP_ERROR) {
+		lock_release (&shm_lock);
+		return false;
+	}
+	slot->frame = NULL;
+	lock_release (&shm_lock);
+	return true;
+}
+
+/* Unmaps the segment page PAGE from the current process.  The segment
+ * keeps the frame. */
+void
+shm_unmap_page (struct page *page) {
+	struct shm *shm = page->anon.shm;
+
+	lock_acquire (&shm_lock);
+	if (page->frame != NULL)
+		vm_unlink_frame (page);
+	lock_release (&shm_lock);
+	shm_put (shm);
+}
@@ -1,5 +1,10 @@
 vm_SRC = vm/vm.c          # Main api proxy
 vm_SRC += vm/uninit.c     # Uninitialized page
 vm_SRC += vm/anon.c       # Anonymous page
+vm_SRC += vm/zswap.c      # Compressed swap pool
 vm_SRC += vm/file.c       # File mapped page
+vm_SRC += vm/vma.c        # Virtual memory areas
+vm_SRC += vm/shm.c        # Shared-memory segments
+vm_SRC += vm/ksm.c        # Same-page merging
+vm_SRC += vm/kswapd.c     # Page-out daemon
 vm_SRC += vm/inspect.c    # Testing utility
@@ -1,8 +1,67 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall-nr.h>
+#include "intrinsic.h"
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "vm/ksm.h"
+#include "vm/kswapd.h"
+#include "vm/shm.h"
+#include "vm/vma.h"
+
+/* Protects the frame table and the sharing state (PAGES, REF_CNT,
+ * PINNED) of every frame. */
+static struct lock frame_lock;
+
+/* Frame table: every frame of user memory, in the order in which the
+ * clock hand sweeps them.  The hand points to the next frame to look at. */
+static struct list frame_table;
+static struct list_elem *clock_hand;
+
+/* Position of the merge daemon's scan over the frame table. */
+static struct list_elem *scan_hand;
+
+/* Position of the flusher's scan over the frame table. */
+static struct list_elem *flush_hand;
+
+/* The zero frame: one page of zeros that every anonymous page that has
+ * been read but never written maps read-only.  It is always pinned and
+ * never freed. */
+static struct frame *zero_frame;
+
+/* -evict: Page replacement policy. */
+enum evict_policy evict_policy = EVICT_CLOCK;
+
+/* Statistics. */
+static long long fault_cnt;         /* Page faults handled. */
+static long long major_cnt;         /* ...of which read from disk. */
+static long long evict_cnt;         /* Frames evicted. */
+static long long write_cnt;         /* ...of which written out first. */
+static long long direct_cnt;        /* ...of which for a faulting process. */
+static long long chance_cnt;        /* Frames spared as recently used. */
+static long long zero_cnt;          /* Pages mapped to the zero frame. */
+static long long ahead_cnt;         /* Pages read ahead of a fault. */
+static long long around_cnt;        /* Cached pages mapped around a fault. */
+
+/* Page faults of every process, by kind, with their latencies, and the
+ * lock that protects them. */
+static struct faultstat all_faults;
+static struct lock faultstat_lock;
+
+/* Names of the kinds of page fault. */
+static const char *fault_names[FAULT_KINDS] = {
+	"lazy file", "lazy anon", "zero-fill", "swap-in", "stack growth",
+	"write-protect", "resident", "invalid",
+};
+
+static struct frame *frame_new (void *kva);
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -15,7 +74,31 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	lock_init (&frame_lock);
+	lock_init (&faultstat_lock);
+	list_init (&frame_table);
+	clock_hand = scan_hand = flush_hand = list_end (&frame_table);
+	kswapd_init ();
+	zero_frame = frame_new (palloc_get_page (PAL_ASSERT | PAL_ZERO));
+	shm_init ();
+	ksm_init ();
+}
+
+/* Prints page fault and eviction statistics. */
+void
+vm_print_stats (void) {
+	printf ("VM (%s): %lld page faults (%lld major), %lld evictions "
+			"(%lld written out, %lld direct), %lld second chances, "
+			"%lld zero pages\n",
+			evict_policy == EVICT_CLOCK ? "clock" : "fifo",
+			fault_cnt, major_cnt, evict_cnt, write_cnt, direct_cnt, chance_cnt,
+			zero_cnt);
+	printf ("Fault-around: %lld pages read ahead, %lld cached pages mapped\n",
+			ahead_cnt, around_cnt);
+	swap_print_stats ();
+	ksm_print_stats ();
+	kswapd_print_stats ();
+	file_print_stats ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -33,28 +116,69 @@ page_get_type (struct page *page) {
 }
 
 /* Helpers */
-static struct frame *vm_get_victim (void);
+static struct frame *vm_get_victim (bool *acquired);
 static bool vm_do_claim_page (struct page *page);
+static bool vm_load_page (struct page *page, struct frame *frame);
 static struct frame *vm_evict_frame (void);
+static bool vm_claim_huge (struct supplemental_page_table *spt,
+		struct page *page);
+static void frame_link (struct frame *frame, struct page *page);
+static bool frame_unlink (struct frame *frame, struct page *page);
+static void frame_unpin (struct frame *frame);
+static bool frame_is_shared (struct frame *frame);
+static bool spt_new_page (struct supplemental_page_table *spt,
+		enum vm_type type, void *upage, bool writable, vm_initializer *init,
+		void *aux);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
- * `vm_alloc_page`. */
+ * `vm_alloc_page`.  Fails if UPAGE is in use, by a page or a VMA. */
 bool
 vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		vm_initializer *init, void *aux) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
 
-	ASSERT (VM_TYPE(type) != VM_UNINIT)
+	if (vma_find (spt, upage) != NULL)
+		return false;
+	return spt_new_page (spt, type, upage, writable, init, aux);
+}
 
-	struct supplemental_page_table *spt = &thread_current ()->spt;
+/* Like vm_alloc_page_with_initializer(), but also makes pages within
+ * VMAs, and takes the current process's SPT. */
+static bool
+spt_new_page (struct supplemental_page_table *spt, enum vm_type type,
+		void *upage, bool writable, vm_initializer *init, void *aux) {
+
+	ASSERT (VM_TYPE(type) != VM_UNINIT)
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+		struct page *page = malloc (sizeof *page);
+		if (page == NULL)
+			goto err;
 
-		/* TODO: Insert the page into the spt. */
+		bool (*initializer) (struct page *, enum vm_type, void *);
+		switch (VM_TYPE (type)) {
+			case VM_ANON:
+				initializer = anon_initializer;
+				break;
+			case VM_FILE:
+				initializer = file_backed_initializer;
+				break;
+			default:
+				free (page);
+				goto err;
+		}
+
+		uninit_new (page, pg_round_down (upage), init, type, aux, initializer);
+		page->writable = writable;
+		page->owner = thread_current ()->proc;
+
+		if (!spt_insert_page (spt, page)) {
+			free (page);
+			goto err;
+		}
+		return true;
 	}
 err:
 	return false;
@@ -62,82 +186,1158 @@ err:
 
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	struct page p;
+	struct hash_elem *e;
 
-	return page;
+	p.va = pg_round_down (va);
+	e = hash_find (&spt->pages, &p.spt_elem);
+	return e != NULL ? hash_entry (e, struct page, spt_elem) : NULL;
+}
+
+/* Returns the page at VA of SPT, the current process's, making it from
+ * its VMA if it has not been touched yet.  Returns a null pointer if VA
+ * is not in use or memory runs out. */
+static struct page *
+spt_get_page (struct supplemental_page_table *spt, void *va) {
+	struct page *page = spt_find_page (spt, va);
+	struct lazy_load_arg arg, *aux;
+	struct vma *vma;
+	struct shm *shm;
+
+	if (page != NULL || (vma = vma_find (spt, va)) == NULL)
+		return page;
+	va = pg_round_down (va);
+
+	shm = vma->file != NULL ? file_get_shm (vma->file) : NULL;
+	if (shm != NULL) {
+		if (!spt_new_page (spt, VM_ANON, va, vma->writable, NULL, NULL))
+			return NULL;
+		page = spt_find_page (spt, va);
+		if (!shm_attach (page, shm,
+					(vma->ofs + ((uint8_t *) va - vma->start)) / PGSIZE)) {
+			spt_remove_page (spt, page);
+			return NULL;
+		}
+		return page;
+	}
+
+	if (!vma_page_arg (vma, va, &arg)) {
+		if (!spt_new_page (spt, vma->type, va, vma->writable, NULL, NULL))
+			return NULL;
+		return spt_find_page (spt, va);
+	}
+
+	/* The page gets a file of its own, which it closes. */
+	aux = malloc (sizeof *aux);
+	if (aux == NULL)
+		return NULL;
+	*aux = arg;
+	aux->file = file_reopen (vma->file);
+	if (aux->file == NULL) {
+		free (aux);
+		return NULL;
+	}
+	if (vma->type & VM_MARKER_1)
+		file_deny_write (aux->file);
+	if (!spt_new_page (spt, vma->type, va, vma->writable, vma->init, aux)) {
+		file_close (aux->file);
+		free (aux);
+		return NULL;
+	}
+	return spt_find_page (spt, va);
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
-
-	return succ;
+spt_insert_page (struct supplemental_page_table *spt,
+		struct page *page) {
+	return hash_insert (&spt->pages, &page->spt_elem) == NULL;
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	hash_delete (&spt->pages, &page->spt_elem);
 	vm_dealloc_page (page);
+}
+
+/* Returns the frame under the clock hand and advances the hand, wrapping
+ * around at the end of the frame table.  The table must not be empty.
+ * The caller must hold frame_lock. */
+static struct frame *
+clock_advance (void) {
+	struct frame *frame;
+
+	if (clock_hand == list_end (&frame_table))
+		clock_hand = list_begin (&frame_table);
+	frame = list_entry (clock_hand, struct frame, elem);
+	clock_hand = list_next (clock_hand);
+	return frame;
+}
+
+/* Makes sure the current thread holds the supplemental page table lock of
+ * the process that FRAME's page belongs to, so that the page stays put
+ * while it is evicted.  A thread may evict from its own process if it
+ * holds the lock already, as in a page fault.  Other processes are
+ * skipped while busy, which also rules out deadlock.  Sets *ACQUIRED if
+ * the lock had to be acquired.  Returns false if the lock is not to be
+ * had. */
+static bool
+lock_owner (struct frame *frame, bool *acquired) {
+	struct thread *owner = frame->page->owner;
+	struct lock *lock = &owner->spt.lock;
+
+	*acquired = false;
+	if (lock_held_by_current_thread (lock))
+		return owner == thread_current ()->proc;
+	*acquired = lock_try_acquire (lock);
+	return *acquired;
+}
+
+/* Returns true if FRAME's page is worth keeping under the clock policy
+ * because it has been used since the hand last came by, clearing its
+ * accessed bit to give it a second chance. */
+static bool
+frame_recently_used (struct frame *frame) {
+	struct page *page = frame->page;
+
+	if (evict_policy != EVICT_CLOCK
+			|| !pml4_is_accessed (page->owner->pml4, page->va))
+		return false;
+	pml4_set_accessed (page->owner->pml4, page->va, false);
+	chance_cnt++;
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Returns true if evicting FRAME means writing its contents out first. */
+static bool
+frame_needs_write (struct frame *frame) {
+	struct page *page = frame->page;
+
+	return VM_TYPE (page->operations->type) != VM_FILE
+		|| pml4_is_dirty (page->owner->pml4, page->va);
+}
+
+/* Chooses a frame to evict, pins it and returns it, with the page table
+ * lock of its process held as lock_owner() describes, *ACQUIRED telling
+ * whether to release it.  Returns a null pointer if no frame qualifies.
+ *
+ * Only frames mapped by exactly one page are candidates: frames shared
+ * copy-on-write or as executable text are passed over, as are pinned
+ * frames and frames that no page maps.  Under the clock policy, the hand
+ * sweeps the frame table clearing accessed bits, and takes the first
+ * frame not used since the last sweep, preferring ones that can be
+ * dropped without writing them out.  Under FIFO, the hand takes the next
+ * candidate. */
 static struct frame *
-vm_get_victim (void) {
+vm_get_victim (bool *acquired) {
 	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+	bool victim_acquired = false;
+	size_t frame_cnt, i;
+
+	lock_acquire (&frame_lock);
+	frame_cnt = list_size (&frame_table);
+	for (i = 0; i < 2 * frame_cnt; i++) {
+		struct frame *frame;
+		bool frame_acquired;
 
+		/* After one sweep, settle for a frame that needs writing out. */
+		if (i == frame_cnt && victim != NULL)
+			break;
+
+		frame = clock_advance ();
+		if (frame->pinned || frame->ref_cnt != 1
+				|| frame_recently_used (frame)
+				|| (victim != NULL && frame_needs_write (frame))
+				|| !lock_owner (frame, &frame_acquired))
+			continue;
+
+		if (victim != NULL && victim_acquired)
+			lock_release (&victim->page->owner->spt.lock);
+		victim = frame;
+		victim_acquired = frame_acquired;
+		if (evict_policy != EVICT_CLOCK || !frame_needs_write (frame))
+			break;
+	}
+	if (victim != NULL)
+		victim->pinned = true;
+	lock_release (&frame_lock);
+
+	*acquired = victim_acquired;
 	return victim;
 }
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+/* Evicts one page and returns its frame, pinned.
+ * Returns NULL if no page can be evicted. */
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+	int tries;
+
+	for (tries = 0; tries < 4; tries++) {
+		bool acquired;
+		struct frame *victim = vm_get_victim (&acquired);
+		struct lock *lock;
+		bool written, success;
 
+		if (victim == NULL)
+			return NULL;
+		lock = &victim->page->owner->spt.lock;
+		written = frame_needs_write (victim);
+		ksm_forget (victim);
+		success = swap_out (victim->page);
+		if (acquired)
+			lock_release (lock);
+
+		if (success) {
+			ASSERT (victim->ref_cnt == 0);
+			evict_cnt++;
+			if (written)
+				write_cnt++;
+			return victim;
+		}
+		/* Out of swap, or the frame became shared meanwhile. */
+		frame_unpin (victim);
+	}
 	return NULL;
 }
 
+/* Returns a new frame for the user page at KVA, mapped by no page yet.
+ * The frame is pinned until the caller has mapped it. */
+static struct frame *
+frame_new (void *kva) {
+	struct frame *frame = malloc (sizeof *frame);
+
+	if (frame == NULL)
+		PANIC ("vm_get_frame: out of kernel memory");
+	frame->kva = kva;
+	frame->page = NULL;
+	list_init (&frame->pages);
+	frame->ref_cnt = 0;
+	frame->pinned = true;
+	frame->merged = false;
+	frame->ksm = NULL;
+
+	lock_acquire (&frame_lock);
+	list_push_back (&frame_table, &frame->elem);
+	lock_release (&frame_lock);
+	kswapd_check ();
+	return frame;
+}
+
+/* Unpins FRAME, once it is mapped, so that it may be evicted. */
+static void
+frame_unpin (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	frame->pinned = false;
+	lock_release (&frame_lock);
+}
+
+/* Takes FRAME out of the frame table and frees it, but not its memory. */
+static void
+frame_forget (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	if (clock_hand == &frame->elem)
+		clock_hand = list_next (clock_hand);
+	if (scan_hand == &frame->elem)
+		scan_hand = list_next (scan_hand);
+	if (flush_hand == &frame->elem)
+		flush_hand = list_next (flush_hand);
+	list_remove (&frame->elem);
+	lock_release (&frame_lock);
+	free (frame);
+}
+
 /* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * and return it.  The frame is zeroed and pinned.  Returns a null pointer
+ * only if user memory is full and no page can be evicted.
+ *
+ * Eviction here, direct reclaim, makes the faulting process wait for the
+ * victim to be written out.  The page-out daemon keeps free frames in
+ * hand so that this only happens when it falls behind. */
 static struct frame *
 vm_get_frame (void) {
 	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+	void *kva = palloc_get_page (PAL_USER | PAL_ZERO);
 
-	ASSERT (frame != NULL);
-	ASSERT (frame->page == NULL);
+	if (kva != NULL)
+		frame = frame_new (kva);
+	else {
+		frame = vm_evict_frame ();
+		if (frame != NULL) {
+			direct_cnt++;
+			memset (frame->kva, 0, PGSIZE);
+		}
+	}
+
+	ASSERT (frame == NULL || frame->page == NULL);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Makes PAGE one of the pages that map FRAME. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+frame_link (struct frame *frame, struct page *page) {
+	lock_acquire (&frame_lock);
+	list_push_back (&frame->pages, &page->frame_elem);
+	frame->ref_cnt++;
+	frame->page = list_entry (list_front (&frame->pages), struct page,
+			frame_elem);
+	page->frame = frame;
+	if (frame != zero_frame)
+		thread_add_rss (page->owner, 1);
+	lock_release (&frame_lock);
 }
 
-/* Handle the fault on write_protected page */
+/* Removes PAGE from the pages that map FRAME.  Returns true if it was the
+ * last one, in which case the caller owns FRAME and must free it. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+frame_unlink (struct frame *frame, struct page *page) {
+	bool last;
+
+	lock_acquire (&frame_lock);
+	list_remove (&page->frame_elem);
+	page->frame = NULL;
+	if (frame != zero_frame)
+		thread_add_rss (page->owner, -1);
+	last = --frame->ref_cnt == 0;
+	frame->page = last ? NULL
+		: list_entry (list_front (&frame->pages), struct page, frame_elem);
+	lock_release (&frame_lock);
+	return last;
+}
+
+/* Frees FRAME and its memory.  No page may map it any more.  The zero
+ * frame stays. */
+void
+vm_free_frame (struct frame *frame) {
+	ASSERT (frame->ref_cnt == 0);
+
+	if (frame == zero_frame)
+		return;
+
+	ksm_forget (frame);
+	palloc_free_page (frame->kva);
+	frame_forget (frame);
+}
+
+/* Makes PAGE, of the current process, one of the pages that map FRAME and
+ * installs the mapping, writable if PAGE is. */
+bool
+vm_map_frame (struct page *page, struct frame *frame) {
+	frame_link (frame, page);
+	return pml4_set_page (thread_current ()->pml4, page->va, frame->kva,
+			page->writable);
 }
 
-/* Return true on success */
+/* Unmaps PAGE from the current process and drops its reference to its
+ * frame.  Returns true if no other page maps the frame any more, in which
+ * case the caller owns it. */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
+vm_unlink_frame (struct page *page) {
+	ASSERT (page->frame != NULL);
+
+	pml4_clear_page (thread_current ()->pml4, page->va);
+	return frame_unlink (page->frame, page);
+}
+
+/* Unmaps PAGE from the current process and drops its reference to its
+ * frame, freeing the frame if no other page shares it.  Page types call
+ * this from their destroy method, once the contents are no longer
+ * needed. */
+void
+vm_release_frame (struct page *page) {
+	struct frame *frame = page->frame;
+
+	if (frame != NULL && vm_unlink_frame (page))
+		vm_free_frame (frame);
+}
+
+/* Makes PAGE, mapped in the current process, use FRAME in place of its own
+ * frame, which is released.  FRAME must already hold PAGE's contents. */
+bool
+vm_remap_frame (struct page *page, struct frame *frame) {
+	vm_release_frame (page);
+	return vm_map_frame (page, frame);
+}
+
+/* Detaches every page that maps FRAME, in whichever process, so that the
+ * next access to any of them faults.  FRAME itself stays allocated.  Page
+ * types call this from swap_out before saving the contents, so that a
+ * store to the page waits in the fault handler instead of going to a frame
+ * that is about to be reused; vm_restore_frame() undoes it if the
+ * contents cannot be saved. */
+void
+vm_unmap_frame (struct frame *frame) {
+	while (frame->ref_cnt > 0) {
+		struct page *page = frame->page;
+
+		pml4_clear_page (page->owner->pml4, page->va);
+		frame_unlink (frame, page);
+	}
+}
+
+/* Maps PAGE to FRAME again, as it was before vm_unmap_frame(), when its
+ * swap_out method could not save the contents after all, and marks it
+ * dirty if DIRTY.  PAGE must have mapped FRAME alone.  The caller must
+ * hold the page table lock of PAGE's process. */
+void
+vm_restore_frame (struct page *page, struct frame *frame, bool dirty) {
+	ASSERT (lock_held_by_current_thread (&page->owner->spt.lock));
+	ASSERT (frame->ref_cnt == 0);
+
+	frame_link (frame, page);
+	/* The page table exists, as the page was mapped a moment ago. */
+	pml4_set_page (page->owner->pml4, page->va, frame->kva, page->writable);
+	if (dirty)
+		pml4_set_dirty (page->owner->pml4, page->va, true);
+}
+
+/* Returns true if NEAR, a page of the same process as PAGE, which is
+ * being evicted, may be evicted along with it: NEAR has a frame of its
+ * own that is not pinned and has not been used since the clock hand last
+ * cleared its accessed bit.  The caller must hold the page table lock of
+ * the process. */
+bool
+vm_evict_along (struct page *page, struct page *near) {
+	struct frame *frame;
+	bool ok;
+
+	ASSERT (lock_held_by_current_thread (&page->owner->spt.lock));
+
+	if (near == NULL || near->owner != page->owner)
+		return false;
+	lock_acquire (&frame_lock);
+	frame = near->frame;
+	ok = frame != NULL && !frame->pinned && frame->ref_cnt == 1
+		&& !pml4_is_accessed (near->owner->pml4, near->va);
+	lock_release (&frame_lock);
+	return ok;
+}
+
+/* Gives PAGE, which has no frame, the fresh user page at KVA, which
+ * already holds its contents, and maps it in PAGE's process.  The caller
+ * must hold the page table lock of the process.  Returns true if
+ * successful; otherwise, frees KVA. */
+bool
+vm_install_page (struct page *page, void *kva) {
+	struct frame *frame = frame_new (kva);
+
+	ASSERT (lock_held_by_current_thread (&page->owner->spt.lock));
+	ASSERT (page->frame == NULL);
+
+	frame_link (frame, page);
+	if (!pml4_set_page (page->owner->pml4, page->va, kva, page->writable)) {
+		frame_unlink (frame, page);
+		vm_free_frame (frame);
+		return false;
+	}
+	frame_unpin (frame);
+	return true;
+}
+
+/* Takes the page table lock of PAGE's process for the merge daemon, which
+ * has no process of its own, if the current thread does not hold it yet.
+ * Sets *ACQUIRED if it had to be acquired.  Returns false if it is busy. */
+static bool
+lock_for_merge (struct page *page, bool *acquired) {
+	struct lock *lock = &page->owner->spt.lock;
+
+	*acquired = false;
+	if (lock_held_by_current_thread (lock))
+		return true;
+	*acquired = lock_try_acquire (lock);
+	return *acquired;
+}
+
+/* Returns true if PAGE, alone in FRAME, may be merged with others. */
+static bool
+frame_mergeable (struct frame *frame, struct page *page) {
+	return page != NULL && !frame->pinned && !frame->merged
+		&& frame->ref_cnt == 1
+		&& VM_TYPE (page->operations->type) == VM_ANON
+		&& page->anon.shm == NULL;
+}
+
+/* Evicts one page and frees its frame, for the page-out daemon.  Returns
+ * false if no page can be evicted. */
+bool
+vm_reclaim_frame (void) {
+	struct frame *frame = vm_evict_frame ();
+
+	if (frame == NULL)
+		return false;
+	vm_free_frame (frame);
+	return true;
+}
+
+/* Advances the flusher's scan over the frame table by one frame.  If the
+ * frame holds a dirty page of a file mapping alone and is not pinned, and
+ * the page table lock of the page's process is free, acquires that lock
+ * and returns the page; otherwise, returns a null pointer.  Sets *LAST if
+ * the frame was the last one in the table, so that the next scan starts
+ * over from the beginning. */
+struct page *
+vm_scan_dirty (bool *last) {
+	struct frame *frame;
+	struct page *page;
+
+	*last = true;
+	lock_acquire (&frame_lock);
+	if (list_empty (&frame_table)) {
+		lock_release (&frame_lock);
+		return NULL;
+	}
+	if (flush_hand == list_end (&frame_table))
+		flush_hand = list_begin (&frame_table);
+	frame = list_entry (flush_hand, struct frame, elem);
+	flush_hand = list_next (flush_hand);
+	*last = flush_hand == list_end (&frame_table);
+
+	page = frame->page;
+	if (page == NULL || frame->pinned || frame->ref_cnt != 1
+			|| VM_TYPE (page->operations->type) != VM_FILE
+			|| page->file.shared
+			|| !pml4_is_dirty (page->owner->pml4, page->va)
+			|| !lock_try_acquire (&page->owner->spt.lock))
+		page = NULL;
+	lock_release (&frame_lock);
+	return page;
+}
+
+/* Advances the merge daemon's scan over the frame table by one frame.  If
+ * the frame holds a private anonymous page alone, is neither pinned nor
+ * merged, and the page table lock of the page's process is free, acquires
+ * that lock and returns the page; otherwise, returns a null pointer.  Sets
+ * *WRAPPED if the scan started over from the beginning of the table. */
+struct page *
+vm_scan_page (bool *wrapped) {
+	struct frame *frame;
+	struct page *page;
+	bool acquired;
+
+	*wrapped = false;
+	lock_acquire (&frame_lock);
+	if (list_empty (&frame_table)) {
+		lock_release (&frame_lock);
+		return NULL;
+	}
+	if (scan_hand == list_end (&frame_table)) {
+		scan_hand = list_begin (&frame_table);
+		*wrapped = true;
+	}
+	frame = list_entry (scan_hand, struct frame, elem);
+	scan_hand = list_next (scan_hand);
+
+	page = frame->page;
+	if (!frame_mergeable (frame, page) || !lock_for_merge (page, &acquired))
+		page = NULL;
+	lock_release (&frame_lock);
+	return page;
+}
+
+/* Makes sure the merge daemon holds the page table lock of the process
+ * whose private anonymous page is alone in FRAME, as lock_for_merge()
+ * does, and returns the page.  Returns a null pointer if FRAME no longer
+ * qualifies or the lock is busy. */
+struct page *
+vm_lock_frame (struct frame *frame, bool *acquired) {
+	struct page *page;
+
+	lock_acquire (&frame_lock);
+	page = frame->page;
+	if (!frame_mergeable (frame, page) || !lock_for_merge (page, acquired))
+		page = NULL;
+	lock_release (&frame_lock);
+	return page;
+}
+
+/* Makes PAGE, a private anonymous page alone in its frame, share FRAME
+ * read-only if their contents are the same, freeing PAGE's own frame, and
+ * marks FRAME merged.  The caller must hold the page table locks of PAGE's
+ * process and, unless FRAME is merged already, of the process of the one
+ * page in FRAME.  Returns true if successful.  Either way, both pages may
+ * be left read-only; the next write makes them writable again. */
+bool
+vm_merge_page (struct page *page, struct frame *frame) {
+	struct frame *old = page->frame;
+
+	ASSERT (old != frame);
+	ASSERT (lock_held_by_current_thread (&page->owner->spt.lock));
+
+	/* Write-protect both pages, so that neither can change once they
+	 * compare equal. */
+	if (!frame->merged) {
+		struct page *p = frame->page;
+
+		ASSERT (frame->ref_cnt == 1);
+		ASSERT (lock_held_by_current_thread (&p->owner->spt.lock));
+		if (!pml4_set_page (p->owner->pml4, p->va, frame->kva, false))
+			return false;
+	}
+	if (!pml4_set_page (page->owner->pml4, page->va, old->kva, false)
+			|| memcmp (old->kva, frame->kva, PGSIZE))
+		return false;
+
+	frame->merged = true;
+	if (frame_unlink (old, page))
+		vm_free_frame (old);
+	frame_link (frame, page);
+	/* The page table exists, as the page was mapped a moment ago. */
+	return pml4_set_page (page->owner->pml4, page->va, frame->kva, false);
+}
+
+/* Takes the frame of the current process's resident, private, writable
+ * anonymous page at VA away from it and returns its kernel address, which
+ * the caller must eventually free with palloc_free_page().  The page is
+ * replaced by a fresh zero-filled one.  Returns a null pointer, changing
+ * nothing, if the page does not qualify. */
+void *
+vm_steal_page (void *va) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	struct page *page;
+	struct frame *frame;
+	void *kva;
+
+	lock_acquire (&spt->lock);
+	page = spt_find_page (spt, va);
+	if (page == NULL || !page->writable
+			|| VM_TYPE (page->operations->type) != VM_ANON
+			|| page->anon.shm != NULL
+			|| page->frame == NULL || frame_is_shared (page->frame)) {
+		lock_release (&spt->lock);
+		return NULL;
+	}
+
+	frame = page->frame;
+	kva = frame->kva;
+	pml4_clear_page (thread_current ()->pml4, page->va);
+	frame_unlink (frame, page);
+	/* ksmd must not go on to scan a page the caller now owns. */
+	ksm_forget (frame);
+	frame_forget (frame);
+
+	va = page->va;
+	spt_remove_page (spt, page);
+	spt_new_page (spt, VM_ANON, va, true, NULL, NULL);
+	lock_release (&spt->lock);
+	return kva;
+}
+
+/* Growing the stack: extends the stack's VMA down to ADDR and brings in
+ * the page there.  Returns true on success. */
+static bool
+vm_stack_growth (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	struct vma *stack = vma_find (spt, (uint8_t *) USER_STACK - 1);
+	void *upage = pg_round_down (addr);
+
+	return stack != NULL && (uint8_t *) upage < stack->start
+		&& vma_grow_down (spt, stack, upage) && vm_claim_page (upage);
+}
+
+/* Returns true if FRAME may not be written through any one page mapping
+ * it: it is shared with another process since fork, merged, or the zero
+ * frame. */
+static bool
+frame_is_shared (struct frame *frame) {
+	return frame->ref_cnt > 1 || frame == zero_frame || frame->merged;
+}
+
+/* Returns true if PAGE, not loaded yet, is anonymous memory that starts
+ * out as zeros. */
+static bool
+is_zero_fill (struct page *page) {
+	return VM_TYPE (page->operations->type) == VM_UNINIT
+		&& VM_TYPE (page->uninit.type) == VM_ANON
+		&& page->uninit.init == NULL;
+}
+
+/* Maps the zero frame, read-only, at PAGE, which is_zero_fill(), so that
+ * reading it costs no memory.  The first write gets PAGE a frame of its
+ * own in vm_handle_wp(). */
+static bool
+vm_map_zero (struct page *page) {
+	/* Turn the page into an anonymous page; there is nothing to load. */
+	if (!swap_in (page, zero_frame->kva))
+		return false;
+	frame_link (zero_frame, page);
+	if (!pml4_set_page (thread_current ()->pml4, page->va, zero_frame->kva,
+				false)) {
+		vm_release_frame (page);
+		return false;
+	}
+	zero_cnt++;
+	return true;
+}
+
+/* Handle the fault on write_protected page */
+static bool
+vm_handle_wp (struct page *page) {
+	struct frame *old = page->frame;
+
+	if (!page->writable || old == NULL)
+		return false;
+
+	/* Shared with another process since fork, merged or the zero frame:
+	 * take a private copy and leave the original to the remaining
+	 * sharers. */
+	if (frame_is_shared (old)) {
+		struct frame *new = vm_get_frame ();
+
+		if (new == NULL)
+			return false;
+		/* New frames are zeroed already. */
+		if (old != zero_frame)
+			memcpy (new->kva, old->kva, PGSIZE);
+		if (frame_unlink (old, page))
+			/* Everybody else copied in the meantime. */
+			vm_free_frame (old);
+		frame_link (new, page);
+		frame_unpin (new);
+	}
+
+	return pml4_set_page (thread_current ()->pml4, page->va,
+			page->frame->kva, true);
+}
+
+/* Returns the lazy loader's argument of PAGE if it is not loaded yet and
+ * is to be read from a file, or a null pointer otherwise. */
+static struct lazy_load_arg *
+lazy_arg (struct page *page) {
+	if (VM_TYPE (page->operations->type) != VM_UNINIT)
+		return NULL;
+	return page->uninit.aux;
+}
+
+/* Returns the page at VA of SPT if it is not loaded yet and is to be
+ * read from INODE at offset OFS, making it from its VMA if need be;
+ * otherwise, a null pointer.  With CACHED, only executable text that
+ * some process has in the text cache qualifies. */
+static struct page *
+page_from (struct supplemental_page_table *spt, void *va,
+		struct inode *inode, off_t ofs, bool cached) {
+	struct page *page = spt_find_page (spt, va);
+	struct lazy_load_arg *arg, vma_arg;
+	enum vm_type type;
+
+	if (page != NULL) {
+		arg = lazy_arg (page);
+		type = page->uninit.type;
+	} else {
+		struct vma *vma = vma_find (spt, va);
+
+		if (vma == NULL || !vma_page_arg (vma, va, &vma_arg))
+			return NULL;
+		arg = &vma_arg;
+		type = vma->type;
+	}
+
+	if (arg == NULL || file_get_inode (arg->file) != inode || arg->ofs != ofs
+			|| (cached && ((type & VM_MARKER_1) == 0 || !file_is_cached (arg))))
+		return NULL;
+	return page != NULL ? page : spt_get_page (spt, va);
+}
+
+/* Returns the page at VA of SPT if it has contents to read from a file
+ * or swap, making it from its VMA if need be, or a null pointer if not. */
+static struct page *
+page_to_read (struct supplemental_page_table *spt, void *va) {
+	struct page *page = spt_find_page (spt, va);
+	struct lazy_load_arg arg;
+	struct vma *vma;
+
+	if (page != NULL)
+		return page->frame == NULL && !is_zero_fill (page) ? page : NULL;
+	vma = vma_find (spt, va);
+	if (vma == NULL || !vma_page_arg (vma, va, &arg))
+		return NULL;
+	return spt_get_page (spt, va);
+}
+
+/* Returns the readahead state of the mapping that VA is in. */
+static struct readahead *
+readahead_of (struct supplemental_page_table *spt, void *va) {
+	struct vma *vma = vma_find (spt, va);
+
+	return vma != NULL ? &vma->ra : &spt->ra;
+}
+
+/* Loads PAGE, a neighbour of a faulting page, into a free frame, and maps
+ * it.  Returns false if there is no free frame: reading ahead is not worth
+ * evicting anything. */
+static bool
+load_ahead (struct page *page) {
+	void *kva = palloc_get_page (PAL_USER);
+
+	return kva != NULL && vm_load_page (page, frame_new (kva));
+}
+
+/* Clears the accessed bits of the pages up to RA_MAX_PAGES behind VA, in
+ * a mapping scanned with MADV_SEQUENTIAL, so that eviction takes them
+ * before anything else. */
+static void
+drop_behind (struct supplemental_page_table *spt, uint8_t *va) {
+	size_t i;
+
+	for (i = 1; i <= RA_MAX_PAGES; i++) {
+		struct page *p = spt_find_page (spt, va - i * PGSIZE);
+
+		if (p != NULL && p->frame != NULL)
+			pml4_set_accessed (p->owner->pml4, p->va, false);
+	}
+}
+
+/* After PAGE, which was just read from INODE at offset OFS, loads the
+ * pages that follow it in the file and in the address space, as many as
+ * the mapping's readahead window says, and maps the pages around it that
+ * are in the text cache already.  Unlike a fault, none of this evicts
+ * anything.  Pages read ahead but never used have their accessed bits
+ * clear, so that eviction takes them first. */
+static void
+fault_around (struct supplemental_page_table *spt, struct page *page,
+		struct inode *inode, off_t ofs) {
+	struct readahead *ra = readahead_of (spt, page->va);
+	uint8_t *va = page->va;
+	uint8_t *block = va - pg_no (va) % FAULT_AROUND_PAGES * PGSIZE;
+	size_t ahead, i;
+
+	if (ra->advice == MADV_RANDOM)
+		ra->window = 0;
+	else if (ra->advice == MADV_SEQUENTIAL) {
+		ra->window = RA_MAX_PAGES;
+		drop_behind (spt, va);
+	} else if (va == ra->next)
+		ra->window = ra->window == 0 ? RA_MIN_PAGES
+			: ra->window * 2 < RA_MAX_PAGES ? ra->window * 2 : RA_MAX_PAGES;
+	else
+		ra->window = 0;
+
+	for (ahead = 0; ahead < ra->window; ahead++) {
+		off_t delta = (ahead + 1) * PGSIZE;
+		struct page *p = page_from (spt, va + delta, inode, ofs + delta, false);
+
+		if (p == NULL || !load_ahead (p))
+			break;
+	}
+	ra->next = va + (ahead + 1) * PGSIZE;
+	ahead_cnt += ahead;
+
+	for (i = 0; i < FAULT_AROUND_PAGES; i++) {
+		uint8_t *around = block + i * PGSIZE;
+		struct page *p;
+
+		if (around == va)
+			continue;
+		p = page_from (spt, around, inode, ofs + (around - va), true);
+		if (p != NULL && load_ahead (p))
+			around_cnt++;
+	}
+}
+
+/* Loads the PAGE_CNT pages at ADDR of the current process that are not
+ * loaded yet, in one pass, as if each had been touched.  Stops early if
+ * memory runs out.  The caller must hold the page table lock. */
+void
+vm_populate (void *addr, size_t page_cnt) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&spt->lock));
+
+	for (i = 0; i < page_cnt; i++) {
+		struct page *page = spt_get_page (spt, addr + i * PGSIZE);
+
+		if (page != NULL && page->frame == NULL && !vm_do_claim_page (page))
+			break;
+	}
+}
+
+/* Sets ADVICE on every mapping that the PAGE_CNT pages at ADDR are in.
+ * Pages outside VMAs share the readahead state of the process. */
+static void
+set_advice (struct supplemental_page_table *spt, uint8_t *addr,
+		size_t page_cnt, int advice) {
+	uint8_t *end = addr + page_cnt * PGSIZE;
+	size_t covered = 0;
+	size_t i;
+
+	for (i = 0; i < spt->vma_cnt; i++) {
+		struct vma *vma = spt->vmas[i];
+
+		if (vma->start < end && vma->end > addr) {
+			vma->ra.advice = advice;
+			covered += ((vma->end < end ? vma->end : end)
+					- (vma->start > addr ? vma->start : addr)) / PGSIZE;
+		}
+	}
+	if (covered < page_cnt)
+		spt->ra.advice = advice;
+}
+
+/* Drops the contents of PAGE, if it has any of its own.  Anonymous memory
+ * in a VMA is made afresh from it at the next touch, as a private mapping
+ * is on other systems: anonymous mappings, bss and the stack read as
+ * zeros, and a data segment reads the executable's data again.  Other
+ * anonymous memory, such as the heap, reads as zeros, unless memory runs
+ * out, in which case it is kept.  A mapped file is written back and read
+ * again.  Pages of shared memory and executable text are left alone, as
+ * are those not loaded yet. */
+static void
+drop_page (struct supplemental_page_table *spt, struct page *page) {
+	enum vm_type type = VM_TYPE (page->operations->type);
+	void *va = page->va;
+	bool writable = page->writable;
+
+	if (type == VM_ANON && page->anon.shm == NULL) {
+		hash_delete (&spt->pages, &page->spt_elem);
+		if (vma_find (spt, va) == NULL
+				&& !spt_new_page (spt, VM_ANON, va, writable, NULL, NULL)) {
+			spt_insert_page (spt, page);
+			return;
+		}
+		vm_dealloc_page (page);
+	} else if (type == VM_FILE && !page->file.shared && page->frame != NULL) {
+		struct file_page *file_page = &page->file;
+
+		if (pml4_is_dirty (page->owner->pml4, page->va))
+			file_write_at (file_page->file, page->frame->kva,
+					file_page->read_bytes, file_page->ofs);
+		vm_release_frame (page);
+	}
+}
+
+/* Advises how the current process will use the LENGTH bytes of memory
+ * at ADDR, which must be page-aligned.  MADV_NORMAL, MADV_RANDOM and
+ * MADV_SEQUENTIAL set how faults in the mappings there read ahead.
+ * MADV_WILLNEED loads the pages that are not loaded yet, as far as free
+ * memory goes.  MADV_DONTNEED drops the pages' contents.  Pages in the
+ * range that are not mapped are skipped.  Returns 0 if successful, -1 on
+ * bad arguments. */
+int
+do_madvise (void *addr, size_t length, int advice) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	size_t page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	size_t i;
+
+	if (pg_ofs (addr) != 0 || !is_user_vaddr (addr)
+			|| page_cnt > (KERN_BASE - (uint64_t) addr) / PGSIZE
+			|| advice < MADV_NORMAL || advice > MADV_DONTNEED)
+		return -1;
+
+	lock_acquire (&spt->lock);
+	if (advice == MADV_WILLNEED || advice == MADV_DONTNEED)
+		for (i = 0; i < page_cnt; i++) {
+			void *va = addr + i * PGSIZE;
+			struct page *page;
+
+			if (advice == MADV_DONTNEED) {
+				page = spt_find_page (spt, va);
+				if (page != NULL)
+					drop_page (spt, page);
+			} else if ((page = page_to_read (spt, va)) != NULL) {
+				if (!load_ahead (page))
+					break;
+				ahead_cnt++;
+			}
+		}
+	else
+		set_advice (spt, addr, page_cnt, advice);
+	lock_release (&spt->lock);
+	return 0;
+}
+
+/* Returns the kind of fault that loading PAGE, which has no frame, for a
+ * fault, a write if WRITE, is. */
+static enum fault_kind
+fault_kind (struct page *page, bool write) {
+	if (VM_TYPE (page->operations->type) != VM_UNINIT)
+		return FAULT_SWAP;
+	if ((!write && is_zero_fill (page)) || lazy_arg (page) == NULL)
+		return FAULT_ZERO;
+	return page_get_type (page) == VM_FILE ? FAULT_FILE : FAULT_ANON;
+}
+
+/* Return true on success, setting *KIND to the kind of fault it was. */
+static bool
+handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present, enum fault_kind *kind) {
+	struct thread *curr = thread_current ();
+	struct supplemental_page_table *spt = &curr->proc->spt;
 	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+	struct lazy_load_arg *arg;
+	struct inode *inode;
+	off_t ofs;
 
-	return vm_do_claim_page (page);
+	if (addr == NULL || is_kernel_vaddr (addr))
+		return false;
+
+	page = spt_get_page (spt, addr);
+
+	/* A present page only faults for a write to a read-only mapping, which
+	 * is fine if the page is really writable but still copy-on-write. */
+	if (!not_present) {
+		*kind = FAULT_WP;
+		return write && page != NULL && vm_handle_wp (page);
+	}
+
+	if (page == NULL) {
+		/* The kernel faults on the user stack inside system calls, when
+		 * the user's rsp is the one saved on syscall entry. */
+		uintptr_t rsp = user ? f->rsp : curr->user_rsp;
+
+		if ((uintptr_t) addr >= rsp - 8 && (uintptr_t) addr < USER_STACK
+				&& (uintptr_t) addr >= USER_STACK - STACK_LIMIT) {
+			*kind = FAULT_STACK;
+			return vm_stack_growth (addr);
+		}
+		return false;
+	}
+
+	if (write && !page->writable)
+		return false;
+
+	/* Another thread may have brought the page in while this one waited
+	 * for the lock. */
+	*kind = FAULT_RESIDENT;
+	if (pml4_get_page (curr->pml4, page->va) != NULL)
+		return true;
+
+	/* Still resident, but unmapped along with a huge page that could not
+	 * be split.  Shared frames go back read-only, as after fork. */
+	if (page->frame != NULL)
+		return pml4_set_page (curr->pml4, page->va, page->frame->kva,
+				page->writable && !frame_is_shared (page->frame));
+
+	*kind = fault_kind (page, write);
+
+	if (!write && is_zero_fill (page))
+		return vm_map_zero (page);
+	if (vm_claim_huge (spt, page))
+		return true;
+	arg = lazy_arg (page);
+	if (arg == NULL)
+		return vm_do_claim_page (page);
+
+	/* The loader frees ARG. */
+	inode = file_get_inode (arg->file);
+	ofs = arg->ofs;
+	if (!vm_do_claim_page (page))
+		return false;
+	fault_around (spt, page, inode, ofs);
+	return true;
+}
+
+/* Counts a fault of KIND that took CYCLES to handle in STATS. */
+static void
+faultstat_add (struct faultstat *stats, enum fault_kind kind,
+		uint64_t cycles) {
+	int bucket = 0;
+
+	while (bucket < FAULT_BUCKETS - 1
+			&& cycles >> (FAULT_HIST_MIN + bucket) != 0)
+		bucket++;
+	stats->cnt[kind]++;
+	stats->cycles[kind] += cycles;
+	stats->hist[kind][bucket]++;
+}
+
+/* Handles the page fault at ADDR, counting it as major if it took
+ * reading the disk and minor otherwise.  Returns true on success.
+ * Faults of the threads of one process are handled one at a time.
+ * Every fault, handled or not, is counted by kind together with the
+ * time it took, waiting for the lock included, in the statistics of the
+ * process and of the whole system. */
+bool
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	struct thread *curr = thread_current ();
+	struct thread *proc = curr->proc;
+	struct lock *lock = &proc->spt.lock;
+	int64_t reads = curr->usage.inblock;
+	enum fault_kind kind = FAULT_INVALID;
+	uint64_t start = rdtsc ();
+	uint64_t cycles;
+	bool success;
+
+	lock_acquire (lock);
+	success = handle_fault (f, addr, user, write, not_present, &kind);
+	if (!success)
+		kind = FAULT_INVALID;
+	cycles = rdtsc () - start;
+	if (proc->faults == NULL)
+		proc->faults = calloc (1, sizeof *proc->faults);
+	if (proc->faults != NULL)
+		faultstat_add (proc->faults, kind, cycles);
+	lock_release (lock);
+	lock_acquire (&faultstat_lock);
+	faultstat_add (&all_faults, kind, cycles);
+	lock_release (&faultstat_lock);
+	if (!success)
+		return false;
+	fault_cnt++;
+	if (curr->usage.inblock > reads) {
+		curr->usage.majflt++;
+		major_cnt++;
+	} else
+		curr->usage.minflt++;
+	return true;
+}
+
+/* Stores in *STATS, which may be in user memory, the page faults of the
+ * current process if WHO is FAULTSTAT_SELF, or of every process if
+ * FAULTSTAT_ALL.  Returns false if WHO is neither.  The statistics are
+ * copied out under their lock and stored after releasing it, since
+ * storing them may fault. */
+bool
+vm_get_faultstat (int who, struct faultstat *stats) {
+	struct thread *proc = thread_current ()->proc;
+	struct faultstat *copy;
+
+	if (who != FAULTSTAT_SELF && who != FAULTSTAT_ALL)
+		return false;
+	copy = calloc (1, sizeof *copy);
+	if (copy == NULL)
+		return false;
+	if (who == FAULTSTAT_SELF) {
+		lock_acquire (&proc->spt.lock);
+		if (proc->faults != NULL)
+			*copy = *proc->faults;
+		lock_release (&proc->spt.lock);
+	} else {
+		lock_acquire (&faultstat_lock);
+		*copy = all_faults;
+		lock_release (&faultstat_lock);
+	}
+	*stats = *copy;
+	free (copy);
+	return true;
+}
+
+/* Prints the page faults of every process so far: for each kind, how
+ * many and how long they took on average, and their latency histogram. */
+void
+vm_print_faultstat (void) {
+	const struct faultstat *stats = &all_faults;
+	int kind, bucket;
+
+	printf ("Page faults by kind, with latency in cycles:\n");
+	for (kind = 0; kind < FAULT_KINDS; kind++) {
+		if (stats->cnt[kind] == 0)
+			continue;
+		printf ("%s: %lld faults, mean %lld cycles\n", fault_names[kind],
+				stats->cnt[kind], stats->cycles[kind] / stats->cnt[kind]);
+		for (bucket = 0; bucket < FAULT_BUCKETS; bucket++) {
+			if (stats->hist[kind][bucket] == 0)
+				continue;
+			if (bucket == 0)
+				printf ("  < 2^%d", FAULT_HIST_MIN);
+			else if (bucket == FAULT_BUCKETS - 1)
+				printf ("  >= 2^%d", FAULT_HIST_MIN + bucket - 1);
+			else
+				printf ("  2^%d-2^%d", FAULT_HIST_MIN + bucket - 1,
+						FAULT_HIST_MIN + bucket);
+			printf (": %u\n", stats->hist[kind][bucket]);
+		}
+	}
 }
 
 /* Free the page.
@@ -150,41 +1350,348 @@ vm_dealloc_page (struct page *page) {
 
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	struct page *page = spt_get_page (&thread_current ()->proc->spt, va);
 
+	if (page == NULL)
+		return false;
 	return vm_do_claim_page (page);
 }
 
-/* Claim the PAGE and set up the mmu. */
+/* Claim the PAGE and set up the mmu.  The page is mapped only once its
+ * contents are in, so that other threads of the process never see it
+ * half loaded. */
 static bool
 vm_do_claim_page (struct page *page) {
 	struct frame *frame = vm_get_frame ();
 
+	return frame != NULL && vm_load_page (page, frame);
+}
+
+/* Loads PAGE into FRAME, fresh and pinned, and maps it. */
+static bool
+vm_load_page (struct page *page, struct frame *frame) {
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	frame_link (frame, page);
+
+	if (!swap_in (page, frame->kva)) {
+		vm_release_frame (page);
+		return false;
+	}
+
+	/* Swapping in may have switched PAGE over to a shared frame. */
+	if (!pml4_set_page (thread_current ()->pml4, page->va, page->frame->kva,
+				page->writable)) {
+		vm_release_frame (page);
+		return false;
+	}
+	if (page->frame == frame)
+		frame_unpin (frame);
+	return true;
+}
+
+/* Returns true if the huge page at BASE is made up of pages of SPT that
+ * are not loaded yet and alike in type and writability to PAGE.  Pages
+ * not touched yet qualify if they are in PAGE's VMA. */
+static bool
+huge_candidate (struct supplemental_page_table *spt, uint8_t *base,
+		struct page *page) {
+	struct vma *vma = vma_find (spt, page->va);
+	bool in_vma = vma != NULL && vma->start <= base
+		&& base + HPGSIZE <= vma->end;
+	size_t i;
+
+	for (i = 0; i < HPGPAGES; i++) {
+		struct page *p = spt_find_page (spt, base + i * PGSIZE);
+
+		if (p == NULL && in_vma)
+			continue;
+		if (p == NULL || VM_TYPE (p->operations->type) != VM_UNINIT
+				|| page_get_type (p) != page_get_type (page)
+				|| p->writable != page->writable)
+			return false;
+	}
+	return true;
+}
+
+/* Brings in the whole huge page around PAGE at once and maps it with one
+ * page-directory entry, which saves page faults and TLB entries for
+ * large mappings.  Every page of the huge page gets a frame of its own
+ * within it, so that the pages can later be unmapped, shared or evicted
+ * one by one after all, splitting the mapping.
+ * Returns true if PAGE is now mapped.  If the range does not qualify or no
+ * huge page of memory is free, loads nothing, leaves the pages not touched
+ * yet to their VMA, and returns false. */
+static bool
+vm_claim_huge (struct supplemental_page_table *spt, struct page *page) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	uint8_t *base = hpg_round_down (page->va);
+	uint64_t made[HPGPAGES / 64] = { 0 };   /* Pages made from the VMA. */
+	uint8_t *kva;
+	bool contiguous = true;
+	size_t loaded, i;
+
+	if (!huge_candidate (spt, base, page))
+		return false;
+	/* Memory first: making the pages costs a file_reopen() each. */
+	kva = palloc_get_huge_page (PAL_USER | PAL_ZERO);
+	if (kva == NULL)
+		return false;
+	for (i = 0; i < HPGPAGES; i++) {
+		if (spt_find_page (spt, base + i * PGSIZE) != NULL)
+			continue;
+		if (spt_get_page (spt, base + i * PGSIZE) == NULL) {
+			while (i-- > 0)
+				if (made[i / 64] & (1ULL << i % 64))
+					spt_remove_page (spt,
+							spt_find_page (spt, base + i * PGSIZE));
+			palloc_free_multiple (kva, HPGPAGES);
+			return false;
+		}
+		made[i / 64] |= 1ULL << i % 64;
+	}
+
+	for (loaded = 0; loaded < HPGPAGES; loaded++) {
+		struct page *p = spt_find_page (spt, base + loaded * PGSIZE);
+
+		frame_link (frame_new (kva + loaded * PGSIZE), p);
+		if (!swap_in (p, p->frame->kva)) {
+			vm_release_frame (p);
+			for (i = loaded + 1; i < HPGPAGES; i++)
+				palloc_free_page (kva + i * PGSIZE);
+			break;
+		}
+		/* Swapping in may have switched P over to a shared frame. */
+		if (p->frame->kva != kva + loaded * PGSIZE)
+			contiguous = false;
+	}
+
+	if (loaded == HPGPAGES && contiguous
+			&& pml4_set_huge_page (pml4, base, kva, page->writable)) {
+		for (i = 0; i < HPGPAGES; i++)
+			frame_unpin (spt_find_page (spt, base + i * PGSIZE)->frame);
+		return true;
+	}
+
+	/* Map whatever was loaded in 4 kB pages. */
+	for (i = 0; i < loaded; i++) {
+		struct page *p = spt_find_page (spt, base + i * PGSIZE);
+
+		if (!pml4_set_page (pml4, p->va, p->frame->kva, p->writable))
+			vm_release_frame (p);
+		else if (p->frame->kva == kva + i * PGSIZE)
+			frame_unpin (p->frame);
+	}
+	return page->frame != NULL;
+}
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+static uint64_t
+page_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct page *p = hash_entry (e, struct page, spt_elem);
+	return hash_bytes (&p->va, sizeof p->va);
+}
 
-	return swap_in (page, frame->kva);
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	const struct page *pa = hash_entry (a, struct page, spt_elem);
+	const struct page *pb = hash_entry (b, struct page, spt_elem);
+	return pa->va < pb->va;
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	hash_init (&spt->pages, page_hash, page_less, NULL);
+	spt->vmas = NULL;
+	spt->vma_cnt = spt->vma_cap = 0;
+	spt->ra.next = NULL;
+	spt->ra.window = 0;
+	spt->ra.advice = MADV_NORMAL;
+	lock_init (&spt->lock);
+}
+
+/* Copies the not-yet-loaded page SRC into the current process. */
+static bool
+copy_uninit_page (struct page *src) {
+	struct lazy_load_arg *aux = src->uninit.aux;
+
+	if (aux != NULL) {
+		struct lazy_load_arg *copy = malloc (sizeof *copy);
+		if (copy == NULL)
+			return false;
+		*copy = *aux;
+		copy->file = file_duplicate (aux->file);
+		if (copy->file == NULL) {
+			free (copy);
+			return false;
+		}
+		aux = copy;
+	}
+
+	if (!vm_alloc_page_with_initializer (src->uninit.type, src->va,
+				src->writable, src->uninit.init, aux)) {
+		if (aux != NULL) {
+			file_close (aux->file);
+			free (aux);
+		}
+		return false;
+	}
+	return true;
+}
+
+/* Shares the resident page SRC of PARENT with the current process.
+ * Anonymous pages become read-only in both processes; whoever writes first
+ * gets a private copy in vm_handle_wp().  Executable text is read-only
+ * anyway and simply keeps one frame for everybody. */
+static bool
+share_page (struct thread *parent, struct page *src) {
+	struct thread *curr = thread_current ();
+	enum vm_type type = page_get_type (src);
+	struct page *dst;
+
+	if (!vm_alloc_page (type, src->va, src->writable))
+		return false;
+	dst = spt_find_page (&curr->proc->spt, src->va);
+
+	/* Turn the uninit page into the final type without a fresh frame. */
+	if (type == VM_ANON) {
+		anon_initializer (dst, type, src->frame->kva);
+		dst->anon = src->anon;
+	} else {
+		file_backed_initializer (dst, type, src->frame->kva);
+		dst->file = src->file;
+		dst->file.file = file_duplicate (src->file.file);
+		if (dst->file.file == NULL)
+			return false;
+	}
+	frame_link (src->frame, dst);
+
+	if (!pml4_set_page (curr->pml4, dst->va, src->frame->kva, false))
+		return false;
+	if (src->writable)
+		pml4_set_page (parent->pml4, src->va, src->frame->kva, false);
+	return true;
+}
+
+/* Copies SRC, a page of the parent that has been evicted, into the
+ * current process.  An anonymous page is read back from wherever the
+ * parent's copy was swapped to, which the parent keeps.  A file page is loaded from its file again
+ * on first access, like a page that was never loaded. */
+static bool
+copy_evicted_page (struct page *src) {
+	struct lazy_load_arg *aux;
+
+	if (VM_TYPE (src->operations->type) == VM_ANON) {
+		struct page *dst;
+
+		if (!vm_alloc_page (VM_ANON, src->va, src->writable)
+				|| !vm_claim_page (src->va))
+			return false;
+		dst = spt_find_page (&thread_current ()->proc->spt, src->va);
+		anon_swap_copy (src, dst->frame->kva);
+		return true;
+	}
+
+	aux = malloc (sizeof *aux);
+	if (aux == NULL)
+		return false;
+	aux->file = file_duplicate (src->file.file);
+	aux->ofs = src->file.ofs;
+	aux->read_bytes = src->file.read_bytes;
+	aux->zero_bytes = PGSIZE - src->file.read_bytes;
+	if (aux->file == NULL
+			|| !vm_alloc_page_with_initializer (
+				VM_FILE | (src->file.shared ? VM_MARKER_1 : 0), src->va,
+				src->writable, file_lazy_load, aux)) {
+		if (aux->file != NULL)
+			file_close (aux->file);
+		free (aux);
+		return false;
+	}
+	return true;
+}
+
+/* Gives the current process a private copy of PARENT's resident page SRC. */
+static bool
+copy_resident_page (struct thread *parent, struct page *src) {
+	struct page *dst;
+
+	if (!vm_alloc_page (page_get_type (src), src->va, src->writable)
+			|| !vm_claim_page (src->va))
+		return false;
+	dst = spt_find_page (&thread_current ()->proc->spt, src->va);
+	if (page_get_type (src) == VM_FILE) {
+		dst->file = src->file;
+		dst->file.file = file_duplicate (src->file.file);
+		if (dst->file.file == NULL)
+			return false;
+	}
+	memcpy (dst->frame->kva, src->frame->kva, PGSIZE);
+	if (pml4_is_dirty (parent->pml4, src->va))
+		pml4_set_dirty (thread_current ()->pml4, dst->va, true);
+	return true;
 }
 
 /* Copy supplemental page table from src to dst */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct thread *parent = thread_current ()->parent;
+	struct hash_iterator i;
+	bool success = false;
+
+	/* Pages are allocated into the current process, the child.  The
+	 * parent's other threads must keep off SRC meanwhile. */
+	ASSERT (dst == &thread_current ()->spt);
+	lock_acquire (&src->lock);
+	lock_acquire (&dst->lock);
+
+	hash_first (&i, &src->pages);
+	while (hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page, spt_elem);
+		bool ok;
+
+		if (VM_TYPE (page->operations->type) == VM_UNINIT)
+			ok = copy_uninit_page (page);
+		else if (VM_TYPE (page->operations->type) == VM_ANON
+				&& page->anon.shm != NULL)
+			ok = shm_copy_page (page);
+		else if (page->frame == NULL)
+			ok = copy_evicted_page (page);
+		else if (page_get_type (page) == VM_ANON || page->file.shared)
+			ok = share_page (parent, page);
+		else
+			ok = copy_resident_page (parent, page);
+
+		if (!ok)
+			goto done;
+	}
+
+	/* Last, as pages may not be made within VMAs. */
+	success = vma_copy (dst, src);
+done:
+	lock_release (&dst->lock);
+	lock_release (&src->lock);
+	return success;
+}
+
+static void
+spt_destructor (struct hash_elem *e, void *aux UNUSED) {
+	vm_dealloc_page (hash_entry (e, struct page, spt_elem));
 }
 
 /* Free the resource hold by the supplemental page table */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	/* Each page's destroy method writes back what needs writing and
+	 * releases the frame.  Eviction must keep off meanwhile.  Dirty file
+	 * pages are written back beforehand, in order, so that adjacent
+	 * ones go to the file together. */
+	lock_acquire (&spt->lock);
+	file_sync (spt, NULL, (void *) KERN_BASE);
+	hash_destroy (&spt->pages, spt_destructor);
+
+	vma_kill (spt);
+	lock_release (&spt->lock);
 }
@@ -0,0 +1,300 @@
+/* vma.c: Virtual memory areas.
+ *
+ * Each process keeps its VMAs in an array sorted by address, which is
+ * searched by bisection.  A process has few of them, one per segment of
+ * its executable and per mapping, and they change only on exec, mmap,
+ * munmap, brk and stack growth, so the array is cheap to keep sorted. */
+
+#include "vm/vma.h"
+#include <string.h>
+#include <syscall-nr.h>
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Returns the index in SPT's array of the first VMA that ends after
+ * VA, or the number of VMAs if there is none. */
+static size_t
+vma_index (struct supplemental_page_table *spt, const uint8_t *va) {
+	size_t lo = 0, hi = spt->vma_cnt;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (spt->vmas[mid]->end > va)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+/* Returns the VMA of SPT that VA is in, or a null pointer. */
+struct vma *
+vma_find (struct supplemental_page_table *spt, const void *va) {
+	size_t i = vma_index (spt, va);
+
+	if (i < spt->vma_cnt && spt->vmas[i]->start <= (const uint8_t *) va)
+		return spt->vmas[i];
+	return NULL;
+}
+
+/* Returns true if any VMA of SPT overlaps the range from START up to
+ * END. */
+bool
+vma_overlaps (struct supplemental_page_table *spt, const void *start,
+		const void *end) {
+	size_t i = vma_index (spt, start);
+
+	return i < spt->vma_cnt && spt->vmas[i]->start < (const uint8_t *) end;
+}
+
+/* Returns true if SPT has a page from START up to END.  Looks up each
+ * address or walks the pages, whichever is fewer. */
+static bool
+has_pages (struct supplemental_page_table *spt, uint8_t *start,
+		uint8_t *end) {
+	struct hash_iterator i;
+	uint8_t *va;
+
+	if ((size_t) (end - start) / PGSIZE <= hash_size (&spt->pages)) {
+		for (va = start; va < end; va += PGSIZE)
+			if (spt_find_page (spt, va) != NULL)
+				return true;
+		return false;
+	}
+
+	hash_first (&i, &spt->pages);
+	while (hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page, spt_elem);
+
+		if ((uint8_t *) page->va >= start && (uint8_t *) page->va < end)
+			return true;
+	}
+	return false;
+}
+
+/* Removes the pages of SPT from START up to END. */
+static void
+remove_pages (struct supplemental_page_table *spt, uint8_t *start,
+		uint8_t *end) {
+	struct page **pages;
+	struct hash_iterator i;
+	size_t cnt = 0, n;
+	uint8_t *va;
+
+	if ((size_t) (end - start) / PGSIZE > hash_size (&spt->pages)) {
+		/* The table cannot change while it is being walked. */
+		pages = malloc (hash_size (&spt->pages) * sizeof *pages);
+		if (pages != NULL) {
+			hash_first (&i, &spt->pages);
+			while (hash_next (&i)) {
+				struct page *page = hash_entry (hash_cur (&i), struct page,
+						spt_elem);
+
+				if ((uint8_t *) page->va >= start && (uint8_t *) page->va < end)
+					pages[cnt++] = page;
+			}
+			for (n = 0; n < cnt; n++)
+				spt_remove_page (spt, pages[n]);
+			free (pages);
+			return;
+		}
+	}
+
+	for (va = start; va < end; va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+
+		if (page != NULL)
+			spt_remove_page (spt, page);
+	}
+}
+
+/* Adds VMA to SPT, which has no VMA in its range.  Returns false if out
+ * of memory. */
+static bool
+vma_insert (struct supplemental_page_table *spt, struct vma *vma) {
+	size_t i = vma_index (spt, vma->start);
+
+	if (spt->vma_cnt == spt->vma_cap) {
+		size_t cap = spt->vma_cap != 0 ? spt->vma_cap * 2 : 8;
+		struct vma **vmas = realloc (spt->vmas, cap * sizeof *vmas);
+
+		if (vmas == NULL)
+			return false;
+		spt->vmas = vmas;
+		spt->vma_cap = cap;
+	}
+	memmove (spt->vmas + i + 1, spt->vmas + i,
+			(spt->vma_cnt - i) * sizeof *spt->vmas);
+	spt->vmas[i] = vma;
+	spt->vma_cnt++;
+	return true;
+}
+
+/* Frees VMA, which is in no process. */
+static void
+vma_destroy (struct vma *vma) {
+	file_close (vma->file);
+	free (vma);
+}
+
+/* Returns a copy of VMA, with a file of its own. */
+static struct vma *
+vma_clone (const struct vma *vma) {
+	struct vma *copy = malloc (sizeof *copy);
+
+	if (copy == NULL)
+		return NULL;
+	*copy = *vma;
+	if (vma->file != NULL) {
+		copy->file = file_reopen (vma->file);
+		if (copy->file == NULL) {
+			free (copy);
+			return NULL;
+		}
+		/* Text keeps its file from being written, as its pages do. */
+		if (vma->type & VM_MARKER_1)
+			file_deny_write (copy->file);
+	}
+	return copy;
+}
+
+/* Sets up PAGE_CNT pages at START in the current process as one VMA, of
+ * pages of TYPE, writable if WRITABLE, backed by READ_BYTES bytes of FILE
+ * from offset OFS and loaded by INIT, as described for struct vma.  FILE
+ * may be null.  The VMA keeps a file of its own.  Returns the VMA, or a
+ * null pointer if any of the pages is in use already or memory runs out.
+ * The caller must hold the page table lock if the process may have other
+ * threads. */
+struct vma *
+vma_map (void *start, size_t page_cnt, enum vm_type type, bool writable,
+		vm_initializer *init, struct file *file, off_t ofs,
+		size_t read_bytes) {
+	struct supplemental_page_table *spt = &thread_current ()->proc->spt;
+	struct vma proto, *vma;
+
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT (page_cnt > 0);
+
+	proto = (struct vma) {
+		.start = start,
+		.end = (uint8_t *) start + page_cnt * PGSIZE,
+		.type = type,
+		.writable = writable,
+		.mmapped = false,
+		.init = init,
+		.file = file,
+		.ofs = ofs,
+		.read_bytes = read_bytes,
+		.ra = { .next = NULL, .window = 0, .advice = MADV_NORMAL },
+	};
+	if (vma_overlaps (spt, proto.start, proto.end)
+			|| has_pages (spt, proto.start, proto.end))
+		return NULL;
+
+	vma = vma_clone (&proto);
+	if (vma != NULL && !vma_insert (spt, vma)) {
+		vma_destroy (vma);
+		vma = NULL;
+	}
+	return vma;
+}
+
+/* Removes VMA and its pages from SPT. */
+void
+vma_unmap (struct supplemental_page_table *spt, struct vma *vma) {
+	size_t i = vma_index (spt, vma->start);
+
+	ASSERT (i < spt->vma_cnt && spt->vmas[i] == vma);
+
+	remove_pages (spt, vma->start, vma->end);
+	memmove (spt->vmas + i, spt->vmas + i + 1,
+			(spt->vma_cnt - i - 1) * sizeof *spt->vmas);
+	spt->vma_cnt--;
+	vma_destroy (vma);
+}
+
+/* Extends VMA of SPT down to START, which must be page-aligned.  Returns
+ * false, changing nothing, if another VMA or page is in the way. */
+bool
+vma_grow_down (struct supplemental_page_table *spt, struct vma *vma,
+		void *start) {
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT ((uint8_t *) start < vma->start);
+
+	if (vma_overlaps (spt, start, vma->start)
+			|| has_pages (spt, start, vma->start))
+		return false;
+	vma->start = start;
+	return true;
+}
+
+/* Moves the end of VMA of SPT to END, which must be page-aligned and
+ * above its start: extends the VMA up, or trims it, removing the pages
+ * past END.  Returns false, changing nothing, if another VMA or page is
+ * in the way of growth. */
+bool
+vma_set_end (struct supplemental_page_table *spt, struct vma *vma,
+		void *end) {
+	ASSERT (pg_ofs (end) == 0);
+	ASSERT ((uint8_t *) end > vma->start);
+
+	if ((uint8_t *) end < vma->end)
+		remove_pages (spt, end, vma->end);
+	else if (vma_overlaps (spt, vma->end, end)
+			|| has_pages (spt, vma->end, end))
+		return false;
+	vma->end = end;
+	return true;
+}
+
+/* Fills in ARG with where the page at VA of VMA is to be read from,
+ * except for its file, which is VMA's own and must not be closed.
+ * Returns false if the page is not read from a file: it is in a
+ * shared-memory segment or starts out as zeros. */
+bool
+vma_page_arg (const struct vma *vma, const void *va,
+		struct lazy_load_arg *arg) {
+	size_t ofs = (const uint8_t *) va - vma->start;
+
+	if (vma->file == NULL || file_get_shm (vma->file) != NULL)
+		return false;
+	arg->file = vma->file;
+	arg->ofs = vma->ofs + ofs;
+	arg->read_bytes = vma->read_bytes <= ofs ? 0
+		: vma->read_bytes - ofs < PGSIZE ? vma->read_bytes - ofs : PGSIZE;
+	arg->zero_bytes = PGSIZE - arg->read_bytes;
+	return arg->read_bytes > 0 || VM_TYPE (vma->type) != VM_ANON;
+}
+
+/* Gives DST, of a process being forked, a copy of every VMA of SRC. */
+bool
+vma_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	size_t i;
+
+	for (i = 0; i < src->vma_cnt; i++) {
+		struct vma *copy = vma_clone (src->vmas[i]);
+
+		if (copy == NULL)
+			return false;
+		if (!vma_insert (dst, copy)) {
+			vma_destroy (copy);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Frees every VMA of SPT, whose pages are gone. */
+void
+vma_kill (struct supplemental_page_table *spt) {
+	size_t i;
+
+	for (i = 0; i < spt->vma_cnt; i++)
+		vma_destroy (spt->vmas[i]);
+	free (spt->vmas);
+	spt->vmas = NULL;
+	spt->vma_cnt = spt->vma_cap = 0;
+}
@@ -0,0 +1,462 @@
+/* zswap.c: Compressed swap pool.
+ *
+ * Evicted anonymous pages go here before the swap disk.  A page whose
+ * words are all the same is kept as that one word; any other page is
+ * compressed with a small LZ77 coder and kept in a malloc() block, if it
+ * shrinks enough to be worth it.  Getting a page back then costs a
+ * decompression in memory instead of thousands of port reads of PIO disk
+ * transfer.
+ *
+ * The pool takes up to zswap_max_pages pages of kernel memory.  When a
+ * new page does not fit, the pages that have been in the pool longest are
+ * written back to the swap disk.  An entry stays with its page either way,
+ * so the page need not know which tier it ended up in. */
+
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+/* Where an entry keeps its page. */
+enum zswap_kind {
+	ZSWAP_FILLED,               /* FILL repeated over the page. */
+	ZSWAP_COMPRESSED,           /* SIZE bytes of compressed data at DATA. */
+	ZSWAP_DISK                  /* Swap slot SWAP_SLOT. */
+};
+
+/* A page in the compressed swap pool, or written back from it. */
+struct zswap_entry {
+	enum zswap_kind kind;
+	struct list_elem elem;      /* Element in lru, unless on disk. */
+	uint64_t fill;              /* Word the page is filled with. */
+	uint8_t *data;              /* Compressed contents. */
+	size_t size;                /* Bytes at DATA. */
+	size_t swap_slot;           /* Slot on the swap disk. */
+	bool writing;               /* Being written back, off lru. */
+	bool freed;                 /* Freed while being written back. */
+};
+
+/* -zswap: Pool size, in pages.  0 turns the pool off. */
+size_t zswap_max_pages = 256;
+
+/* Largest compressed page kept.  malloc() serves larger requests with a
+ * whole page, which would save nothing. */
+#define ZSWAP_MAX_SIZE (PGSIZE / 4)
+
+/* Entries in memory, least recently stored first. */
+static struct list lru;
+
+/* Bytes of kernel memory the entries in memory take up. */
+static size_t pool_bytes;
+
+/* Scratch page for compressing into. */
+static uint8_t *scratch;
+
+/* Protects lru, pool_bytes, scratch, the coder's hash table and every
+ * entry.  Never held across disk I/O. */
+static struct lock zswap_lock;
+
+/* Page to write back from, and the lock that serializes its use.  Taken
+ * before zswap_lock. */
+static uint8_t *writeback_page;
+static struct lock writeback_lock;
+
+/* Statistics. */
+static long long store_cnt;         /* Pages stored. */
+static long long filled_cnt;        /* ...of which same-filled. */
+static long long reject_cnt;        /* Pages that did not compress. */
+static long long in_bytes;          /* Bytes of pages compressed. */
+static long long out_bytes;         /* ...and what they came to. */
+static long long hit_cnt;           /* Pages loaded from memory. */
+static long long miss_cnt;          /* Pages loaded from the disk. */
+static long long writeback_cnt;     /* Pages written back to the disk. */
+
+/* Initializes the compressed swap pool. */
+void
+zswap_init (void) {
+	list_init (&lru);
+	lock_init (&zswap_lock);
+	lock_init (&writeback_lock);
+	scratch = palloc_get_page (PAL_ASSERT);
+	writeback_page = palloc_get_page (PAL_ASSERT);
+}
+
+/* Prints compressed swap statistics. */
+void
+zswap_print_stats (void) {
+	long long loads = hit_cnt + miss_cnt;
+
+	printf ("Compressed swap: %lld pages stored (%lld same-filled, "
+			"%lld rejected), %lld kB compressed to %lld kB, "
+			"%lld loads (%lld%% from memory), %lld written back\n",
+			store_cnt, filled_cnt, reject_cnt, in_bytes / 1024,
+			out_bytes / 1024, loads,
+			loads != 0 ? hit_cnt * 100 / loads : 0, writeback_cnt);
+}
+
+/* LZ77 coder.
+ *
+ * The compressed form of a page is a series of sequences, each of a run
+ * of literal bytes followed by a copy of earlier output.  A sequence
+ * starts with a token byte whose upper nibble is the number of literals
+ * and lower nibble the length of the copy less MIN_MATCH; a nibble of 15
+ * is continued in further bytes, added up until one is not 255.  Then
+ * come the literals, the distance back to copy from in two bytes, little
+ * endian, and the continuation of the copy length.  The last sequence
+ * stops after its literals. */
+
+#define MIN_MATCH 4
+#define HASH_BITS 10
+
+/* Most recent position + 1 of each hash of 4 bytes, or 0. */
+static uint16_t hash_table[1 << HASH_BITS];
+
+static uint32_t
+read32 (const uint8_t *p) {
+	uint32_t v;
+	memcpy (&v, p, sizeof v);
+	return v;
+}
+
+static unsigned
+hash4 (uint32_t v) {
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Appends the continuation of a length field of LEN to DST, which ends at
+ * END.  Returns the new end of DST, or a null pointer if it fills up. */
+static uint8_t *
+put_length (uint8_t *dst, uint8_t *end, size_t len) {
+	for (;; len -= 255) {
+		if (dst >= end)
+			return NULL;
+		*dst++ = len < 255 ? len : 255;
+		if (len < 255)
+			return dst;
+	}
+}
+
+/* Appends to DST, which ends at END, a sequence of the LIT_CNT literals
+ * at LIT followed by a copy of MATCH_LEN bytes from OFFSET back, or no
+ * copy if MATCH_LEN is 0.  Returns the new end of DST, or a null pointer
+ * if it fills up. */
+static uint8_t *
+put_sequence (uint8_t *dst, uint8_t *end, const uint8_t *lit,
+		size_t lit_cnt, size_t offset, size_t match_len) {
+	size_t ml = match_len != 0 ? match_len - MIN_MATCH : 0;
+
+	if (dst >= end)
+		return NULL;
+	*dst++ = (lit_cnt < 15 ? lit_cnt : 15) << 4 | (ml < 15 ? ml : 15);
+	if (lit_cnt >= 15 && (dst = put_length (dst, end, lit_cnt - 15)) == NULL)
+		return NULL;
+	if ((size_t) (end - dst) < lit_cnt)
+		return NULL;
+	memcpy (dst, lit, lit_cnt);
+	dst += lit_cnt;
+
+	if (match_len == 0)
+		return dst;
+	if (end - dst < 2)
+		return NULL;
+	*dst++ = offset;
+	*dst++ = offset >> 8;
+	if (ml >= 15)
+		dst = put_length (dst, end, ml - 15);
+	return dst;
+}
+
+/* Compresses the page at SRC into DST, which has room for CAP bytes.
+ * Returns the compressed size, or 0 if it does not fit. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t cap) {
+	const uint8_t *src_end = src + PGSIZE;
+	const uint8_t *ip = src, *anchor = src;
+	uint8_t *op = dst, *end = dst + cap;
+
+	memset (hash_table, 0, sizeof hash_table);
+	while (ip + MIN_MATCH <= src_end) {
+		uint32_t v = read32 (ip);
+		unsigned h = hash4 (v);
+		size_t pos = hash_table[h];
+		const uint8_t *ref;
+		size_t len;
+
+		hash_table[h] = ip - src + 1;
+		if (pos == 0 || read32 (src + pos - 1) != v) {
+			ip++;
+			continue;
+		}
+
+		ref = src + pos - 1;
+		len = MIN_MATCH;
+		while (ip + len < src_end && ref[len] == ip[len])
+			len++;
+		op = put_sequence (op, end, anchor, ip - anchor, ip - ref, len);
+		if (op == NULL)
+			return 0;
+		ip += len;
+		anchor = ip;
+	}
+	op = put_sequence (op, end, anchor, src_end - anchor, 0, 0);
+	return op != NULL ? (size_t) (op - dst) : 0;
+}
+
+/* Adds the continuation of a length field at *IP, which ends at END, to
+ * *LEN.  Returns false if the input is cut short. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *end, size_t *len) {
+	uint8_t b;
+
+	do {
+		if (*ip >= end)
+			return false;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return true;
+}
+
+/* Decompresses the SIZE bytes at SRC into the page at DST.  Returns false
+ * if they are not a compressed page. */
+static bool
+lz_decompress (const uint8_t *src, size_t size, uint8_t *dst) {
+	const uint8_t *ip = src, *end = src + size;
+	uint8_t *op = dst, *dst_end = dst + PGSIZE;
+
+	while (ip < end) {
+		unsigned token = *ip++;
+		size_t lit_cnt = token >> 4, match_len = token & 15;
+		size_t offset;
+		const uint8_t *ref;
+
+		if (lit_cnt == 15 && !get_length (&ip, end, &lit_cnt))
+			return false;
+		if (lit_cnt > (size_t) (end - ip) || lit_cnt > (size_t) (dst_end - op))
+			return false;
+		memcpy (op, ip, lit_cnt);
+		op += lit_cnt;
+		ip += lit_cnt;
+		if (ip == end)
+			break;
+
+		if (end - ip < 2)
+			return false;
+		offset = ip[0] | ip[1] << 8;
+		ip += 2;
+		if (match_len == 15 && !get_length (&ip, end, &match_len))
+			return false;
+		match_len += MIN_MATCH;
+		if (offset == 0 || offset > (size_t) (op - dst)
+				|| match_len > (size_t) (dst_end - op))
+			return false;
+
+		/* The copy may overlap its own output, so go byte by byte. */
+		for (ref = op - offset; match_len > 0; match_len--)
+			*op++ = *ref++;
+	}
+	return op == dst_end;
+}
+
+/* Returns the size of the malloc() block that serves SIZE bytes. */
+static size_t
+block_size (size_t size) {
+	size_t block = 16;
+
+	while (block < size)
+		block *= 2;
+	return block;
+}
+
+/* Returns the kernel memory that entry E takes up while in memory. */
+static size_t
+entry_bytes (const struct zswap_entry *e) {
+	return block_size (sizeof *e)
+		+ (e->kind == ZSWAP_COMPRESSED ? block_size (e->size) : 0);
+}
+
+/* Fills the page at KVA with the contents of entry E, which is in
+ * memory. */
+static void
+entry_read (const struct zswap_entry *e, void *kva) {
+	if (e->kind == ZSWAP_FILLED) {
+		uint64_t *p = kva;
+		size_t i;
+
+		for (i = 0; i < PGSIZE / sizeof *p; i++)
+			p[i] = e->fill;
+	} else if (!lz_decompress (e->data, e->size, kva))
+		PANIC ("zswap: corrupt compressed page");
+}
+
+/* Takes entry E, which is in memory, out of the pool. */
+static void
+entry_evict (struct zswap_entry *e) {
+	if (!e->writing)
+		list_remove (&e->elem);
+	pool_bytes -= entry_bytes (e);
+	if (e->kind == ZSWAP_COMPRESSED)
+		free (e->data);
+	e->data = NULL;
+}
+
+/* Writes the entry that has been in the pool longest back to the swap
+ * disk.  Returns false if the pool is empty or the disk is full.  The
+ * caller must not hold zswap_lock: the entry is taken off lru under it,
+ * but written without it, and stays readable in memory meanwhile. */
+static bool
+writeback (void) {
+	struct zswap_entry *e;
+	size_t slot;
+	bool freed;
+
+	lock_acquire (&writeback_lock);
+	lock_acquire (&zswap_lock);
+	if (list_empty (&lru)) {
+		lock_release (&zswap_lock);
+		lock_release (&writeback_lock);
+		return false;
+	}
+	e = list_entry (list_pop_front (&lru), struct zswap_entry, elem);
+	e->writing = true;
+	entry_read (e, writeback_page);
+	lock_release (&zswap_lock);
+
+	slot = swap_write (writeback_page);
+
+	lock_acquire (&zswap_lock);
+	freed = e->freed;
+	if (freed)
+		entry_evict (e);
+	else if (slot == BITMAP_ERROR)
+		list_push_front (&lru, &e->elem);
+	else {
+		entry_evict (e);
+		e->kind = ZSWAP_DISK;
+		e->swap_slot = slot;
+		writeback_cnt++;
+	}
+	e->writing = false;
+	lock_release (&zswap_lock);
+	lock_release (&writeback_lock);
+
+	if (freed) {
+		/* Its page went away while it was being written. */
+		if (slot != BITMAP_ERROR)
+			swap_free (slot);
+		free (e);
+	}
+	return slot != BITMAP_ERROR;
+}
+
+/* Stores the page at KVA in the pool and returns the entry that keeps it,
+ * or a null pointer if it does not compress well enough or there is no
+ * room, in which case it should go to the swap disk. */
+struct zswap_entry *
+zswap_store (const void *kva) {
+	const uint64_t *words = kva;
+	struct zswap_entry *e;
+	size_t i;
+
+	if (zswap_max_pages == 0)
+		return NULL;
+	e = malloc (sizeof *e);
+	if (e == NULL)
+		return NULL;
+	e->writing = e->freed = false;
+
+	for (i = 1; i < PGSIZE / sizeof *words; i++)
+		if (words[i] != words[0])
+			break;
+
+	lock_acquire (&zswap_lock);
+	if (i == PGSIZE / sizeof *words) {
+		e->kind = ZSWAP_FILLED;
+		e->fill = words[0];
+		e->data = NULL;
+		e->size = 0;
+		filled_cnt++;
+	} else {
+		e->kind = ZSWAP_COMPRESSED;
+		e->size = lz_compress (kva, scratch, ZSWAP_MAX_SIZE);
+		e->data = e->size != 0 ? malloc (e->size) : NULL;
+		if (e->data == NULL) {
+			reject_cnt++;
+			lock_release (&zswap_lock);
+			free (e);
+			return NULL;
+		}
+		memcpy (e->data, scratch, e->size);
+	}
+
+	/* Make room by writing back the oldest pages. */
+	while (pool_bytes + entry_bytes (e) > zswap_max_pages * PGSIZE) {
+		lock_release (&zswap_lock);
+		if (!writeback ()) {
+			free (e->data);
+			free (e);
+			return NULL;
+		}
+		lock_acquire (&zswap_lock);
+	}
+
+	list_push_back (&lru, &e->elem);
+	pool_bytes += entry_bytes (e);
+	store_cnt++;
+	in_bytes += PGSIZE;
+	out_bytes += e->size;
+	lock_release (&zswap_lock);
+	return e;
+}
+
+/* Reads the page kept by entry E into the page at KVA, leaving E as
+ * is. */
+void
+zswap_copy (struct zswap_entry *e, void *kva) {
+	lock_acquire (&zswap_lock);
+	if (e->kind != ZSWAP_DISK) {
+		entry_read (e, kva);
+		hit_cnt++;
+		lock_release (&zswap_lock);
+	} else {
+		/* Written back entries do not change any more. */
+		miss_cnt++;
+		lock_release (&zswap_lock);
+		swap_copy (e->swap_slot, kva);
+	}
+}
+
+/* Reads the page kept by entry E into the page at KVA and frees E. */
+void
+zswap_load (struct zswap_entry *e, void *kva) {
+	zswap_copy (e, kva);
+	zswap_free (e);
+}
+
+/* Frees entry E and what it keeps.  An entry being written back is left
+ * to writeback() to free. */
+void
+zswap_free (struct zswap_entry *e) {
+	bool on_disk;
+
+	lock_acquire (&zswap_lock);
+	if (e->writing) {
+		e->freed = true;
+		lock_release (&zswap_lock);
+		return;
+	}
+	on_disk = e->kind == ZSWAP_DISK;
+	if (!on_disk)
+		entry_evict (e);
+	lock_release (&zswap_lock);
+	if (on_disk)
+		swap_free (e->swap_slot);
+	free (e);
+}